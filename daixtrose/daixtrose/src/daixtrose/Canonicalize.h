@@ -0,0 +1,1284 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_CANONICALIZE_INC
+#define DAIXT_CANONICALIZE_INC
+
+#include "daixtrose/Expr.h"
+#include "daixtrose/BinOps.h"
+#include "daixtrose/UnOps.h"
+#include "daixtrose/Scalar.h"
+#include "daixtrose/NeutralElements.h"
+#include "daixtrose/DefaultOps.h"
+#include "daixtrose/Disambiguation.h"
+#include "daixtrose/ChangeDisambiguation.h"
+
+#include "boost/type_traits/is_empty.hpp"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Canonicalize: a compact normal form for sums and products
+////////////////////////////////////////////////////////////////////////////////
+
+// Simplify works on binary trees. It rewrites one node at a time and repeats
+// until nothing changes, and Diff of a product repeats the factors, so for
+// deep sums and products the number and the depth of the instantiated types
+// grow quickly with the size of the formula.
+//
+// Canonicalize rewrites an expression in one pass:
+//
+// - nested sums and differences are flattened into one list of terms, nested
+//   products and quotients (and integer powers) into one list of factors
+//
+// - identical subexpressions are merged: x + x becomes 2 * x, x * x / y
+//   becomes x^2 * y^(-1), x - x vanishes. Types are unique, so this is
+//   hash-consing for free, but it is only done for subexpressions without
+//   runtime data (no Scalar inside), whose values cannot differ.
+//
+// - all Scalar terms of a sum are added into one constant, all Scalar factors
+//   of a product into one coefficient, at runtime. IsNull and IsOne are
+//   dropped or absorb the product as usual.
+//
+// - the lists are rebuilt as balanced trees, so the depth of the result grows
+//   with the logarithm of the number of terms only.
+//
+// The result is an ordinary Daixt expression, so Diff, the Tape or any
+// evaluator work as before. Use it in place of Simplify where compile times
+// matter, e.g. Canonicalize(Diff(Canonicalize(e), x)).
+//
+// Terms and factors are sorted by CanonicalKey<T>::value before the tree is
+// built, so a + b and b + a get the same type and x * y - y * x vanishes. 
+// Leaves like Variable<N> with one std::size_t template parameter get
+// the key N, all other leaves 0. Leaves with equal keys keep their order, so
+// specialize CanonicalKey for Your own leaves and operations if they should
+// be told apart:
+//
+//   namespace Daixt { namespace ExprManip {
+//   template <> struct CanonicalKey<MyLeaf> 
+//   { 
+//     static const unsigned long value = 42; 
+//   };
+//   } }
+
+namespace Daixt 
+{
+
+namespace ExprManip
+{
+
+template <class T> struct Canonical;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// sort keys
+
+template <class T> struct CanonicalKey 
+{ 
+  static const unsigned long value = 0; 
+};
+
+template <template <std::size_t> class V, std::size_t N> 
+struct CanonicalKey<V<N> > 
+{ 
+  static const unsigned long value = N; 
+};
+
+template <unsigned long a, unsigned long b> struct MixKeys 
+{ 
+  static const unsigned long value = ((a * 1000003UL) ^ b) & 0xffffffffUL; 
+};
+
+template <class T> struct CanonicalKey<Daixt::Expr<T> > 
+{ 
+  static const unsigned long value = CanonicalKey<T>::value; 
+};
+
+template <class T, class D> 
+struct CanonicalKey<Daixt::DisambiguationChanger<T, D> > 
+{ 
+  static const unsigned long value = CanonicalKey<T>::value; 
+};
+
+template <class ARG, class OP> struct CanonicalKey<Daixt::UnOp<ARG, OP> > 
+{ 
+  static const unsigned long value = 
+    MixKeys<CanonicalKey<ARG>::value, CanonicalKey<OP>::value>::value; 
+};
+
+template <class LHS, class RHS, class OP> 
+struct CanonicalKey<Daixt::BinOp<LHS, RHS, OP> > 
+{ 
+  static const unsigned long value = 
+    MixKeys<MixKeys<CanonicalKey<LHS>::value, CanonicalKey<OP>::value>::value,
+            CanonicalKey<RHS>::value>::value; 
+};
+
+#define DAIXT_CANONICAL_KEY(OP, KEY)                                          \
+template <> struct CanonicalKey<Daixt::DefaultOps::OP>                        \
+{                                                                             \
+  static const unsigned long value = KEY;                                     \
+}
+
+DAIXT_CANONICAL_KEY(UnaryPlus, 101);
+DAIXT_CANONICAL_KEY(UnaryMinus, 102);
+DAIXT_CANONICAL_KEY(BinaryPlus, 103);
+DAIXT_CANONICAL_KEY(BinaryMinus, 104);
+DAIXT_CANONICAL_KEY(BinaryMultiply, 105);
+DAIXT_CANONICAL_KEY(BinaryDivide, 106);
+
+#undef DAIXT_CANONICAL_KEY
+
+template <int m, int n> 
+struct CanonicalKey<Daixt::DefaultOps::RationalPower<m, n> > 
+{ 
+  static const unsigned long value = 
+    MixKeys<MixKeys<107, static_cast<unsigned long>(m)>::value, 
+            static_cast<unsigned long>(n)>::value; 
+};
+
+
+namespace CanonicalImpl
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// subexpressions without runtime data may be merged
+
+template <class T> struct IsStateless 
+{ 
+  enum { value = boost::is_empty<T>::value }; 
+};
+
+template <class T> struct IsStateless<Daixt::Expr<T> > 
+{ 
+  enum { value = IsStateless<T>::value }; 
+};
+
+template <class ARG, class OP> struct IsStateless<Daixt::UnOp<ARG, OP> > 
+{ 
+  enum { value = IsStateless<ARG>::value }; 
+};
+
+template <class LHS, class RHS, class OP> 
+struct IsStateless<Daixt::BinOp<LHS, RHS, OP> > 
+{ 
+  enum { value = (IsStateless<LHS>::value && IsStateless<RHS>::value) }; 
+};
+
+
+inline double IntegerPower(double x, int n)
+{
+  double Result = 1.0;
+  for (int i = 0; i < n; ++i) Result *= x;
+  for (int i = 0; i > n; --i) Result /= x;
+  return Result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// lists of terms or factors. All helpers are plain aggregates, user-defined
+// constructors would add one more function per instantiated type.
+
+struct Nil {};
+
+template <class H, class T> 
+struct Cons 
+{
+  typedef H HeadT;
+  typedef T TailT;
+
+  H Head;
+  T Tail;
+};
+
+
+// a term N * Value of a sum or a factor Value^N of a product. Terms may carry
+// a factor which is only known at runtime: then Scaled is true and Scale
+// holds it, otherwise Scale == N.
+template <class T, int N, bool Scaled> 
+struct Item
+{
+  T Value;
+  double Scale;
+};
+
+
+template <class List, class T> struct Contains;
+
+template <class T> struct Contains<Nil, T> { enum { value = false }; };
+
+template <class H, class Tail, class T> struct Contains<Cons<H, Tail>, T> 
+{ 
+  enum { value = Contains<Tail, T>::value }; 
+};
+
+template <int N, bool Scaled, class Tail, class T> 
+struct Contains<Cons<Item<T, N, Scaled>, Tail>, T> 
+{ 
+  enum { value = true }; 
+};
+
+
+// add N * t to the list: new items go to the front, items of the same type
+// are merged if possible
+template <class List, class T, int N, bool Scaled, 
+          bool Merge = (IsStateless<T>::value && Contains<List, T>::value)> 
+struct Insert
+{
+  typedef Item<T, N, Scaled> ItemT;
+  typedef Cons<ItemT, List> type;
+
+  static inline type Apply(const List& l, const T& t, double Scale) 
+  { 
+    type Result = { { t, Scale }, l };
+    return Result; 
+  }
+};
+
+template <class H, class Tail, class T, int N, bool Scaled> 
+struct Insert<Cons<H, Tail>, T, N, Scaled, true>
+{
+  typedef Insert<Tail, T, N, Scaled, true> Next;
+  typedef Cons<H, typename Next::type> type;
+
+  static inline type Apply(const Cons<H, Tail>& l, const T& t, double Scale) 
+  { 
+    type Result = { l.Head, Next::Apply(l.Tail, t, Scale) };
+    return Result; 
+  }
+};
+
+// found: merge
+template <int M, bool ScaledM, class Tail, class T, int N, bool Scaled> 
+struct Insert<Cons<Item<T, M, ScaledM>, Tail>, T, N, Scaled, true>
+{
+  typedef Item<T, M + N, (ScaledM || Scaled)> ItemT;
+  typedef Cons<ItemT, Tail> type;
+
+  static inline type Apply(const Cons<Item<T, M, ScaledM>, Tail>& l, 
+                           const T&, double Scale) 
+  { 
+    type Result = { { l.Head.Value, l.Head.Scale + Scale }, l.Tail };
+    return Result; 
+  }
+};
+
+
+template <class List> struct Length;
+
+template <> struct Length<Nil> { enum { value = 0 }; };
+
+template <class H, class T> struct Length<Cons<H, T> > 
+{ 
+  enum { value = 1 + Length<T>::value }; 
+};
+
+
+// a stable insertion sort of the items by the keys of their values
+template <class I> struct KeyOf;
+
+template <class T, int N, bool Scaled> struct KeyOf<Item<T, N, Scaled> > 
+{ 
+  static const unsigned long value = CanonicalKey<T>::value; 
+};
+
+
+template <class I, class List> struct InFront { enum { value = true }; };
+
+template <class I, class H, class T> struct InFront<I, Cons<H, T> > 
+{ 
+  enum { value = (KeyOf<I>::value <= KeyOf<H>::value) }; 
+};
+
+
+// I goes in front of the first item with a key that is not smaller
+template <class I, class List, bool Here = InFront<I, List>::value> 
+struct SortedInsert
+{
+  typedef Cons<I, List> type;
+
+  static inline type Apply(const I& i, const List& l) 
+  { 
+    type Result = { i, l };
+    return Result; 
+  }
+};
+
+template <class I, class H, class T> 
+struct SortedInsert<I, Cons<H, T>, false>
+{
+  typedef SortedInsert<I, T> Next;
+  typedef Cons<H, typename Next::type> type;
+
+  static inline type Apply(const I& i, const Cons<H, T>& l) 
+  { 
+    type Result = { l.Head, Next::Apply(i, l.Tail) };
+    return Result; 
+  }
+};
+
+
+template <class List> 
+struct Sort
+{
+  typedef Nil type;
+  static inline Nil Apply(const Nil&) { return Nil(); }
+};
+
+template <class H, class T> 
+struct Sort<Cons<H, T> >
+{
+  typedef Sort<T> Next;
+  typedef SortedInsert<H, typename Next::type> Inserter;
+  typedef typename Inserter::type type;
+
+  static inline type Apply(const Cons<H, T>& l) 
+  { 
+    return Inserter::Apply(l.Head, Next::Apply(l.Tail)); 
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// turning items back into expressions
+
+template <class D> struct SumTag { typedef Daixt::DefaultOps::BinaryPlus OP; };
+template <class D> struct ProductTag 
+{ 
+  typedef Daixt::DefaultOps::BinaryMultiply OP; 
+};
+
+
+template <class Tag, class I> struct TermOf;
+
+// N * x
+template <class D, class T, int N, bool Scaled> 
+struct TermOf<SumTag<D>, Item<T, N, Scaled> >
+{
+  typedef Daixt::BinOp<Daixt::Scalar<D>, T, 
+                       Daixt::DefaultOps::BinaryMultiply> type;
+  static inline type Apply(const Item<T, N, Scaled>& i) 
+  { 
+    return type(Daixt::Scalar<D>(i.Scale), i.Value); 
+  }
+};
+
+template <class D, class T> 
+struct TermOf<SumTag<D>, Item<T, 1, false> >
+{
+  typedef T type;
+  static inline const T& Apply(const Item<T, 1, false>& i) { return i.Value; }
+};
+
+template <class D, class T> 
+struct TermOf<SumTag<D>, Item<T, -1, false> >
+{
+  typedef Daixt::UnOp<T, Daixt::DefaultOps::UnaryMinus> type;
+  static inline type Apply(const Item<T, -1, false>& i) 
+  { 
+    return type(i.Value); 
+  }
+};
+
+// x^N
+template <class D, class T, int N, bool Scaled> 
+struct TermOf<ProductTag<D>, Item<T, N, Scaled> >
+{
+  typedef Daixt::UnOp<T, Daixt::DefaultOps::RationalPower<N, 1> > type;
+  static inline type Apply(const Item<T, N, Scaled>& i) 
+  { 
+    return type(i.Value); 
+  }
+};
+
+template <class D, class T, bool Scaled> 
+struct TermOf<ProductTag<D>, Item<T, 1, Scaled> >
+{
+  typedef T type;
+  static inline const T& Apply(const Item<T, 1, Scaled>& i) { return i.Value; }
+};
+
+
+// x - x and x / x leave an item with N == 0 behind, all others become 
+// expressions
+template <class Tag, class List> struct Terms;
+
+template <class Tag> 
+struct Terms<Tag, Nil>
+{
+  typedef Nil type;
+  static inline Nil Apply(const Nil&) { return Nil(); }
+};
+
+template <class Tag, class H, class T> 
+struct Terms<Tag, Cons<H, T> >
+{
+  typedef TermOf<Tag, H> Term;
+  typedef Terms<Tag, T> Next;
+  typedef Cons<typename Term::type, typename Next::type> type;
+
+  static inline type Apply(const Cons<H, T>& l) 
+  { 
+    type Result = { Term::Apply(l.Head), Next::Apply(l.Tail) };
+    return Result; 
+  }
+};
+
+template <class Tag, class X, class T> 
+struct Terms<Tag, Cons<Item<X, 0, false>, T> >
+{
+  typedef Terms<Tag, T> Next;
+  typedef typename Next::type type;
+
+  static inline type Apply(const Cons<Item<X, 0, false>, T>& l) 
+  { 
+    return Next::Apply(l.Tail); 
+  }
+};
+
+
+// combine neighbours: (a, b, c, d, e) -> (a + b, c + d, e)
+template <class Tag, class List> 
+struct Pairs
+{
+  typedef List type;
+  static inline const List& Apply(const List& l) { return l; }
+};
+
+template <class Tag, class A, class B, class T> 
+struct Pairs<Tag, Cons<A, Cons<B, T> > >
+{
+  typedef Pairs<Tag, T> Next;
+  typedef Daixt::BinOp<A, B, typename Tag::OP> Pair;
+  typedef Cons<Pair, typename Next::type> type;
+
+  static inline type Apply(const Cons<A, Cons<B, T> >& l) 
+  { 
+    type Result = { Pair(l.Head, l.Tail.Head), Next::Apply(l.Tail.Tail) };
+    return Result; 
+  }
+};
+
+
+// a balanced tree from a non-empty list
+template <class Tag, class List, bool Done = (Length<List>::value == 1)> 
+struct Build
+{
+  typedef Pairs<Tag, List> Step;
+  typedef Build<Tag, typename Step::type> Next;
+  typedef typename Next::type type;
+
+  static inline type Apply(const List& l) 
+  { 
+    return Next::Apply(Step::Apply(l)); 
+  }
+};
+
+template <class Tag, class List> 
+struct Build<Tag, List, true>
+{
+  typedef typename List::HeadT type;
+  static inline const type& Apply(const List& l) { return l.Head; }
+};
+
+
+// from items to a tree
+template <class Tag, class List> 
+struct Tree
+{
+  typedef Sort<List> Sorter;
+  typedef Terms<Tag, typename Sorter::type> Filter;
+  typedef Build<Tag, typename Filter::type> Builder;
+  typedef typename Builder::type type;
+
+  static inline type Apply(const List& l) 
+  { 
+    return Builder::Apply(Filter::Apply(Sorter::Apply(l))); 
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// sums
+
+template <class List, bool HasConstant> 
+struct SumState
+{
+  typedef List ListT;
+  enum { has_constant = HasConstant };
+
+  List Items;
+  double Constant;
+};
+
+
+template <class C, int Sign, class State> struct SumInsert;
+
+// walks through nested sums, everything else is canonicalized and inserted
+template <class T, int Sign, class State> 
+struct SumFlattener
+{
+  typedef Daixt::ExprManip::Canonical<T> CanonicalT;
+  typedef SumInsert<typename CanonicalT::type, Sign, State> Next;
+  typedef typename Next::type type;
+
+  static inline type Apply(const T& t, const State& s)
+  {
+    return Next::Apply(CanonicalT::Apply(t), s);
+  }
+};
+
+template <class T, int Sign, class State> 
+struct SumFlattener<Daixt::Expr<T>, Sign, State>
+{
+  typedef SumFlattener<T, Sign, State> Next;
+  typedef typename Next::type type;
+
+  static inline type Apply(const Daixt::Expr<T>& t, const State& s)
+  {
+    return Next::Apply(t.content(), s);
+  }
+};
+
+template <class T, class D, int Sign, class State> 
+struct SumFlattener<Daixt::Expr<Daixt::DisambiguationChanger<T, D> >, Sign, State>
+{
+  typedef SumFlattener<T, Sign, State> Next;
+  typedef typename Next::type type;
+
+  static inline type 
+  Apply(const Daixt::Expr<Daixt::DisambiguationChanger<T, D> >& t, 
+        const State& s)
+  {
+    return Next::Apply(t.content(), s);
+  }
+};
+
+template <class LHS, class RHS, int Sign, class State> 
+struct SumFlattener<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryPlus>, 
+                    Sign, State>
+{
+  typedef SumFlattener<LHS, Sign, State> First;
+  typedef SumFlattener<RHS, Sign, typename First::type> Second;
+  typedef typename Second::type type;
+
+  static inline type 
+  Apply(const Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryPlus>& t, 
+        const State& s)
+  {
+    return Second::Apply(t.rhs(), First::Apply(t.lhs(), s));
+  }
+};
+
+template <class LHS, class RHS, int Sign, class State> 
+struct SumFlattener<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMinus>, 
+                    Sign, State>
+{
+  typedef SumFlattener<LHS, Sign, State> First;
+  typedef SumFlattener<RHS, -Sign, typename First::type> Second;
+  typedef typename Second::type type;
+
+  static inline type 
+  Apply(const Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMinus>& t, 
+        const State& s)
+  {
+    return Second::Apply(t.rhs(), First::Apply(t.lhs(), s));
+  }
+};
+
+template <class ARG, int Sign, class State> 
+struct SumFlattener<Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus>, 
+                    Sign, State>
+{
+  typedef SumFlattener<ARG, -Sign, State> Next;
+  typedef typename Next::type type;
+
+  static inline type 
+  Apply(const Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus>& t, 
+        const State& s)
+  {
+    return Next::Apply(t.arg(), s);
+  }
+};
+
+template <class ARG, int Sign, class State> 
+struct SumFlattener<Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryPlus>, 
+                    Sign, State>
+{
+  typedef SumFlattener<ARG, Sign, State> Next;
+  typedef typename Next::type type;
+
+  static inline type 
+  Apply(const Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryPlus>& t, 
+        const State& s)
+  {
+    return Next::Apply(t.arg(), s);
+  }
+};
+
+
+// a canonical term
+template <class C, int Sign, class List, bool HasConstant> 
+struct SumInsert<C, Sign, SumState<List, HasConstant> >
+{
+  typedef SumState<List, HasConstant> State;
+  typedef Insert<List, C, Sign, false> Next;
+  typedef SumState<typename Next::type, HasConstant> type;
+
+  static inline type Apply(const C& c, const State& s)
+  {
+    type Result = { Next::Apply(s.Items, c, Sign), s.Constant };
+    return Result;
+  }
+};
+
+template <class D, int Sign, class List, bool HasConstant> 
+struct SumInsert<Daixt::IsNull<D>, Sign, SumState<List, HasConstant> >
+{
+  typedef SumState<List, HasConstant> type;
+
+  static inline const type& Apply(const Daixt::IsNull<D>&, const type& s)
+  {
+    return s;
+  }
+};
+
+template <class D, int Sign, class List, bool HasConstant> 
+struct SumInsert<Daixt::IsOne<D>, Sign, SumState<List, HasConstant> >
+{
+  typedef SumState<List, HasConstant> State;
+  typedef SumState<List, true> type;
+
+  static inline type Apply(const Daixt::IsOne<D>&, const State& s)
+  {
+    type Result = { s.Items, s.Constant + Sign };
+    return Result;
+  }
+};
+
+template <class D, int Sign, class List, bool HasConstant> 
+struct SumInsert<Daixt::Scalar<D>, Sign, SumState<List, HasConstant> >
+{
+  typedef SumState<List, HasConstant> State;
+  typedef SumState<List, true> type;
+
+  static inline type Apply(const Daixt::Scalar<D>& c, const State& s)
+  {
+    type Result = { s.Items, s.Constant + Sign * c.Value() };
+    return Result;
+  }
+};
+
+// c * x: the coefficient is only known at runtime
+template <class D, class X, int Sign, class List, bool HasConstant> 
+struct SumInsert<Daixt::BinOp<Daixt::Scalar<D>, X, 
+                              Daixt::DefaultOps::BinaryMultiply>, 
+                 Sign, SumState<List, HasConstant> >
+{
+  typedef Daixt::BinOp<Daixt::Scalar<D>, X, 
+                       Daixt::DefaultOps::BinaryMultiply> ArgT;
+  typedef SumState<List, HasConstant> State;
+  typedef Insert<List, X, 0, true> Next;
+  typedef SumState<typename Next::type, HasConstant> type;
+
+  static inline type Apply(const ArgT& c, const State& s)
+  {
+    type Result = { Next::Apply(s.Items, c.rhs(), Sign * c.lhs().Value()), 
+                    s.Constant };
+    return Result;
+  }
+};
+
+// -x
+template <class X, int Sign, class List, bool HasConstant> 
+struct SumInsert<Daixt::UnOp<X, Daixt::DefaultOps::UnaryMinus>, 
+                 Sign, SumState<List, HasConstant> >
+{
+  typedef Daixt::UnOp<X, Daixt::DefaultOps::UnaryMinus> ArgT;
+  typedef SumState<List, HasConstant> State;
+  typedef Insert<List, X, -Sign, false> Next;
+  typedef SumState<typename Next::type, HasConstant> type;
+
+  static inline type Apply(const ArgT& c, const State& s)
+  {
+    type Result = { Next::Apply(s.Items, c.arg(), -Sign), s.Constant };
+    return Result;
+  }
+};
+
+// a canonical sum inside a canonical product of one factor
+template <class LHS, class RHS, int Sign, class List, bool HasConstant> 
+struct SumInsert<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryPlus>, 
+                 Sign, SumState<List, HasConstant> >
+{
+  typedef Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryPlus> ArgT;
+  typedef SumFlattener<ArgT, Sign, SumState<List, HasConstant> > Next;
+  typedef typename Next::type type;
+
+  static inline type Apply(const ArgT& c, const SumState<List, HasConstant>& s)
+  {
+    return Next::Apply(c, s);
+  }
+};
+
+
+template <class D, class State, 
+          int Case = ((Length<typename Terms<SumTag<D>, typename 
+                                             State::ListT>::type>::value == 0) 
+                      ? 0 : 2) 
+                     + (State::has_constant ? 1 : 0)>
+struct SumResult;
+
+template <class D, class State> 
+struct SumResult<D, State, 0>
+{
+  typedef Daixt::IsNull<D> type;
+  static inline type Apply(const State&) { return type(); }
+};
+
+template <class D, class State> 
+struct SumResult<D, State, 1>
+{
+  typedef Daixt::Scalar<D> type;
+  static inline type Apply(const State& s) { return type(s.Constant); }
+};
+
+template <class D, class State> 
+struct SumResult<D, State, 2>
+{
+  typedef CanonicalImpl::Tree<SumTag<D>, typename State::ListT> Tree;
+  typedef typename Tree::type type;
+
+  static inline type Apply(const State& s) 
+  { 
+    return Tree::Apply(s.Items); 
+  }
+};
+
+template <class D, class State> 
+struct SumResult<D, State, 3>
+{
+  typedef CanonicalImpl::Tree<SumTag<D>, typename State::ListT> Tree;
+  typedef Daixt::BinOp<Daixt::Scalar<D>, typename Tree::type, 
+                       Daixt::DefaultOps::BinaryPlus> type;
+
+  static inline type Apply(const State& s) 
+  { 
+    return type(Daixt::Scalar<D>(s.Constant), 
+                Tree::Apply(s.Items)); 
+  }
+};
+
+
+template <class T> 
+struct SumCanonical
+{
+  typedef typename Daixt::disambiguation<T>::type D;
+  typedef SumState<Nil, false> Start;
+  typedef SumFlattener<T, 1, Start> Flattener;
+  typedef SumResult<D, typename Flattener::type> Result;
+  typedef typename Result::type type;
+
+  static inline type Apply(const T& t)
+  {
+    const Start Empty = { Nil(), 0.0 };
+    return Result::Apply(Flattener::Apply(t, Empty));
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// products
+
+template <class List, bool HasCoefficient, int Sign, bool IsZero> 
+struct ProductState
+{
+  typedef List ListT;
+  enum { has_coefficient = HasCoefficient, sign = Sign, is_zero = IsZero };
+
+  List Factors;
+  double Coefficient;
+};
+
+
+// a canonical factor
+template <class C, int Power, class State> 
+struct ProductInsert
+{
+  typedef Insert<typename State::ListT, C, Power, false> Next;
+  typedef ProductState<typename Next::type, State::has_coefficient, 
+                       State::sign, State::is_zero> type;
+
+  static inline type Apply(const C& c, const State& s)
+  {
+    type Result = { Next::Apply(s.Factors, c, Power), s.Coefficient };
+    return Result;
+  }
+};
+
+
+// walks through nested products, quotients and integer powers
+template <class T, int Power, class State> 
+struct ProductFlattener
+{
+  typedef Daixt::ExprManip::Canonical<T> CanonicalT;
+  typedef ProductInsert<typename CanonicalT::type, Power, State> Next;
+  typedef typename Next::type type;
+
+  static inline type Apply(const T& t, const State& s)
+  {
+    return Next::Apply(CanonicalT::Apply(t), s);
+  }
+};
+
+template <class T, int Power, class State> 
+struct ProductFlattener<Daixt::Expr<T>, Power, State>
+{
+  typedef ProductFlattener<T, Power, State> Next;
+  typedef typename Next::type type;
+
+  static inline type Apply(const Daixt::Expr<T>& t, const State& s)
+  {
+    return Next::Apply(t.content(), s);
+  }
+};
+
+template <class T, class D, int Power, class State> 
+struct ProductFlattener<Daixt::Expr<Daixt::DisambiguationChanger<T, D> >, 
+                        Power, State>
+{
+  typedef ProductFlattener<T, Power, State> Next;
+  typedef typename Next::type type;
+
+  static inline type 
+  Apply(const Daixt::Expr<Daixt::DisambiguationChanger<T, D> >& t, 
+        const State& s)
+  {
+    return Next::Apply(t.content(), s);
+  }
+};
+
+template <class LHS, class RHS, int Power, class State> 
+struct ProductFlattener<Daixt::BinOp<LHS, RHS, 
+                                     Daixt::DefaultOps::BinaryMultiply>, 
+                        Power, State>
+{
+  typedef ProductFlattener<LHS, Power, State> First;
+  typedef ProductFlattener<RHS, Power, typename First::type> Second;
+  typedef typename Second::type type;
+
+  static inline type 
+  Apply(const Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply>& t, 
+        const State& s)
+  {
+    return Second::Apply(t.rhs(), First::Apply(t.lhs(), s));
+  }
+};
+
+template <class LHS, class RHS, int Power, class State> 
+struct ProductFlattener<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryDivide>, 
+                        Power, State>
+{
+  typedef ProductFlattener<LHS, Power, State> First;
+  typedef ProductFlattener<RHS, -Power, typename First::type> Second;
+  typedef typename Second::type type;
+
+  static inline type 
+  Apply(const Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryDivide>& t, 
+        const State& s)
+  {
+    return Second::Apply(t.rhs(), First::Apply(t.lhs(), s));
+  }
+};
+
+template <class ARG, int m, int Power, class State> 
+struct ProductFlattener<Daixt::UnOp<ARG, Daixt::DefaultOps::RationalPower<m, 1> >,
+                        Power, State>
+{
+  typedef ProductFlattener<ARG, m * Power, State> Next;
+  typedef typename Next::type type;
+
+  static inline type 
+  Apply(const Daixt::UnOp<ARG, Daixt::DefaultOps::RationalPower<m, 1> >& t, 
+        const State& s)
+  {
+    return Next::Apply(t.arg(), s);
+  }
+};
+
+// Inverse
+template <class ARG, int Power, class State> 
+struct ProductFlattener<Daixt::UnOp<ARG, Daixt::DefaultOps::RationalPower<1, -1> >,
+                        Power, State>
+{
+  typedef ProductFlattener<ARG, -Power, State> Next;
+  typedef typename Next::type type;
+
+  static inline type 
+  Apply(const Daixt::UnOp<ARG, Daixt::DefaultOps::RationalPower<1, -1> >& t, 
+        const State& s)
+  {
+    return Next::Apply(t.arg(), s);
+  }
+};
+
+// (-x)^Power = (-1)^Power x^Power
+template <class ARG, int Power, class List, bool HasCoefficient, int Sign, 
+          bool IsZero> 
+struct ProductFlattener<Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus>, Power,
+                        ProductState<List, HasCoefficient, Sign, IsZero> >
+{
+  typedef ProductState<List, HasCoefficient, Sign, IsZero> State;
+  typedef ProductState<List, HasCoefficient, 
+                       (Power % 2 == 0) ? Sign : -Sign, IsZero> Negated;
+  typedef ProductFlattener<ARG, Power, Negated> Next;
+  typedef typename Next::type type;
+
+  static inline type 
+  Apply(const Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus>& t, 
+        const State& s)
+  {
+    const Negated n = { s.Factors, s.Coefficient };
+    return Next::Apply(t.arg(), n);
+  }
+};
+
+template <class ARG, int Power, class State> 
+struct ProductFlattener<Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryPlus>, 
+                        Power, State>
+{
+  typedef ProductFlattener<ARG, Power, State> Next;
+  typedef typename Next::type type;
+
+  static inline type 
+  Apply(const Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryPlus>& t, 
+        const State& s)
+  {
+    return Next::Apply(t.arg(), s);
+  }
+};
+
+
+template <class D, int Power, class List, bool HasCoefficient, int Sign, 
+          bool IsZero> 
+struct ProductInsert<Daixt::IsNull<D>, Power, 
+                     ProductState<List, HasCoefficient, Sign, IsZero> >
+{
+  typedef ProductState<List, HasCoefficient, Sign, IsZero> State;
+  typedef ProductState<List, HasCoefficient, Sign, true> type;
+
+  static inline type Apply(const Daixt::IsNull<D>&, const State& s)
+  {
+    type Result = { s.Factors, s.Coefficient };
+    return Result;
+  }
+};
+
+template <class D, int Power, class List, bool HasCoefficient, int Sign, 
+          bool IsZero> 
+struct ProductInsert<Daixt::IsOne<D>, Power, 
+                     ProductState<List, HasCoefficient, Sign, IsZero> >
+{
+  typedef ProductState<List, HasCoefficient, Sign, IsZero> type;
+
+  static inline const type& Apply(const Daixt::IsOne<D>&, const type& s)
+  {
+    return s;
+  }
+};
+
+template <class D, int Power, class List, bool HasCoefficient, int Sign, 
+          bool IsZero> 
+struct ProductInsert<Daixt::Scalar<D>, Power, 
+                     ProductState<List, HasCoefficient, Sign, IsZero> >
+{
+  typedef ProductState<List, HasCoefficient, Sign, IsZero> State;
+  typedef ProductState<List, true, Sign, IsZero> type;
+
+  static inline type Apply(const Daixt::Scalar<D>& c, const State& s)
+  {
+    type Result = { s.Factors, 
+                    s.Coefficient * IntegerPower(c.Value(), Power) };
+    return Result;
+  }
+};
+
+// canonical forms which are products themselves are flattened
+template <class LHS, class RHS, int Power, class State> 
+struct ProductInsert<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply>, 
+                     Power, State>
+  : public ProductFlattener<Daixt::BinOp<LHS, RHS, 
+                                         Daixt::DefaultOps::BinaryMultiply>, 
+                            Power, State>
+{};
+
+template <class ARG, int m, int Power, class State> 
+struct ProductInsert<Daixt::UnOp<ARG, Daixt::DefaultOps::RationalPower<m, 1> >,
+                     Power, State>
+  : public ProductFlattener<Daixt::UnOp<ARG, 
+                                        Daixt::DefaultOps::RationalPower<m, 1> >,
+                            Power, State>
+{};
+
+template <class ARG, int Power, class State> 
+struct ProductInsert<Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus>, 
+                     Power, State>
+  : public ProductFlattener<Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus>, 
+                            Power, State>
+{};
+
+
+
+
+template <class D, class State, 
+          int Case = State::is_zero ? 0 
+          : ((Length<typename Terms<ProductTag<D>, typename 
+                                    State::ListT>::type>::value == 0) 
+             ? 1 : 4) 
+            + (State::has_coefficient ? 0 : (State::sign > 0 ? 1 : 2))>
+struct ProductResult;
+
+// a factor 0
+template <class D, class State> 
+struct ProductResult<D, State, 0>
+{
+  typedef Daixt::IsNull<D> type;
+  static inline type Apply(const State&) { return type(); }
+};
+
+// c
+template <class D, class State> 
+struct ProductResult<D, State, 1>
+{
+  typedef Daixt::Scalar<D> type;
+  static inline type Apply(const State& s) 
+  { 
+    return type(State::sign * s.Coefficient); 
+  }
+};
+
+// 1
+template <class D, class State> 
+struct ProductResult<D, State, 2>
+{
+  typedef Daixt::IsOne<D> type;
+  static inline type Apply(const State&) { return type(); }
+};
+
+// -1
+template <class D, class State> 
+struct ProductResult<D, State, 3>
+{
+  typedef Daixt::Scalar<D> type;
+  static inline type Apply(const State&) { return type(-1.0); }
+};
+
+// c * x * ...
+template <class D, class State> 
+struct ProductResult<D, State, 4>
+{
+  typedef CanonicalImpl::Tree<ProductTag<D>, typename State::ListT> Tree;
+  typedef Daixt::BinOp<Daixt::Scalar<D>, typename Tree::type, 
+                       Daixt::DefaultOps::BinaryMultiply> type;
+
+  static inline type Apply(const State& s) 
+  { 
+    return type(Daixt::Scalar<D>(State::sign * s.Coefficient), 
+                Tree::Apply(s.Factors)); 
+  }
+};
+
+// x * ...
+template <class D, class State> 
+struct ProductResult<D, State, 5>
+{
+  typedef CanonicalImpl::Tree<ProductTag<D>, typename State::ListT> Tree;
+  typedef typename Tree::type type;
+
+  static inline type Apply(const State& s) 
+  { 
+    return Tree::Apply(s.Factors); 
+  }
+};
+
+// -(x * ...)
+template <class D, class State> 
+struct ProductResult<D, State, 6>
+{
+  typedef CanonicalImpl::Tree<ProductTag<D>, typename State::ListT> Tree;
+  typedef Daixt::UnOp<typename Tree::type, 
+                      Daixt::DefaultOps::UnaryMinus> type;
+
+  static inline type Apply(const State& s) 
+  { 
+    return type(Tree::Apply(s.Factors)); 
+  }
+};
+
+
+template <class T> 
+struct ProductCanonical
+{
+  typedef typename Daixt::disambiguation<T>::type D;
+  typedef ProductState<Nil, false, 1, false> Start;
+  typedef ProductFlattener<T, 1, Start> Flattener;
+  typedef ProductResult<D, typename Flattener::type> Result;
+  typedef typename Result::type type;
+
+  static inline type Apply(const T& t)
+  {
+    const Start Empty = { Nil(), 1.0 };
+    return Result::Apply(Flattener::Apply(t, Empty));
+  }
+};
+
+} // namespace CanonicalImpl
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Canonical<T>::type is the canonical form of T, Canonical<T>::Apply builds it
+
+// leaves 
+template <class T> 
+struct Canonical
+{
+  typedef T type;
+  static inline const T& Apply(const T& t) { return t; }
+};
+
+template <class T> 
+struct Canonical<Daixt::Expr<T> >
+{
+  typedef Canonical<T> Next;
+  typedef typename Next::type type;
+  static inline type Apply(const Daixt::Expr<T>& t) 
+  { 
+    return Next::Apply(t.content()); 
+  }
+};
+
+template <class T, class D> 
+struct Canonical<Daixt::Expr<Daixt::DisambiguationChanger<T, D> > >
+{
+  typedef Canonical<T> Next;
+  typedef typename Next::type type;
+  static inline type 
+  Apply(const Daixt::Expr<Daixt::DisambiguationChanger<T, D> >& t) 
+  { 
+    return Next::Apply(t.content()); 
+  }
+};
+
+// other operators: canonicalize the arguments only
+template <class ARG, class OP> 
+struct Canonical<Daixt::UnOp<ARG, OP> >
+{
+  typedef Canonical<ARG> Next;
+  typedef Daixt::UnOp<typename Next::type, OP> type;
+  static inline type Apply(const Daixt::UnOp<ARG, OP>& t) 
+  { 
+    return type(Next::Apply(t.arg())); 
+  }
+};
+
+template <class LHS, class RHS, class OP> 
+struct Canonical<Daixt::BinOp<LHS, RHS, OP> >
+{
+  typedef Canonical<LHS> NextLHS;
+  typedef Canonical<RHS> NextRHS;
+  typedef Daixt::BinOp<typename NextLHS::type, typename NextRHS::type, OP> type;
+  static inline type Apply(const Daixt::BinOp<LHS, RHS, OP>& t) 
+  { 
+    return type(NextLHS::Apply(t.lhs()), NextRHS::Apply(t.rhs())); 
+  }
+};
+
+// sums
+template <class LHS, class RHS> 
+struct Canonical<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryPlus> >
+  : public CanonicalImpl::SumCanonical<
+  Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryPlus> >
+{};
+
+template <class LHS, class RHS> 
+struct Canonical<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMinus> >
+  : public CanonicalImpl::SumCanonical<
+  Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMinus> >
+{};
+
+template <class ARG> 
+struct Canonical<Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus> >
+  : public CanonicalImpl::SumCanonical<
+  Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus> >
+{};
+
+template <class ARG> 
+struct Canonical<Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryPlus> >
+  : public CanonicalImpl::SumCanonical<
+  Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryPlus> >
+{};
+
+// products
+template <class LHS, class RHS> 
+struct Canonical<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply> >
+  : public CanonicalImpl::ProductCanonical<
+  Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply> >
+{};
+
+template <class LHS, class RHS> 
+struct Canonical<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryDivide> >
+  : public CanonicalImpl::ProductCanonical<
+  Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryDivide> >
+{};
+
+template <class ARG, int m> 
+struct Canonical<Daixt::UnOp<ARG, Daixt::DefaultOps::RationalPower<m, 1> > >
+  : public CanonicalImpl::ProductCanonical<
+  Daixt::UnOp<ARG, Daixt::DefaultOps::RationalPower<m, 1> > >
+{};
+
+template <class ARG> 
+struct Canonical<Daixt::UnOp<ARG, Daixt::DefaultOps::RationalPower<1, -1> > >
+  : public CanonicalImpl::ProductCanonical<
+  Daixt::UnOp<ARG, Daixt::DefaultOps::RationalPower<1, -1> > >
+{};
+
+
+template <class T> 
+inline
+Daixt::Expr<typename Canonical<T>::type> 
+Canonicalize(const T& t)
+{
+  return Daixt::Expr<typename Canonical<T>::type>(Canonical<T>::Apply(t));
+}
+
+} // namespace ExprManip
+} // namespace Daixt 
+
+#endif // DAIXT_CANONICALIZE_INC
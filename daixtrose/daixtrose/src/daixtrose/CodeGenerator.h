@@ -0,0 +1,312 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_CODE_GENERATOR_INC
+#define DAIXT_CODE_GENERATOR_INC
+
+#include "daixtrose/Dynamic.h"
+
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "boost/lexical_cast.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CodeGenerator: C source for the outputs of a Dynamic::Graph
+////////////////////////////////////////////////////////////////////////////////
+
+// For the largest systems even the Tape or the Evaluator is not fast
+// enough, and Simplify/Diff of huge static expressions is too hard on the
+// compiler. CodeGenerator writes straight-line C code for some nodes of a
+// Dynamic::Graph, to be compiled separately and linked in. The graph stores
+// identical subexpressions once, so every common subexpression becomes one
+// temporary. Static expressions get there via Graph::Convert, residuals and
+// Jacobians via ResidualAndJacobian (see Dynamic.h):
+//
+//   Daixt::Dynamic::Graph G;
+//   std::vector<std::size_t> Residuals;
+//   Residuals.push_back(G.Convert(x * y - S(1.0)));
+//   ...
+//   Daixt::Dynamic::CodeGenerator C(G, ResidualAndJacobian(G, Residuals, 2));
+//   C.EmitIncludes(os);
+//   C.EmitFunction(os, "system");       // one point
+//   C.EmitBatchFunction(os, "systems"); // many points, vectorizable loop
+//
+// The code is C89 and C++ alike. From C++ declare the functions extern "C"
+// if the file is compiled as C:
+//
+//   extern "C" void system(const double* x, double* y);
+//   extern "C" void systems(size_t n, const double* x, double* y);
+//
+// Ops which are called via a pointer (Node::Unary, Node::Binary) have no
+// name in C, so outputs which need them are rejected.
+
+namespace Daixt 
+{
+
+namespace Dynamic
+{
+
+class CodeGenerator
+{
+public:
+  inline CodeGenerator(const Graph& G, const std::vector<std::size_t>& Outputs)
+    : Graph_(G), Outputs_(Outputs)
+  {
+    Collect();
+  }
+
+  inline CodeGenerator(const Graph& G, std::size_t Output)
+    : Graph_(G), Outputs_(1, Output)
+  {
+    Collect();
+  }
+
+  inline std::size_t NumberOfOutputs() const { return Outputs_.size(); }
+
+  // the temporaries of a function
+  inline std::size_t NumberOfTemporaries() const { return Temporaries_; }
+
+  inline void EmitIncludes(std::ostream& os) const;
+
+  // void Name(const double* x, double* y): y[o] for the point x[v]
+  inline void EmitFunction(std::ostream& os, const std::string& Name) const;
+
+  // void Name(size_t n, const double* x, double* y): one array per variable
+  // and per output, x[v * n + Point] and y[o * n + Point]
+  inline void EmitBatchFunction(std::ostream& os, 
+                                const std::string& Name) const;
+
+private:
+  inline void Collect();
+  inline void EmitBody(std::ostream& os, const std::string& Indent, 
+                       bool Batch) const;
+
+  // how to refer to the value of a node
+  inline std::string Operand(std::size_t Node) const;
+  inline std::string Expression(std::size_t Node) const;
+
+  const Graph& Graph_;
+  std::vector<std::size_t> Outputs_;
+  std::vector<std::size_t> Order_;
+  std::vector<std::size_t> Name_;     // node -> number of its temporary
+  std::size_t Temporaries_;
+};
+
+
+namespace Private
+{
+
+// enough digits to read back the same double
+inline std::string Literal(double Value)
+{
+  if (Value != Value || std::fabs(Value) > 1.7976931348623157e308)
+    {
+      throw std::domain_error("Daixt::Dynamic::CodeGenerator: the constant " 
+                              + boost::lexical_cast<std::string>(Value) 
+                              + " has no C literal");
+    }
+
+  std::ostringstream os;
+  os.precision(17);
+  os << Value;
+  std::string Result = os.str();
+  if (Result.find_first_of(".e") == std::string::npos) Result += ".0";
+  if (Value < 0.0) Result = "(" + Result + ")";
+  return Result;
+}
+
+} // namespace Private
+
+
+inline void CodeGenerator::Collect()
+{
+  Private::CollectNodes(Graph_, Outputs_, "Daixt::Dynamic::CodeGenerator", 
+                        Order_);
+
+  const std::size_t Unused = static_cast<std::size_t>(-1);
+  Name_.assign(Graph_.NumberOfNodes(), Unused);
+  Temporaries_ = 0;
+
+  // constants are written as literals, everything else gets a temporary
+  for (std::size_t i = 0; i != Order_.size(); ++i)
+    {
+      const Node& N = Graph_[Order_[i]];
+      if (N.What == call_unary || N.What == call_binary)
+        {
+          throw std::invalid_argument("Daixt::Dynamic::CodeGenerator: node " 
+                                      + boost::lexical_cast<std::string>
+                                      (Order_[i]) 
+                                      + " calls a function without a name");
+        }
+      if (N.What != constant) Name_[Order_[i]] = Temporaries_++;
+    }
+}
+
+
+inline std::string CodeGenerator::Operand(std::size_t Node) const
+{
+  const Daixt::Dynamic::Node& N = Graph_[Node];
+  if (N.What == constant) return Private::Literal(N.Constant);
+  return "t" + boost::lexical_cast<std::string>(Name_[Node]);
+}
+
+
+inline std::string CodeGenerator::Expression(std::size_t Node) const
+{
+  const Daixt::Dynamic::Node& N = Graph_[Node];
+  const std::string a = Operand(N.Lhs);
+
+  // x^(m/-n) = x^(-m/n)
+  const int m = (N.n < 0) ? -N.m : N.m;
+  const int n = (N.n < 0) ? -N.n : N.n;
+
+  switch (N.What)
+    {
+    case plus: return a + " + " + Operand(N.Rhs);
+    case minus: return a + " - " + Operand(N.Rhs);
+    case multiply: return a + " * " + Operand(N.Rhs);
+    case divide: return a + " / " + Operand(N.Rhs);
+    case negate: return "-" + a;
+    case power:
+      // small powers are multiplications, they vectorize
+      if (n == 1)
+        {
+          switch (m)
+            {
+            case 0: return "1.0";
+            case 1: return a;
+            case 2: return a + " * " + a;
+            case 3: return a + " * " + a + " * " + a;
+            case -1: return "1.0 / " + a;
+            case -2: return "1.0 / (" + a + " * " + a + ")";
+            default: break;
+            }
+        }
+      if (n == 2 && m == 1) return "sqrt(" + a + ")";
+      if (n == 2 && m == -1) return "1.0 / sqrt(" + a + ")";
+      return "pow(" + a + ", " 
+        + Private::Literal(static_cast<double>(m) / static_cast<double>(n)) 
+        + ")";
+    default:
+      throw std::logic_error("Daixt::Dynamic::CodeGenerator: not an operation");
+    }
+}
+
+
+inline void CodeGenerator::EmitBody(std::ostream& os, 
+                                    const std::string& Indent, 
+                                    bool Batch) const
+{
+  // declarations first, C89 wants them at the beginning of the block
+  for (std::size_t i = 0; i != Order_.size(); ++i)
+    {
+      const std::size_t k = Order_[i];
+      const Node& N = Graph_[k];
+      if (N.What == constant) continue;
+
+      os << Indent << "const double " << Operand(k) << " = ";
+      if (N.What != variable) 
+        {
+          os << Expression(k);
+        }
+      else if (!Batch)
+        {
+          os << "x[" << N.Lhs << "]";
+        }
+      else if (N.Lhs == 0)
+        {
+          os << "x[i]";
+        }
+      else
+        {
+          os << "x[" << N.Lhs << " * n + i]";
+        }
+      os << ";\n";
+    }
+
+  for (std::size_t o = 0; o != Outputs_.size(); ++o)
+    {
+      os << Indent << "y[";
+      if (!Batch) 
+        os << o;
+      else if (o == 0) 
+        os << "i";
+      else
+        os << o << " * n + i";
+      os << "] = " << Operand(Outputs_[o]) << ";\n";
+    }
+}
+
+
+inline void CodeGenerator::EmitIncludes(std::ostream& os) const
+{
+  os << "/* generated by Daixt::Dynamic::CodeGenerator */\n"
+     << "#include <math.h>\n"
+     << "#include <stddef.h>\n\n";
+}
+
+
+inline void CodeGenerator::EmitFunction(std::ostream& os, 
+                                        const std::string& Name) const
+{
+  os << "/* " << Graph_.NumberOfVariables() << " variables, " 
+     << Outputs_.size() << " outputs */\n"
+     << "void " << Name << "(const double* x, double* y)\n"
+     << "{\n";
+  EmitBody(os, "  ", false);
+  os << "}\n\n";
+}
+
+
+inline void CodeGenerator::EmitBatchFunction(std::ostream& os, 
+                                             const std::string& Name) const
+{
+  os << "/* " << Graph_.NumberOfVariables() << " variables, " 
+     << Outputs_.size() << " outputs, for n points */\n"
+     << "void " << Name << "(size_t n, const double* x, double* y)\n"
+     << "{\n"
+     << "  size_t i;\n"
+     << "  for (i = 0; i < n; ++i)\n"
+     << "    {\n";
+  EmitBody(os, "      ", true);
+  os << "    }\n"
+     << "}\n\n";
+}
+
+} // namespace Dynamic
+
+} // namespace Daixt 
+
+#endif // DAIXT_CODE_GENERATOR_INC
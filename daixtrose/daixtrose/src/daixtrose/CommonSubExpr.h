@@ -0,0 +1,362 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_COMMON_SUB_EXPR_INC
+#define DAIXT_COMMON_SUB_EXPR_INC
+
+#include <cstddef> // for size_t
+
+#include "daixtrose/Expr.h"
+#include "daixtrose/BinOps.h"
+#include "daixtrose/UnOps.h"
+#include "daixtrose/ConstRef.h"
+#include "daixtrose/Scalar.h"
+#include "daixtrose/CountOccurence.h"
+#include "daixtrose/CompileTimeChecks.h"
+
+#include "boost/mpl/if.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// common subexpression elimination (CSE)
+////////////////////////////////////////////////////////////////////////////////
+
+// An expression like "A * x + B * (A * x)" contains the subexpression "A * x"
+// twice. Since every occurrence is evaluated on its own, the work is done
+// twice. The tools below find such subexpressions at compile time (via
+// StaticOccurrenceCounter) and verify at runtime that all occurrences really
+// refer to the same objects. A library may then evaluate the subexpression
+// once into a temporary and substitute a reference to the temporary.
+//
+// Daixt itself has no idea which subexpressions are worth the effort: this is
+// decided by SharingPolicy, which must be specialized by the libraries plugged
+// into Daixt (see e.g. linalg/CommonSubExpr.h).
+
+namespace Daixt 
+{
+namespace ExprManip
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// the policy: dispatch wrt disambiguation first, then wrt argument type.
+// default: nothing is worth sharing
+template <class Disambiguation, class T>
+struct SharingPolicy
+{
+  enum { worth_sharing = false };
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the compile-time part: find the innermost subexpression type which is worth
+// sharing and occurs more than once inside Root
+
+struct NoCommonSubExpr {};
+
+
+namespace Private
+{
+template <class T, class Root>
+struct IsSharedCandidate
+{
+  enum { Result = 
+         SharingPolicy<typename disambiguation<T>::type, T>::worth_sharing 
+         &&
+         (StaticOccurrenceCounter<Root, T>::Result > 1) };
+};
+
+template <class Found, class T, class Root>
+struct SelfIfNothingFound
+{
+  typedef Found Result;
+};
+
+template <class T, class Root>
+struct SelfIfNothingFound<NoCommonSubExpr, T, Root>
+{
+  typedef typename boost::mpl::if_c<IsSharedCandidate<T, Root>::Result, 
+                                    T, 
+                                    NoCommonSubExpr>::type Result;
+};
+
+} // namespace Private
+
+
+// leaves (ConstRef included) are never shared
+template <class T, class Root = T>
+struct CommonSubExprFinder
+{
+  typedef NoCommonSubExpr Result;
+};
+
+
+template <class T, class Root>
+struct CommonSubExprFinder<Daixt::Expr<T>, Root>
+{
+  typedef typename CommonSubExprFinder<T, Root>::Result Result;
+};
+
+
+template <class ARG, class OP, class Root>
+struct CommonSubExprFinder<Daixt::UnOp<ARG, OP>, Root>
+{
+  typedef typename Private::SelfIfNothingFound
+  <
+    typename CommonSubExprFinder<ARG, Root>::Result,
+    Daixt::UnOp<ARG, OP>, 
+    Root
+  >::Result Result;
+};
+
+
+template <class LHS, class RHS, class OP, class Root>
+struct CommonSubExprFinder<Daixt::BinOp<LHS, RHS, OP>, Root>
+{
+private:
+  typedef typename CommonSubExprFinder<LHS, Root>::Result InLHS;
+  typedef typename boost::mpl::if_c
+  <
+    SAME_TYPE(InLHS, NoCommonSubExpr), 
+    typename CommonSubExprFinder<RHS, Root>::Result,
+    InLHS
+  >::type InChildren;
+
+public:
+  typedef typename Private::SelfIfNothingFound
+  <
+    InChildren, 
+    Daixt::BinOp<LHS, RHS, OP>, 
+    Root
+  >::Result Result;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the runtime part: are two subexpressions of the same type really the same?
+// We are conservative: leaves compare equal only if they are the same object.
+
+template <class T1, class T2>
+inline bool IsSameSubExpr(const T1& t1, const T2& t2)
+{
+  return false;
+}
+
+template <class T>
+inline bool IsSameSubExpr(const T& t1, const T& t2)
+{
+  return Daixt::Private::AdressCompare(t1, t2);
+}
+
+template <class T>
+inline bool IsSameSubExpr(const Daixt::ConstRef<T>& t1, 
+                          const Daixt::ConstRef<T>& t2)
+{
+  return Daixt::Private::AdressCompare(static_cast<const T&>(t1), 
+                                       static_cast<const T&>(t2));
+}
+
+template <class D>
+inline bool IsSameSubExpr(const Daixt::Scalar<D>& t1, 
+                          const Daixt::Scalar<D>& t2)
+{
+  return t1.Value() == t2.Value();
+}
+
+template <class T>
+inline bool IsSameSubExpr(const Daixt::Expr<T>& t1, const Daixt::Expr<T>& t2)
+{
+  return IsSameSubExpr(t1.content(), t2.content());
+}
+
+template <class ARG, class OP>
+inline bool IsSameSubExpr(const Daixt::UnOp<ARG, OP>& t1, 
+                          const Daixt::UnOp<ARG, OP>& t2)
+{
+  return IsSameSubExpr(t1.arg(), t2.arg());
+}
+
+template <class LHS, class RHS, class OP>
+inline bool IsSameSubExpr(const Daixt::BinOp<LHS, RHS, OP>& t1, 
+                          const Daixt::BinOp<LHS, RHS, OP>& t2)
+{
+  return IsSameSubExpr(t1.lhs(), t2.lhs()) && IsSameSubExpr(t1.rhs(), t2.rhs());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// count the subexpressions inside t which are the same as s
+
+template <class T, class S>
+inline std::size_t CountSameSubExpr(const T& t, const S& s)
+{
+  return IsSameSubExpr(t, s);
+}
+
+template <class T, class S>
+inline std::size_t CountSameSubExpr(const Daixt::Expr<T>& E, const S& s)
+{
+  return CountSameSubExpr(E.content(), s);
+}
+
+template <class ARG, class OP, class S>
+inline std::size_t CountSameSubExpr(const Daixt::UnOp<ARG, OP>& UO, 
+                                    const S& s)
+{
+  return IsSameSubExpr(UO, s) ? 1 : CountSameSubExpr(UO.arg(), s);
+}
+
+template <class LHS, class RHS, class OP, class S>
+inline std::size_t CountSameSubExpr(const Daixt::BinOp<LHS, RHS, OP>& BO, 
+                                    const S& s)
+{
+  return IsSameSubExpr(BO, s) ? 
+    1 : CountSameSubExpr(BO.lhs(), s) + CountSameSubExpr(BO.rhs(), s);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// find the first subexpression of type S inside t, return 0 if there is none
+
+namespace Private
+{
+template <class S> 
+inline const S* AsPointerTo(const S& s, const S*) { return &s; }
+
+template <class S, class T> 
+inline const S* AsPointerTo(const T& t, const S*) { return 0; }
+} // namespace Private
+
+
+template <class S, class T>
+struct SubExprLocator
+{
+  static inline const S* Find(const T& t) 
+  { 
+    return Private::AsPointerTo(t, static_cast<const S*>(0)); 
+  }
+};
+
+template <class S, class T>
+struct SubExprLocator<S, Daixt::Expr<T> >
+{
+  static inline const S* Find(const Daixt::Expr<T>& E) 
+  { 
+    return SubExprLocator<S, T>::Find(E.content()); 
+  }
+};
+
+template <class S, class ARG, class OP>
+struct SubExprLocator<S, Daixt::UnOp<ARG, OP> >
+{
+  static inline const S* Find(const Daixt::UnOp<ARG, OP>& UO) 
+  { 
+    const S* Result = Private::AsPointerTo(UO, static_cast<const S*>(0));
+    return Result ? Result : SubExprLocator<S, ARG>::Find(UO.arg()); 
+  }
+};
+
+template <class S, class LHS, class RHS, class OP>
+struct SubExprLocator<S, Daixt::BinOp<LHS, RHS, OP> >
+{
+  static inline const S* Find(const Daixt::BinOp<LHS, RHS, OP>& BO) 
+  { 
+    const S* Result = Private::AsPointerTo(BO, static_cast<const S*>(0));
+    if (!Result) Result = SubExprLocator<S, LHS>::Find(BO.lhs());
+    return Result ? Result : SubExprLocator<S, RHS>::Find(BO.rhs()); 
+  }
+};
+
+
+template <class S, class T>
+inline const S* FindFirstSubExpr(const T& t)
+{
+  return SubExprLocator<S, T>::Find(t);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// replace every subexpression of type S inside T by an R.  
+// Usually R is a Daixt::ConstRef to a temporary holding the value of S.
+
+template <class T, class S, class R, bool Match = SAME_TYPE(T, S)>
+struct SubExprReplacer
+{
+  typedef T Result;
+  static inline const T& Apply(const T& t, const R& r) { return t; }
+};
+
+template <class T, class S, class R>
+struct SubExprReplacer<T, S, R, true>
+{
+  typedef R Result;
+  static inline const R& Apply(const T& t, const R& r) { return r; }
+};
+
+template <class T, class S, class R>
+struct SubExprReplacer<Daixt::Expr<T>, S, R, false>
+{
+  typedef typename SubExprReplacer<T, S, R>::Result Result;
+
+  static inline Result Apply(const Daixt::Expr<T>& E, const R& r) 
+  { 
+    return SubExprReplacer<T, S, R>::Apply(E.content(), r); 
+  }
+};
+
+template <class ARG, class OP, class S, class R>
+struct SubExprReplacer<Daixt::UnOp<ARG, OP>, S, R, false>
+{
+  typedef typename SubExprReplacer<ARG, S, R>::Result NewARG;
+  typedef Daixt::UnOp<NewARG, OP> Result;
+
+  static inline Result Apply(const Daixt::UnOp<ARG, OP>& UO, const R& r) 
+  { 
+    return Result(SubExprReplacer<ARG, S, R>::Apply(UO.arg(), r)); 
+  }
+};
+
+template <class LHS, class RHS, class OP, class S, class R>
+struct SubExprReplacer<Daixt::BinOp<LHS, RHS, OP>, S, R, false>
+{
+  typedef typename SubExprReplacer<LHS, S, R>::Result NewLHS;
+  typedef typename SubExprReplacer<RHS, S, R>::Result NewRHS;
+  typedef Daixt::BinOp<NewLHS, NewRHS, OP> Result;
+
+  static inline Result Apply(const Daixt::BinOp<LHS, RHS, OP>& BO, const R& r) 
+  { 
+    return Result(SubExprReplacer<LHS, S, R>::Apply(BO.lhs(), r),
+                  SubExprReplacer<RHS, S, R>::Apply(BO.rhs(), r)); 
+  }
+};
+
+
+} // namespace ExprManip
+} // namespace Daixt
+
+
+#endif // DAIXT_COMMON_SUB_EXPR_INC
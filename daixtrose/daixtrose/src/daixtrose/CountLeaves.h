@@ -37,6 +37,8 @@
 namespace Daixt 
 {
 
+template <class T, class NewDisambiguation> class DisambiguationChanger;
+
 ////////////////////////////////////////////////////////////////////////////////
 // A simple compile-time counter of leaves
 template <class T>
@@ -57,6 +59,13 @@ struct LeafCounter<Daixt::BinOp<LHS, RHS, OP> >
 };
 
 
+template <class ARG, class OP>
+struct LeafCounter<Daixt::UnOp<ARG, OP> >
+{
+  static const size_t Result = LeafCounter<ARG>::Result;
+};
+
+
 template <class T>
 struct LeafCounter<Daixt::Expr<T> >
 {
@@ -64,6 +73,56 @@ struct LeafCounter<Daixt::Expr<T> >
 };
 
 
+template <class T, class D>
+struct LeafCounter<Daixt::DisambiguationChanger<T, D> >
+{
+  static const size_t Result = LeafCounter<T>::Result;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ... and of all nodes, leaves and operations. This is e.g. the number of
+// intermediate values of an evaluation
+template <class T>
+struct NodeCounter
+{
+  static const size_t Result = 1;
+};
+
+
+template <class LHS, class RHS, class OP>
+struct NodeCounter<Daixt::BinOp<LHS, RHS, OP> >
+{
+  static const size_t Result = 
+    NodeCounter<LHS>::Result 
+    +
+    NodeCounter<RHS>::Result 
+    + 
+    1;
+};
+
+
+template <class ARG, class OP>
+struct NodeCounter<Daixt::UnOp<ARG, OP> >
+{
+  static const size_t Result = NodeCounter<ARG>::Result + 1;
+};
+
+
+template <class T>
+struct NodeCounter<Daixt::Expr<T> >
+{
+  static const size_t Result = NodeCounter<T>::Result;
+};
+
+
+template <class T, class D>
+struct NodeCounter<Daixt::DisambiguationChanger<T, D> >
+{
+  static const size_t Result = NodeCounter<T>::Result;
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // a helper function
 template <class T> inline size_t CountLeaves(const T& t)
@@ -71,6 +130,11 @@ template <class T> inline size_t CountLeaves(const T& t)
   return LeafCounter<T>::Result;
 }
 
+template <class T> inline size_t CountNodes(const T& t)
+{
+  return NodeCounter<T>::Result;
+}
+
 
 } // namespace Daixt
 
@@ -47,10 +47,14 @@
 #include "daixtrose/ExtractOp.h"
 #include "daixtrose/PrettyPrinter.h"
 #include "daixtrose/Scalar.h"
+#include "daixtrose/ScalarFolding.h"
 #include "daixtrose/NeutralElements.h"
 #include "daixtrose/Simplify.h"
 #include "daixtrose/Differentiation.h"
 #include "daixtrose/ChangeDisambiguation.h"
+#include "daixtrose/CommonSubExpr.h"
+#include "daixtrose/Instrumentation.h"
+#include "daixtrose/Profiler.h"
 
 
 #endif
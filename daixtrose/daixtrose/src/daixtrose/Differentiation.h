@@ -484,6 +484,9 @@ private:
   {
     static inline ReturnType Apply(const ArgT& UO)  
     {
+      typedef Daixt::UnOp<Scalar, 
+                          Daixt::DefaultOps::RationalPower<-1, 1> > InverseOfN;
+
       return ReturnType(
                         FactorT(
                                 InverseOfN(Scalar(static_cast<NumericalType>(n))),
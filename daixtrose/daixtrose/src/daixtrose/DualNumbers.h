@@ -0,0 +1,327 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_DUAL_NUMBERS_INC
+#define DAIXT_DUAL_NUMBERS_INC
+
+#include "daixtrose/Expr.h"
+#include "daixtrose/BinOps.h"
+#include "daixtrose/UnOps.h"
+#include "daixtrose/DefaultOps.h"
+#include "daixtrose/ChangeDisambiguation.h"
+#include "daixtrose/LocalDerivatives.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// forward mode: dual numbers
+////////////////////////////////////////////////////////////////////////////////
+
+// Simplify(Diff(e, x)) is exact and free at runtime for small formulas, but
+// the derivative of a product or quotient contains its factors again, so the
+// types (and compile times) grow fast with the depth of the expression.
+//
+// Dual<N> carries a value and N directional derivatives. Its arithmetic and
+// pow follow the chain rule, so the very same OP::Apply functors which
+// evaluate an expression for doubles evaluate it for Dual<N>: one pass
+// through the tree yields the value and all N derivatives, at a cost linear
+// in the size of the expression and in N.
+//
+//   Dual<3> d = ForwardMode::Gradient<3>(e, Point);
+//   d.Value(), d.Derivative(0), d.Derivative(1), d.Derivative(2)
+//
+// The leaves must be known to Differentiation::LeafTraits. Own ops work if
+// their Apply only uses +, -, *, / and pow.
+
+namespace Daixt 
+{
+
+namespace ForwardMode
+{
+
+template <std::size_t N>
+class Dual
+{
+public:
+  // constants: all derivatives vanish
+  inline Dual(double Value = 0.0) : Value_(Value) 
+  {
+    std::fill(Derivative_, Derivative_ + N, 0.0);
+  }
+
+  inline Dual(double Value, const double* Derivatives) : Value_(Value) 
+  {
+    std::copy(Derivatives, Derivatives + N, Derivative_);
+  }
+
+  inline double Value() const { return Value_; }
+  inline double Derivative(std::size_t k) const { return Derivative_[k]; }
+
+  inline double& Value() { return Value_; }
+  inline double& Derivative(std::size_t k) { return Derivative_[k]; }
+
+  inline const double* Derivatives() const { return Derivative_; }
+
+private:
+  double Value_;
+  double Derivative_[N];
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the chain rule. These are found via ADL from inside OP::Apply and win
+// against the expression building operators of DefaultOps, which are less
+// specialized.
+
+template <std::size_t N>
+inline Dual<N> operator+(const Dual<N>& a)
+{
+  return a;
+}
+
+template <std::size_t N>
+inline Dual<N> operator-(const Dual<N>& a)
+{
+  Dual<N> Result(-a.Value());
+  for (std::size_t k = 0; k != N; ++k) Result.Derivative(k) = -a.Derivative(k);
+  return Result;
+}
+
+template <std::size_t N>
+inline Dual<N> operator+(const Dual<N>& a, const Dual<N>& b)
+{
+  Dual<N> Result(a.Value() + b.Value());
+  for (std::size_t k = 0; k != N; ++k) 
+    Result.Derivative(k) = a.Derivative(k) + b.Derivative(k);
+  return Result;
+}
+
+template <std::size_t N>
+inline Dual<N> operator-(const Dual<N>& a, const Dual<N>& b)
+{
+  Dual<N> Result(a.Value() - b.Value());
+  for (std::size_t k = 0; k != N; ++k) 
+    Result.Derivative(k) = a.Derivative(k) - b.Derivative(k);
+  return Result;
+}
+
+template <std::size_t N>
+inline Dual<N> operator*(const Dual<N>& a, const Dual<N>& b)
+{
+  Dual<N> Result(a.Value() * b.Value());
+  for (std::size_t k = 0; k != N; ++k) 
+    Result.Derivative(k) = 
+      a.Derivative(k) * b.Value() + a.Value() * b.Derivative(k);
+  return Result;
+}
+
+// (a/b)' = (a' - (a/b) b') / b
+template <std::size_t N>
+inline Dual<N> operator/(const Dual<N>& a, const Dual<N>& b)
+{
+  const double Value = a.Value() / b.Value();
+  const double Inverse = 1.0 / b.Value();
+
+  Dual<N> Result(Value);
+  for (std::size_t k = 0; k != N; ++k) 
+    Result.Derivative(k) = (a.Derivative(k) - Value * b.Derivative(k)) * Inverse;
+  return Result;
+}
+
+// (a^p)' = p a^(p - 1) a'
+template <std::size_t N>
+inline Dual<N> pow(const Dual<N>& a, double p)
+{
+  const double Factor = p * std::pow(a.Value(), p - 1.0);
+
+  Dual<N> Result(std::pow(a.Value(), p));
+  for (std::size_t k = 0; k != N; ++k) 
+    Result.Derivative(k) = Factor * a.Derivative(k);
+  return Result;
+}
+
+
+namespace Private
+{
+
+using Daixt::Differentiation::LeafTraits;
+
+
+// the derivatives of variable k are Directions[k * N], ..., 
+// Directions[k * N + N - 1] 
+template <std::size_t N>
+struct DirectionSeeds
+{
+  typedef Dual<N> DualT;
+
+  DirectionSeeds(const double* Point, const double* Directions)
+    : Point_(Point), Directions_(Directions) {}
+
+  inline Dual<N> Variable(std::size_t k) const
+  {
+    return Dual<N>(Point_[k], Directions_ + k * N);
+  }
+
+  const double* Point_;
+  const double* Directions_;
+};
+
+
+// variable k has the unit vector e_k as derivatives: the gradient
+template <std::size_t N>
+struct UnitSeeds
+{
+  typedef Dual<N> DualT;
+
+  explicit UnitSeeds(const double* Point) : Point_(Point) {}
+
+  inline Dual<N> Variable(std::size_t k) const
+  {
+    Dual<N> Result(Point_[k]);
+    Result.Derivative(k) = 1.0;
+    return Result;
+  }
+
+  const double* Point_;
+};
+
+
+template <bool IsVariable> struct LeafValue;
+
+template <> struct LeafValue<true>
+{
+  template <class T, class Seeds>
+  static inline typename Seeds::DualT Apply(const T& t, const Seeds& S)
+  {
+    return S.Variable(LeafTraits<T>::Number(t));
+  }
+};
+
+template <> struct LeafValue<false>
+{
+  template <class T, class Seeds>
+  static inline typename Seeds::DualT Apply(const T& t, const Seeds&)
+  {
+    return typename Seeds::DualT(LeafTraits<T>::Value(t));
+  }
+};
+
+
+template <class T> 
+struct Evaluator
+{
+  template <class Seeds>
+  static inline typename Seeds::DualT Apply(const T& t, const Seeds& S)
+  {
+    return LeafValue<LeafTraits<T>::is_variable>::Apply(t, S);
+  }
+};
+
+template <class T> 
+struct Evaluator<Daixt::Expr<T> >
+{
+  template <class Seeds>
+  static inline typename Seeds::DualT Apply(const Daixt::Expr<T>& E, 
+                                            const Seeds& S)
+  {
+    return Evaluator<T>::Apply(E.content(), S);
+  }
+};
+
+// content() is not a DisambiguationChanger here
+template <class T, class D> 
+struct Evaluator<Daixt::Expr<Daixt::DisambiguationChanger<T, D> > >
+{
+  template <class Seeds>
+  static inline typename Seeds::DualT 
+  Apply(const Daixt::Expr<Daixt::DisambiguationChanger<T, D> >& E, 
+        const Seeds& S)
+  {
+    return Evaluator<T>::Apply(E.content(), S);
+  }
+};
+
+template <class ARG, class OP> 
+struct Evaluator<Daixt::UnOp<ARG, OP> >
+{
+  template <class Seeds>
+  static inline typename Seeds::DualT Apply(const Daixt::UnOp<ARG, OP>& UO, 
+                                            const Seeds& S)
+  {
+    typedef typename Seeds::DualT DualT;
+    return OP::Apply(Evaluator<ARG>::Apply(UO.arg(), S), Daixt::Hint<DualT>());
+  }
+};
+
+template <class LHS, class RHS, class OP> 
+struct Evaluator<Daixt::BinOp<LHS, RHS, OP> >
+{
+  template <class Seeds>
+  static inline typename Seeds::DualT 
+  Apply(const Daixt::BinOp<LHS, RHS, OP>& BO, const Seeds& S)
+  {
+    typedef typename Seeds::DualT DualT;
+    return OP::Apply(Evaluator<LHS>::Apply(BO.lhs(), S), 
+                     Evaluator<RHS>::Apply(BO.rhs(), S), 
+                     Daixt::Hint<DualT>());
+  }
+};
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the value of e at Point and its derivatives along N directions, see
+// DirectionSeeds for the layout of Directions
+
+template <std::size_t N, class T>
+inline Dual<N> 
+Evaluate(const T& e, const double* Point, const double* Directions)
+{
+  return Private::Evaluator<T>::Apply(e, 
+                                      Private::DirectionSeeds<N>(Point, 
+                                                                 Directions));
+}
+
+
+// value and d(e)/d(x_k), k < N. The variables' numbers must be smaller than N.
+template <std::size_t N, class T>
+inline Dual<N> Gradient(const T& e, const double* Point)
+{
+  return Private::Evaluator<T>::Apply(e, Private::UnitSeeds<N>(Point));
+}
+
+} // namespace ForwardMode
+
+} // namespace Daixt 
+
+
+#endif // DAIXT_DUAL_NUMBERS_INC
@@ -0,0 +1,996 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_DYNAMIC_INC
+#define DAIXT_DYNAMIC_INC
+
+#include "daixtrose/Expr.h"
+#include "daixtrose/BinOps.h"
+#include "daixtrose/UnOps.h"
+#include "daixtrose/Scalar.h"
+#include "daixtrose/NeutralElements.h"
+#include "daixtrose/DefaultOps.h"
+#include "daixtrose/ChangeDisambiguation.h"
+#include "daixtrose/LocalDerivatives.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/lexical_cast.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Dynamic: expression graphs built at runtime
+////////////////////////////////////////////////////////////////////////////////
+
+// Every Daixt expression is a type. Formulas which are only known at runtime
+// (read from an input file, supplied by a user) need a representation which
+// is data: Graph holds the nodes of any number of expressions. A node refers
+// to earlier nodes only, and identical nodes are stored once, so common
+// subexpressions are shared automatically and the nodes are always in a
+// valid order of evaluation.
+//
+// The nodes mirror the static expressions: constants (Scalar, IsNull and
+// IsOne), variables, the arithmetic of BinOp and UnaryMinus, RationalPower
+// with runtime exponents, and all other ops known to Daixt, which are
+// called via a pointer to OP::Apply.
+//
+// Graph::Simplify applies the rules of Simplify.h, Graph::Diff
+// differentiates symbolically like Differentiation.h. Both remember their
+// results per node, so shared subexpressions are processed once. A static
+// expression is converted by Graph::Convert, its leaves are seen through
+// Differentiation::LeafTraits (see LocalDerivatives.h).
+//
+// Evaluator evaluates a set of nodes of a Graph: it collects the nodes they
+// need once, then every evaluation is one pass through that list. For many
+// points compile the nodes with Tape::Compiler (see Tape.h).
+//
+//   Daixt::Dynamic::Graph G;
+//   std::size_t f = G.Convert(x * x + Sqrt(y));
+//   std::size_t dfdx = G.Simplify(G.Diff(f, 0));
+//   Daixt::Dynamic::Evaluator E(G, dfdx);
+
+namespace Daixt 
+{
+
+namespace Dynamic
+{
+
+enum Kind 
+{ 
+  constant, 
+  variable, 
+  plus, 
+  minus, 
+  multiply, 
+  divide, 
+  negate, 
+  power,        // Lhs^(m/n)
+  call_unary, 
+  call_binary 
+};
+
+
+// Lhs and Rhs are node numbers, a variable keeps its number in Lhs
+struct Node
+{
+  Kind What;
+  std::size_t Lhs;
+  std::size_t Rhs;
+  double Constant;
+  int m;
+  int n;
+  double (*Unary)(double);
+  double (*Binary)(double, double);
+};
+
+
+class Graph;
+
+// user-extensible via specialization
+template <class T> struct ConvertImpl;
+
+
+namespace Private
+{
+
+template <class OP> double CallUnary(double a) 
+{ 
+  return OP::Apply(a, Daixt::Hint<double>()); 
+}
+
+template <class OP> double CallBinary(double a, double b) 
+{ 
+  return OP::Apply(a, b, Daixt::Hint<double>()); 
+}
+
+inline Node MakeNode(Kind What, std::size_t Lhs = 0, std::size_t Rhs = 0)
+{
+  Node Result;
+  Result.What = What;
+  Result.Lhs = Lhs;
+  Result.Rhs = Rhs;
+  Result.Constant = 0.0;
+  Result.m = 1;
+  Result.n = 1;
+  Result.Unary = 0;
+  Result.Binary = 0;
+  return Result;
+}
+
+inline bool IsUnary(Kind What)
+{
+  return What == negate || What == power || What == call_unary;
+}
+
+inline bool IsLeaf(Kind What)
+{
+  return What == constant || What == variable;
+}
+
+inline int GreatestCommonDivisor(int a, int b)
+{
+  if (a < 0) a = -a;
+  if (b < 0) b = -b;
+  while (b != 0)
+    {
+      const int r = a % b;
+      a = b;
+      b = r;
+    }
+  return a;
+}
+
+// a^(m/n)
+inline double Power(double a, int m, int n)
+{
+  if (n == 1) return (m == -1) ? 1.0 / a : std::pow(a, m);
+  if (m == 1 && n == 2) return std::sqrt(a);
+  return std::pow(a, static_cast<double>(m) / static_cast<double>(n));
+}
+
+inline double Apply(const Node& N, double a, double b)
+{
+  switch (N.What)
+    {
+    case plus: return a + b;
+    case minus: return a - b;
+    case multiply: return a * b;
+    case divide: return a / b;
+    case negate: return -a;
+    case power: return Power(a, N.m, N.n);
+    case call_unary: return N.Unary(a);
+    case call_binary: return N.Binary(a, b);
+    default: 
+      throw std::logic_error("Daixt::Dynamic: not an operation");
+    }
+}
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Graph
+
+class Graph
+{
+public:
+  inline Graph() : NumberOfVariables_(0) {}
+
+  // the nodes, built as they are: no simplification here
+  inline std::size_t Constant(double Value);
+  inline std::size_t Variable(std::size_t Number); // counted from 0
+  inline std::size_t Plus(std::size_t Lhs, std::size_t Rhs);
+  inline std::size_t Minus(std::size_t Lhs, std::size_t Rhs);
+  inline std::size_t Multiply(std::size_t Lhs, std::size_t Rhs);
+  inline std::size_t Divide(std::size_t Lhs, std::size_t Rhs);
+  inline std::size_t Negate(std::size_t Arg);
+  inline std::size_t Power(std::size_t Arg, int m, int n = 1);
+  inline std::size_t Call(double (*F)(double), std::size_t Arg);
+  inline std::size_t Call(double (*F)(double, double), 
+                          std::size_t Lhs, std::size_t Rhs);
+
+  // any of the above, e.g. a node of another graph with renumbered operands
+  inline std::size_t Add(const Daixt::Dynamic::Node& N);
+
+  template <class T> inline std::size_t Convert(const T& Expression)
+  {
+    return ConvertImpl<T>::Apply(Expression, *this);
+  }
+
+  // the same rules as Simplify.h
+  inline std::size_t Simplify(std::size_t Node);
+
+  // d(Node)/d(Variable), throws for ops called via pointers
+  inline std::size_t Diff(std::size_t Node, std::size_t Variable);
+
+  inline const Daixt::Dynamic::Node& operator[](std::size_t Node) const
+  {
+    return Nodes_[Node];
+  }
+
+  inline std::size_t NumberOfNodes() const { return Nodes_.size(); }
+  inline std::size_t NumberOfVariables() const { return NumberOfVariables_; }
+
+  inline bool IsConstant(std::size_t Node, double Value) const
+  {
+    return Nodes_[Node].What == constant && Nodes_[Node].Constant == Value;
+  }
+
+  // one-off evaluation, see Evaluator for repeated ones
+  inline double Evaluate(std::size_t Node, const double* Point) const;
+
+  inline std::string GetName(std::size_t Node) const;
+
+private:
+  inline std::size_t Insert(const Daixt::Dynamic::Node& N);
+  inline void CheckNode(std::size_t Node, const char* Where) const;
+
+  // the rules, applied to simplified arguments
+  inline std::size_t SimplerNegate(std::size_t Arg);
+  inline std::size_t SimplerPower(std::size_t Arg, int m, int n);
+  inline std::size_t SimplerMultiply(std::size_t Lhs, std::size_t Rhs);
+  inline std::size_t SimplerPlus(std::size_t Lhs, std::size_t Rhs);
+
+  inline void Print(std::ostream& os, std::size_t Node) const;
+
+  struct Less
+  {
+    inline bool operator()(const Daixt::Dynamic::Node& lhs, 
+                           const Daixt::Dynamic::Node& rhs) const
+    {
+      if (lhs.What != rhs.What) return lhs.What < rhs.What;
+      if (lhs.Lhs != rhs.Lhs) return lhs.Lhs < rhs.Lhs;
+      if (lhs.Rhs != rhs.Rhs) return lhs.Rhs < rhs.Rhs;
+      if (lhs.m != rhs.m) return lhs.m < rhs.m;
+      if (lhs.n != rhs.n) return lhs.n < rhs.n;
+      if (lhs.Unary != rhs.Unary) 
+        return std::less<double (*)(double)>()(lhs.Unary, rhs.Unary);
+      if (lhs.Binary != rhs.Binary) 
+        return std::less<double (*)(double, double)>()(lhs.Binary, 
+                                                       rhs.Binary);
+      // bitwise: 0.0 and -0.0 are different constants
+      return std::memcmp(&lhs.Constant, &rhs.Constant, sizeof(double)) < 0;
+    }
+  };
+
+  std::vector<Daixt::Dynamic::Node> Nodes_;
+  std::map<Daixt::Dynamic::Node, std::size_t, Less> Known_;
+  std::vector<std::size_t> Simplified_;
+  std::map<std::pair<std::size_t, std::size_t>, std::size_t> Derivatives_;
+  std::size_t NumberOfVariables_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Evaluator: the nodes needed for some outputs, in order of evaluation
+
+class Evaluator
+{
+public:
+  inline Evaluator(const Graph& G, const std::vector<std::size_t>& Outputs)
+    : Graph_(G), Outputs_(Outputs)
+  {
+    Collect();
+  }
+
+  inline Evaluator(const Graph& G, std::size_t Output)
+    : Graph_(G), Outputs_(1, Output)
+  {
+    Collect();
+  }
+
+  inline std::size_t NumberOfOutputs() const { return Outputs_.size(); }
+
+  // the number of nodes evaluated per point
+  inline std::size_t NumberOfNodes() const { return Order_.size(); }
+
+  // Results[o] for one point
+  inline void Evaluate(const double* Point, double* Results) const;
+
+  inline double operator()(const double* Point) const
+  {
+    double Result;
+    Evaluate(Point, &Result);
+    return Result;
+  }
+
+private:
+  inline void Collect();
+
+  const Graph& Graph_;
+  std::vector<std::size_t> Outputs_;
+  std::vector<std::size_t> Order_;    // nodes of the graph to evaluate
+  std::vector<std::size_t> Slot_;     // node of the graph -> place in Values_
+  mutable std::vector<double> Values_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Graph: building nodes
+
+inline void Graph::CheckNode(std::size_t Node, const char* Where) const
+{
+  if (Node >= Nodes_.size())
+    {
+      throw std::range_error(std::string("Daixt::Dynamic::Graph::") + Where 
+                             + ": no such node " 
+                             + boost::lexical_cast<std::string>(Node));
+    }
+}
+
+
+inline std::size_t Graph::Insert(const Daixt::Dynamic::Node& N)
+{
+  std::map<Daixt::Dynamic::Node, std::size_t, Less>::const_iterator Found = 
+    Known_.find(N);
+  if (Found != Known_.end()) return Found->second;
+
+  Nodes_.push_back(N);
+  Known_.insert(std::make_pair(N, Nodes_.size() - 1));
+  return Nodes_.size() - 1;
+}
+
+
+inline std::size_t Graph::Constant(double Value)
+{
+  Daixt::Dynamic::Node N = Private::MakeNode(constant);
+  N.Constant = Value;
+  return Insert(N);
+}
+
+
+inline std::size_t Graph::Variable(std::size_t Number)
+{
+  if (Number + 1 > NumberOfVariables_) NumberOfVariables_ = Number + 1;
+  return Insert(Private::MakeNode(variable, Number));
+}
+
+
+inline std::size_t Graph::Plus(std::size_t Lhs, std::size_t Rhs)
+{
+  CheckNode(Lhs, "Plus");
+  CheckNode(Rhs, "Plus");
+  return Insert(Private::MakeNode(plus, Lhs, Rhs));
+}
+
+
+inline std::size_t Graph::Minus(std::size_t Lhs, std::size_t Rhs)
+{
+  CheckNode(Lhs, "Minus");
+  CheckNode(Rhs, "Minus");
+  return Insert(Private::MakeNode(minus, Lhs, Rhs));
+}
+
+
+inline std::size_t Graph::Multiply(std::size_t Lhs, std::size_t Rhs)
+{
+  CheckNode(Lhs, "Multiply");
+  CheckNode(Rhs, "Multiply");
+  return Insert(Private::MakeNode(multiply, Lhs, Rhs));
+}
+
+
+inline std::size_t Graph::Divide(std::size_t Lhs, std::size_t Rhs)
+{
+  CheckNode(Lhs, "Divide");
+  CheckNode(Rhs, "Divide");
+  return Insert(Private::MakeNode(divide, Lhs, Rhs));
+}
+
+
+inline std::size_t Graph::Negate(std::size_t Arg)
+{
+  CheckNode(Arg, "Negate");
+  return Insert(Private::MakeNode(negate, Arg));
+}
+
+
+inline std::size_t Graph::Power(std::size_t Arg, int m, int n)
+{
+  CheckNode(Arg, "Power");
+  if (n == 0) 
+    throw std::invalid_argument("Daixt::Dynamic::Graph::Power: n == 0");
+
+  Daixt::Dynamic::Node N = Private::MakeNode(power, Arg);
+  N.m = m;
+  N.n = n;
+  return Insert(N);
+}
+
+
+inline std::size_t Graph::Call(double (*F)(double), std::size_t Arg)
+{
+  CheckNode(Arg, "Call");
+  Daixt::Dynamic::Node N = Private::MakeNode(call_unary, Arg);
+  N.Unary = F;
+  return Insert(N);
+}
+
+
+inline std::size_t Graph::Call(double (*F)(double, double), 
+                               std::size_t Lhs, std::size_t Rhs)
+{
+  CheckNode(Lhs, "Call");
+  CheckNode(Rhs, "Call");
+  Daixt::Dynamic::Node N = Private::MakeNode(call_binary, Lhs, Rhs);
+  N.Binary = F;
+  return Insert(N);
+}
+
+
+inline std::size_t Graph::Add(const Daixt::Dynamic::Node& N)
+{
+  switch (N.What)
+    {
+    case constant: return Constant(N.Constant);
+    case variable: return Variable(N.Lhs);
+    case plus: return Plus(N.Lhs, N.Rhs);
+    case minus: return Minus(N.Lhs, N.Rhs);
+    case multiply: return Multiply(N.Lhs, N.Rhs);
+    case divide: return Divide(N.Lhs, N.Rhs);
+    case negate: return Negate(N.Lhs);
+    case power: return Power(N.Lhs, N.m, N.n);
+    case call_unary: return Call(N.Unary, N.Lhs);
+    case call_binary: return Call(N.Binary, N.Lhs, N.Rhs);
+    }
+  throw std::logic_error("Daixt::Dynamic::Graph::Add: unknown node");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Graph: Simplify
+
+// -(-x) = x
+inline std::size_t Graph::SimplerNegate(std::size_t Arg)
+{
+  const Daixt::Dynamic::Node& A = Nodes_[Arg];
+  if (A.What == constant) return Constant(-A.Constant);
+  if (A.What == negate) return A.Lhs;
+  return Negate(Arg);
+}
+
+
+// 0^a = 0, 1^a = 1, x^0 = 1, x^1 = x, (x^a)^b = x^(a*b), 
+// (x*y)^a = x^a * y^a
+inline std::size_t Graph::SimplerPower(std::size_t Arg, int m, int n)
+{
+  // RationalPower<m, -n> is RationalPower<-m, n>
+  if (n < 0)
+    {
+      m = -m;
+      n = -n;
+    }
+  const int d = Private::GreatestCommonDivisor(m, n);
+  if (d > 1)
+    {
+      m /= d;
+      n /= d;
+    }
+
+  if (m == 0 || IsConstant(Arg, 1.0)) return Constant(1.0);
+  if (m > 0 && IsConstant(Arg, 0.0)) return Constant(0.0);
+  if (m == n) return Arg;
+
+  const Daixt::Dynamic::Node A = Nodes_[Arg];
+  switch (A.What)
+    {
+    case constant:
+      return Constant(Private::Power(A.Constant, m, n));
+    case power:
+      return SimplerPower(A.Lhs, m * A.m, n * A.n);
+    case multiply:
+      return SimplerMultiply(SimplerPower(A.Lhs, m, n), 
+                             SimplerPower(A.Rhs, m, n));
+    default:
+      return Power(Arg, m, n);
+    }
+}
+
+
+// 0 * x = 0, 1 * x = x, a * (-b) = (-a) * b = -(a * b), (-a) * (-b) = a * b
+inline std::size_t Graph::SimplerMultiply(std::size_t Lhs, std::size_t Rhs)
+{
+  if (IsConstant(Lhs, 0.0) || IsConstant(Rhs, 0.0)) return Constant(0.0);
+  if (IsConstant(Lhs, 1.0)) return Rhs;
+  if (IsConstant(Rhs, 1.0)) return Lhs;
+
+  const Daixt::Dynamic::Node L = Nodes_[Lhs];
+  const Daixt::Dynamic::Node R = Nodes_[Rhs];
+
+  if (L.What == constant && R.What == constant)
+    return Constant(L.Constant * R.Constant);
+
+  if (L.What == negate && R.What == negate) 
+    return SimplerMultiply(L.Lhs, R.Lhs);
+  if (L.What == negate) return SimplerNegate(SimplerMultiply(L.Lhs, Rhs));
+  if (R.What == negate) return SimplerNegate(SimplerMultiply(Lhs, R.Lhs));
+
+  return Multiply(Lhs, Rhs);
+}
+
+
+// 0 + x = x, x + (-x) = 0, x + x = 2 * x
+inline std::size_t Graph::SimplerPlus(std::size_t Lhs, std::size_t Rhs)
+{
+  if (IsConstant(Lhs, 0.0)) return Rhs;
+  if (IsConstant(Rhs, 0.0)) return Lhs;
+
+  const Daixt::Dynamic::Node L = Nodes_[Lhs];
+  const Daixt::Dynamic::Node R = Nodes_[Rhs];
+
+  if (L.What == constant && R.What == constant)
+    return Constant(L.Constant + R.Constant);
+
+  if ((R.What == negate && R.Lhs == Lhs) || (L.What == negate && L.Lhs == Rhs))
+    return Constant(0.0);
+
+  if (Lhs == Rhs) return SimplerMultiply(Constant(2.0), Lhs);
+
+  return Plus(Lhs, Rhs);
+}
+
+
+inline std::size_t Graph::Simplify(std::size_t Node)
+{
+  CheckNode(Node, "Simplify");
+
+  const std::size_t Unknown = static_cast<std::size_t>(-1);
+  if (Simplified_.size() < Nodes_.size()) 
+    Simplified_.resize(Nodes_.size(), Unknown);
+  if (Simplified_[Node] != Unknown) return Simplified_[Node];
+
+  // a copy: the rules add nodes
+  const Daixt::Dynamic::Node N = Nodes_[Node];
+  std::size_t Result = Node;
+
+  switch (N.What)
+    {
+    case constant:
+    case variable:
+      break;
+    case plus:
+      Result = SimplerPlus(Simplify(N.Lhs), Simplify(N.Rhs));
+      break;
+    case minus: // a - b = a + (-b)
+      Result = SimplerPlus(Simplify(N.Lhs), SimplerNegate(Simplify(N.Rhs)));
+      break;
+    case multiply:
+      Result = SimplerMultiply(Simplify(N.Lhs), Simplify(N.Rhs));
+      break;
+    case divide: // a / a = 1, a / b = a * b^(-1)
+      {
+        const std::size_t Lhs = Simplify(N.Lhs);
+        const std::size_t Rhs = Simplify(N.Rhs);
+        if (IsConstant(Rhs, 0.0))
+          throw std::domain_error("Daixt::Dynamic::Graph::Simplify: "
+                                  "division by zero");
+        Result = (Lhs == Rhs) ? Constant(1.0) 
+          : SimplerMultiply(Lhs, SimplerPower(Rhs, -1, 1));
+      }
+      break;
+    case negate:
+      Result = SimplerNegate(Simplify(N.Lhs));
+      break;
+    case power:
+      Result = SimplerPower(Simplify(N.Lhs), N.m, N.n);
+      break;
+    case call_unary:
+      {
+        const std::size_t Arg = Simplify(N.Lhs);
+        Result = (Nodes_[Arg].What == constant) 
+          ? Constant(N.Unary(Nodes_[Arg].Constant)) : Call(N.Unary, Arg);
+      }
+      break;
+    case call_binary:
+      {
+        const std::size_t Lhs = Simplify(N.Lhs);
+        const std::size_t Rhs = Simplify(N.Rhs);
+        Result = (Nodes_[Lhs].What == constant && Nodes_[Rhs].What == constant)
+          ? Constant(N.Binary(Nodes_[Lhs].Constant, Nodes_[Rhs].Constant)) 
+          : Call(N.Binary, Lhs, Rhs);
+      }
+      break;
+    }
+
+  // the result is simplified already
+  Simplified_.resize(Nodes_.size(), Unknown);
+  Simplified_[Node] = Result;
+  Simplified_[Result] = Result;
+  return Result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Graph: Diff
+
+inline std::size_t Graph::Diff(std::size_t Node, std::size_t Variable)
+{
+  CheckNode(Node, "Diff");
+
+  const std::pair<std::size_t, std::size_t> Key(Node, Variable);
+  std::map<std::pair<std::size_t, std::size_t>, std::size_t>::const_iterator 
+    Found = Derivatives_.find(Key);
+  if (Found != Derivatives_.end()) return Found->second;
+
+  // a copy: Diff adds nodes
+  const Daixt::Dynamic::Node N = Nodes_[Node];
+  std::size_t Result = 0;
+
+  switch (N.What)
+    {
+    case constant:
+      Result = Constant(0.0);
+      break;
+    case variable:
+      Result = Constant(N.Lhs == Variable ? 1.0 : 0.0);
+      break;
+    case plus:
+      Result = Plus(Diff(N.Lhs, Variable), Diff(N.Rhs, Variable));
+      break;
+    case minus:
+      Result = Minus(Diff(N.Lhs, Variable), Diff(N.Rhs, Variable));
+      break;
+    case multiply:
+      Result = Plus(Multiply(Diff(N.Lhs, Variable), N.Rhs),
+                    Multiply(N.Lhs, Diff(N.Rhs, Variable)));
+      break;
+    case divide:
+      Result = Divide(Minus(Multiply(Diff(N.Lhs, Variable), N.Rhs),
+                            Multiply(N.Lhs, Diff(N.Rhs, Variable))),
+                      Multiply(N.Rhs, N.Rhs));
+      break;
+    case negate:
+      Result = Negate(Diff(N.Lhs, Variable));
+      break;
+    case power: // (m/n) * x^((m-n)/n) * dx
+      Result = Multiply(Multiply(Constant(static_cast<double>(N.m) 
+                                          / static_cast<double>(N.n)), 
+                                 Power(N.Lhs, N.m - N.n, N.n)),
+                        Diff(N.Lhs, Variable));
+      break;
+    case call_unary:
+    case call_binary:
+      throw std::invalid_argument("Daixt::Dynamic::Graph::Diff: no derivative "
+                                  "known for node " 
+                                  + boost::lexical_cast<std::string>(Node));
+    }
+
+  Derivatives_.insert(std::make_pair(Key, Result));
+  return Result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Graph: evaluation and printing
+
+inline double Graph::Evaluate(std::size_t Node, const double* Point) const
+{
+  CheckNode(Node, "Evaluate");
+  return Evaluator(*this, Node)(Point);
+}
+
+
+inline void Graph::Print(std::ostream& os, std::size_t Node) const
+{
+  const Daixt::Dynamic::Node& N = Nodes_[Node];
+  switch (N.What)
+    {
+    case constant: os << N.Constant; return;
+    case variable: os << 'x' << N.Lhs; return;
+    case negate: os << "-"; break;
+    case power: os << "pow"; break;
+    case call_unary: 
+    case call_binary: os << 'f'; break;
+    default: break;
+    }
+
+  os << '(';
+  Print(os, N.Lhs);
+  switch (N.What)
+    {
+    case plus: os << " + "; break;
+    case minus: os << " - "; break;
+    case multiply: os << " * "; break;
+    case divide: os << " / "; break;
+    case power: os << ", " << N.m << "/" << N.n; break;
+    case call_binary: os << ", "; break;
+    default: break;
+    }
+  if (!Private::IsUnary(N.What)) Print(os, N.Rhs);
+  os << ')';
+}
+
+
+inline std::string Graph::GetName(std::size_t Node) const
+{
+  CheckNode(Node, "GetName");
+  std::ostringstream os;
+  Print(os, Node);
+  return os.str();
+}
+
+
+// the residuals followed by d(Residual[i])/d(x[j]) in row-major order, 
+// simplified: the outputs for an Evaluator or a CodeGenerator
+inline std::vector<std::size_t> 
+ResidualAndJacobian(Graph& G, const std::vector<std::size_t>& Residuals, 
+                    std::size_t NumberOfVariables)
+{
+  std::vector<std::size_t> Result(Residuals);
+  for (std::size_t i = 0; i != Residuals.size(); ++i)
+    {
+      for (std::size_t j = 0; j != NumberOfVariables; ++j)
+        {
+          Result.push_back(G.Simplify(G.Diff(Residuals[i], j)));
+        }
+    }
+  return Result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Evaluator
+
+namespace Private
+{
+
+// the nodes some outputs depend on, in order of evaluation
+inline void CollectNodes(const Graph& G, 
+                         const std::vector<std::size_t>& Outputs, 
+                         const char* Who, 
+                         std::vector<std::size_t>& Order)
+{
+  const std::size_t n = G.NumberOfNodes();
+
+  for (std::size_t o = 0; o != Outputs.size(); ++o)
+    {
+      if (Outputs[o] >= n)
+        throw std::range_error(std::string(Who) + ": no such node " 
+                               + boost::lexical_cast<std::string>
+                               (Outputs[o]));
+    }
+
+  // nodes only refer to earlier nodes
+  std::vector<bool> Needed(n, false);
+  for (std::size_t o = 0; o != Outputs.size(); ++o) Needed[Outputs[o]] = true;
+
+  for (std::size_t k = n; k != 0; --k)
+    {
+      const Node& N = G[k - 1];
+      if (!Needed[k - 1] || IsLeaf(N.What)) continue;
+      Needed[N.Lhs] = true;
+      if (!IsUnary(N.What)) Needed[N.Rhs] = true;
+    }
+
+  Order.clear();
+  for (std::size_t k = 0; k != n; ++k)
+    {
+      if (Needed[k]) Order.push_back(k);
+    }
+}
+
+} // namespace Private
+
+
+inline void Evaluator::Collect()
+{
+  Private::CollectNodes(Graph_, Outputs_, "Daixt::Dynamic::Evaluator", Order_);
+
+  Slot_.assign(Graph_.NumberOfNodes(), static_cast<std::size_t>(-1));
+  for (std::size_t i = 0; i != Order_.size(); ++i) Slot_[Order_[i]] = i;
+
+  Values_.resize(Order_.size() + 1);
+}
+
+
+inline void Evaluator::Evaluate(const double* Point, double* Results) const
+{
+  for (std::size_t i = 0; i != Order_.size(); ++i)
+    {
+      const Node& N = Graph_[Order_[i]];
+      switch (N.What)
+        {
+        case constant: 
+          Values_[i] = N.Constant; 
+          break;
+        case variable: 
+          Values_[i] = Point[N.Lhs]; 
+          break;
+        default:
+          Values_[i] = 
+            Private::Apply(N, Values_[Slot_[N.Lhs]], 
+                           Private::IsUnary(N.What) ? 0.0 
+                           : Values_[Slot_[N.Rhs]]);
+        }
+    }
+
+  for (std::size_t o = 0; o != Outputs_.size(); ++o)
+    {
+      Results[o] = Values_[Slot_[Outputs_[o]]];
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// conversion of static expressions
+
+namespace Private
+{
+
+template <class T, bool IsVariable> struct ConvertLeaf
+{
+  static inline std::size_t Apply(const T& t, Graph& G)
+  {
+    return G.Constant(Daixt::Differentiation::LeafTraits<T>::Value(t));
+  }
+};
+
+template <class T> struct ConvertLeaf<T, true>
+{
+  static inline std::size_t Apply(const T& t, Graph& G)
+  {
+    return G.Variable(Daixt::Differentiation::LeafTraits<T>::Number(t));
+  }
+};
+
+// ops without a node of their own are called via pointer
+template <class OP> struct UnaryNode
+{
+  static inline std::size_t Apply(std::size_t Arg, Graph& G)
+  {
+    return G.Call(&CallUnary<OP>, Arg);
+  }
+};
+
+template <> struct UnaryNode<Daixt::DefaultOps::UnaryPlus>
+{
+  static inline std::size_t Apply(std::size_t Arg, Graph&) { return Arg; }
+};
+
+template <> struct UnaryNode<Daixt::DefaultOps::UnaryMinus>
+{
+  static inline std::size_t Apply(std::size_t Arg, Graph& G) 
+  { 
+    return G.Negate(Arg); 
+  }
+};
+
+template <int m, int n> 
+struct UnaryNode<Daixt::DefaultOps::RationalPower<m, n> >
+{
+  static inline std::size_t Apply(std::size_t Arg, Graph& G) 
+  { 
+    return G.Power(Arg, m, n); 
+  }
+};
+
+template <class OP> struct BinaryNode
+{
+  static inline std::size_t Apply(std::size_t Lhs, std::size_t Rhs, Graph& G)
+  {
+    return G.Call(&CallBinary<OP>, Lhs, Rhs);
+  }
+};
+
+template <> struct BinaryNode<Daixt::DefaultOps::BinaryPlus>
+{
+  static inline std::size_t Apply(std::size_t Lhs, std::size_t Rhs, Graph& G)
+  {
+    return G.Plus(Lhs, Rhs);
+  }
+};
+
+template <> struct BinaryNode<Daixt::DefaultOps::BinaryMinus>
+{
+  static inline std::size_t Apply(std::size_t Lhs, std::size_t Rhs, Graph& G)
+  {
+    return G.Minus(Lhs, Rhs);
+  }
+};
+
+template <> struct BinaryNode<Daixt::DefaultOps::BinaryMultiply>
+{
+  static inline std::size_t Apply(std::size_t Lhs, std::size_t Rhs, Graph& G)
+  {
+    return G.Multiply(Lhs, Rhs);
+  }
+};
+
+template <> struct BinaryNode<Daixt::DefaultOps::BinaryDivide>
+{
+  static inline std::size_t Apply(std::size_t Lhs, std::size_t Rhs, Graph& G)
+  {
+    return G.Divide(Lhs, Rhs);
+  }
+};
+
+} // namespace Private
+
+
+// leaves
+template <class T> struct ConvertImpl
+{
+  static inline std::size_t Apply(const T& t, Graph& G)
+  {
+    return Private::ConvertLeaf<T, Daixt::Differentiation::LeafTraits<T>
+      ::is_variable>::Apply(t, G);
+  }
+};
+
+template <class T> struct ConvertImpl<Daixt::Expr<T> >
+{
+  static inline std::size_t Apply(const Daixt::Expr<T>& E, Graph& G)
+  {
+    return G.Convert(E.content());
+  }
+};
+
+template <class T, class D> 
+struct ConvertImpl<Daixt::Expr<Daixt::DisambiguationChanger<T, D> > >
+{
+  typedef Daixt::Expr<Daixt::DisambiguationChanger<T, D> > ArgT;
+  static inline std::size_t Apply(const ArgT& E, Graph& G)
+  {
+    return G.Convert(E.content());
+  }
+};
+
+template <class ARG, class OP> struct ConvertImpl<Daixt::UnOp<ARG, OP> >
+{
+  static inline std::size_t Apply(const Daixt::UnOp<ARG, OP>& UO, Graph& G)
+  {
+    return Private::UnaryNode<OP>::Apply(G.Convert(UO.arg()), G);
+  }
+};
+
+template <class LHS, class RHS, class OP> 
+struct ConvertImpl<Daixt::BinOp<LHS, RHS, OP> >
+{
+  static inline std::size_t Apply(const Daixt::BinOp<LHS, RHS, OP>& BO, 
+                                  Graph& G)
+  {
+    const std::size_t Lhs = G.Convert(BO.lhs());
+    return Private::BinaryNode<OP>::Apply(Lhs, G.Convert(BO.rhs()), G);
+  }
+};
+
+} // namespace Dynamic
+
+} // namespace Daixt 
+
+#endif // DAIXT_DYNAMIC_INC
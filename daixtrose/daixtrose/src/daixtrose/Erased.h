@@ -0,0 +1,365 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_ERASED_INC
+#define DAIXT_ERASED_INC
+
+#include "daixtrose/Expr.h"
+#include "daixtrose/ChangeDisambiguation.h"
+
+#include <new>
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+
+#include "boost/type_traits/alignment_of.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Polymorphic expressions without a heap object per expression
+////////////////////////////////////////////////////////////////////////////////
+
+// The usual way to store an expression behind an interface (see
+// UsingFeaturesOfExpression.C and Solver_1.C) is
+//
+//   Interface* p = Daixt::ChangeDisambiguation<Interface>(e).DeepCopy();
+//
+// i.e. one new per expression. A Jacobian built this way is scattered all
+// over the heap, and evaluating its entries one after the other jumps from
+// cache line to cache line.
+//
+// Daixt::Erased::Holder<Interface> keeps the converted expression in a buffer
+// of its own as long as it fits (small buffer optimization) and falls back to
+// the heap for the big ones. Holders are copyable, the copies are deep:
+//
+//   Daixt::Erased::Holder<Interface> H(x * y - y);
+//   H->Evaluate(Point);
+//
+// Daixt::Erased::Arena<Interface> places whole collections of expressions
+// back to back into big blocks of memory, in the order they were added. A
+// Jacobian stored there is a single contiguous sequence of objects:
+//
+//   Daixt::Erased::Arena<Interface> A;
+//   const Interface& Entry = A.Add(Simplify(Diff(e, x)));
+//   for (std::size_t k = 0; k != A.Size(); ++k) 
+//     Result[k] = A[k].Evaluate(Point);
+//
+// In both cases Interface is the base class of FeaturesOfExpression<Interface,
+// T>, exactly as with DeepCopy, which is not needed any more.
+
+namespace Daixt 
+{
+
+namespace Erased
+{
+
+namespace Private
+{
+
+// the strictest alignment of the types an expression is made of
+union MaxAlign
+{
+  double d;
+  long double ld;
+  void* p;
+  void (*f)();
+  long l;
+};
+
+enum { MaxAlignment = boost::alignment_of<MaxAlign>::value };
+
+
+// what an expression converted to Interface looks like
+template <class Interface, class T>
+struct Converted
+{
+  typedef Daixt::Expr<Daixt::DisambiguationChanger<T, Interface> > Type;
+};
+
+
+// construction, copy and destruction of the concrete type behind Interface
+template <class Interface, class Concrete, std::size_t BufferSize>
+struct Manager
+{
+  enum { 
+    InPlace = 
+    sizeof(Concrete) <= BufferSize 
+    && static_cast<std::size_t>(boost::alignment_of<Concrete>::value) 
+    <= static_cast<std::size_t>(MaxAlignment)
+  };
+
+  // Buffer is used if the object fits
+  static Interface* Clone(const Interface& Source, void* Buffer)
+  {
+    const Concrete& C = static_cast<const Concrete&>(Source);
+    if (InPlace)
+      {
+        return new (Buffer) Concrete(C);
+      }
+    return new Concrete(C);
+  }
+
+  static void Destroy(Interface* Object)
+  {
+    Concrete* C = static_cast<Concrete*>(Object);
+    if (InPlace)
+      {
+        C->~Concrete();
+      }
+    else
+      {
+        delete C;
+      }
+  }
+};
+
+} // namespace Private
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Holder: a single expression
+
+template <class Interface, std::size_t BufferSize = 8 * sizeof(void*)>
+class Holder
+{
+  typedef Interface* (*CloneFunction)(const Interface&, void*);
+  typedef void (*DestroyFunction)(Interface*);
+
+public:
+  inline Holder() : Object_(0), Clone_(0), Destroy_(0) {}
+
+  template <class T>
+  Holder(const Daixt::Expr<T>& e)
+    : Object_(0), Clone_(0), Destroy_(0)
+  {
+    typedef typename Private::Converted<Interface, T>::Type Concrete;
+    typedef Private::Manager<Interface, Concrete, BufferSize> Manager;
+
+    const Concrete Source = Daixt::ChangeDisambiguation<Interface>(e);
+    Object_ = Manager::Clone(Source, Storage_.Buffer);
+    Clone_ = &Manager::Clone;
+    Destroy_ = &Manager::Destroy;
+  }
+
+  Holder(const Holder& rhs)
+    : Object_(0), Clone_(rhs.Clone_), Destroy_(rhs.Destroy_)
+  {
+    if (rhs.Object_ != 0)
+      {
+        Object_ = Clone_(*rhs.Object_, Storage_.Buffer);
+      }
+  }
+
+  Holder& operator=(const Holder& rhs)
+  {
+    if (this != &rhs)
+      {
+        Reset();
+        if (rhs.Object_ != 0)
+          {
+            Object_ = rhs.Clone_(*rhs.Object_, Storage_.Buffer);
+            Clone_ = rhs.Clone_;
+            Destroy_ = rhs.Destroy_;
+          }
+      }
+    return *this;
+  }
+
+  inline ~Holder() { Reset(); }
+
+  inline bool Empty() const { return Object_ == 0; }
+
+  // true if the expression lives inside the holder
+  inline bool IsInPlace() const
+  {
+    const char* p = reinterpret_cast<const char*>(Object_);
+    return p >= Storage_.Buffer && p < Storage_.Buffer + BufferSize;
+  }
+
+  inline const Interface& operator*() const { return *Get(); }
+  inline const Interface* operator->() const { return Get(); }
+
+  inline const Interface* Get() const 
+  {
+    if (Object_ == 0)
+      {
+        throw std::logic_error("Daixt::Erased::Holder: no expression");
+      }
+    return Object_;
+  }
+
+  inline void Reset()
+  {
+    if (Object_ != 0)
+      {
+        Destroy_(Object_);
+        Object_ = 0;
+        Clone_ = 0;
+        Destroy_ = 0;
+      }
+  }
+
+private:
+  union AlignedBuffer
+  {
+    Private::MaxAlign Align;
+    char Buffer[BufferSize];
+  };
+
+  AlignedBuffer Storage_;
+  Interface* Object_;
+  CloneFunction Clone_;
+  DestroyFunction Destroy_;
+};
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Arena: many expressions, one after the other
+
+template <class Interface>
+class Arena
+{
+  typedef void (*DestroyFunction)(Interface*);
+
+public:
+  explicit Arena(std::size_t BlockSize = 16 * 1024)
+    : BlockSize_(BlockSize), Begin_(0), End_(0), BytesUsed_(0)
+  {}
+
+  ~Arena() { Clear(); }
+
+  // the expression e converted to Interface, the reference stays valid 
+  // until Clear() is called or the arena is destroyed
+  template <class T>
+  const Interface& Add(const Daixt::Expr<T>& e)
+  {
+    typedef typename Private::Converted<Interface, T>::Type Concrete;
+
+    Objects_.reserve(Objects_.size() + 1);
+    Destroy_.reserve(Destroy_.size() + 1);
+
+    void* Place = Allocate(sizeof(Concrete), 
+                           boost::alignment_of<Concrete>::value);
+    Interface* Object = 
+      new (Place) Concrete(Daixt::ChangeDisambiguation<Interface>(e));
+
+    Objects_.push_back(Object);
+    Destroy_.push_back(&DestroyImpl<Concrete>);
+    return *Object;
+  }
+
+  // the expressions in the order they were added
+  inline std::size_t Size() const { return Objects_.size(); }
+
+  inline const Interface& operator[](std::size_t i) const 
+  { 
+    return *Objects_[i]; 
+  }
+
+  // memory occupied by the expressions, including alignment padding
+  inline std::size_t BytesUsed() const { return BytesUsed_; }
+  inline std::size_t NumberOfBlocks() const { return Blocks_.size(); }
+
+  // destroys all expressions and gives the memory back
+  void Clear()
+  {
+    for (std::size_t i = Objects_.size(); i != 0; --i)
+      {
+        Destroy_[i - 1](Objects_[i - 1]);
+      }
+    Objects_.clear();
+    Destroy_.clear();
+
+    for (std::size_t i = 0; i != Blocks_.size(); ++i)
+      {
+        ::operator delete(Blocks_[i]);
+      }
+    Blocks_.clear();
+    Begin_ = End_ = 0;
+    BytesUsed_ = 0;
+  }
+
+private:
+  // not copyable: the references handed out by Add point into the arena
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  template <class Concrete>
+  static void DestroyImpl(Interface* Object)
+  {
+    static_cast<Concrete*>(Object)->~Concrete();
+  }
+
+  void* Allocate(std::size_t Bytes, std::size_t Alignment)
+  {
+    if (Alignment > static_cast<std::size_t>(Private::MaxAlignment))
+      {
+        throw std::logic_error("Daixt::Erased::Arena: the alignment of an "
+                               "expression is too strict");
+      }
+
+    std::size_t Padding = 
+      (Alignment - reinterpret_cast<std::size_t>(Begin_) % Alignment) 
+      % Alignment;
+
+    if (Begin_ == 0 || static_cast<std::size_t>(End_ - Begin_) 
+        < Padding + Bytes)
+      {
+        // blocks from operator new are aligned for everything
+        std::size_t Size = Bytes > BlockSize_ ? Bytes : BlockSize_;
+        Blocks_.reserve(Blocks_.size() + 1);
+        Begin_ = static_cast<char*>(::operator new(Size));
+        Blocks_.push_back(Begin_);
+        End_ = Begin_ + Size;
+        Padding = 0;
+      }
+
+    void* Result = Begin_ + Padding;
+    Begin_ += Padding + Bytes;
+    BytesUsed_ += Padding + Bytes;
+    return Result;
+  }
+
+  std::size_t BlockSize_;
+  std::vector<char*> Blocks_;
+  char* Begin_;
+  char* End_;
+  std::size_t BytesUsed_;
+
+  std::vector<Interface*> Objects_;
+  std::vector<DestroyFunction> Destroy_;
+};
+
+} // namespace Erased
+
+} // namespace Daixt 
+
+
+#endif // DAIXT_ERASED_INC
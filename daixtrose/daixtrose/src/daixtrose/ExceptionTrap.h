@@ -0,0 +1,160 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_EXCEPTION_TRAP_INC
+#define DAIXT_EXCEPTION_TRAP_INC
+
+#include <new>
+#include <stdexcept>
+#include <string>
+
+
+namespace Daixt 
+{
+
+namespace Private
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// Exceptions must not leave an OpenMP parallel region. The first one thrown is
+// stored and rethrown after the region as the same standard exception type,
+// if it is std::bad_alloc or one of the classes of <stdexcept>. Any other
+// exception comes back as std::runtime_error with the same what().
+//
+// usage, inside the loop body:
+//   try { ... } catch (...) { Trap.StoreCurrent(); }
+// and after the region:
+//   Trap.Rethrow();
+class ExceptionTrap
+{
+public:
+  enum Kind 
+  { 
+    none, bad_alloc, 
+    logic_error, domain_error, invalid_argument, length_error, out_of_range, 
+    runtime_error, range_error, overflow_error, underflow_error
+  };
+
+  inline ExceptionTrap() : Kind_(none) {}
+
+  // call it in a catch block only: it stores the exception being handled
+  inline void StoreCurrent()
+  {
+    try 
+      {
+        throw;
+      }
+    catch (std::bad_alloc&) 
+      {
+        Store(bad_alloc, "std::bad_alloc");
+      }
+    catch (std::domain_error& e) 
+      {
+        Store(domain_error, e.what());
+      }
+    catch (std::invalid_argument& e) 
+      {
+        Store(invalid_argument, e.what());
+      }
+    catch (std::length_error& e) 
+      {
+        Store(length_error, e.what());
+      }
+    catch (std::out_of_range& e) 
+      {
+        Store(out_of_range, e.what());
+      }
+    catch (std::logic_error& e) 
+      {
+        Store(logic_error, e.what());
+      }
+    catch (std::range_error& e) 
+      {
+        Store(range_error, e.what());
+      }
+    catch (std::overflow_error& e) 
+      {
+        Store(overflow_error, e.what());
+      }
+    catch (std::underflow_error& e) 
+      {
+        Store(underflow_error, e.what());
+      }
+    catch (std::exception& e) 
+      {
+        Store(runtime_error, e.what());
+      }
+    catch (...) 
+      {
+        Store(runtime_error, "unknown exception");
+      }
+  }
+
+  inline void Rethrow() const
+  {
+    switch (Kind_)
+      {
+      case none: return;
+      case bad_alloc: throw std::bad_alloc();
+      case logic_error: throw std::logic_error(What_);
+      case domain_error: throw std::domain_error(What_);
+      case invalid_argument: throw std::invalid_argument(What_);
+      case length_error: throw std::length_error(What_);
+      case out_of_range: throw std::out_of_range(What_);
+      case range_error: throw std::range_error(What_);
+      case overflow_error: throw std::overflow_error(What_);
+      case underflow_error: throw std::underflow_error(What_);
+      default: throw std::runtime_error(What_);
+      }
+  }
+
+private:
+  inline void Store(Kind K, const char* What)
+  {
+#ifdef _OPENMP
+#pragma omp critical (daixt_exception_trap)
+#endif
+    {
+      if (Kind_ == none)
+        {
+          Kind_ = K;
+          What_ = What;
+        }
+    }
+  }
+
+  Kind Kind_;
+  std::string What_;
+};
+
+} // namespace Private
+
+} // namespace Daixt 
+
+
+#endif // DAIXT_EXCEPTION_TRAP_INC
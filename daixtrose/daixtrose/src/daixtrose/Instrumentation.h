@@ -0,0 +1,547 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_INSTRUMENTATION_INC
+#define DAIXT_INSTRUMENTATION_INC
+
+#include "daixtrose/BinOps.h"
+#include "daixtrose/UnOps.h"
+#include "daixtrose/ConstRef.h"
+#include "daixtrose/Expr.h"
+#include "daixtrose/ThreadLocal.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Instrumentation of the evaluation engine
+////////////////////////////////////////////////////////////////////////////////
+
+// Compile with -DDAIXT_ENABLE_INSTRUMENTATION to count what happens during the
+// evaluation of expressions: rows evaluated, entries produced, temporaries
+// forced by aliasing, columns extracted for Transpose, pool allocations, ...
+//
+// Events are attributed to the expression type of the innermost assignment
+// that is currently running on this thread.  Every expression type owns one
+// set of counters, and every thread counts into its own copy of them, so the
+// overhead is a pointer swap per assignment and one plain increment per event.
+// Without the macro all hooks vanish.
+//
+// Daixt::Instrumentation::Report(std::cerr) dumps all counters.  Expression
+// types are shown as e.g. "(Matrix + (Scalar * T(Matrix)))".
+
+#ifdef DAIXT_ENABLE_INSTRUMENTATION
+
+#define DAIXT_INSTRUMENT_SCOPE(EXPR_TYPE)                                      \
+  Daixt::Instrumentation::Scope DaixtInstrumentationScope                      \
+    (Daixt::Instrumentation::CountersOf<EXPR_TYPE>())
+
+#define DAIXT_INSTRUMENT_ADD(EVENT, N)                                         \
+  Daixt::Instrumentation::Add(Daixt::Instrumentation::EVENT, N)
+
+#define DAIXT_INSTRUMENT_COUNT(EVENT) DAIXT_INSTRUMENT_ADD(EVENT, 1)
+
+// OpenMP worker threads do not see the scope of the master thread: capture it
+// before the parallel region and enter it in the loop body
+#define DAIXT_INSTRUMENT_CAPTURE                                               \
+  Daixt::Instrumentation::Counters* DaixtInstrumentationCaptured =             \
+    Daixt::Instrumentation::Current()
+
+#define DAIXT_INSTRUMENT_ENTER_CAPTURED                                        \
+  Daixt::Instrumentation::Scope DaixtInstrumentationScope                      \
+    (*DaixtInstrumentationCaptured)
+
+#else
+
+#define DAIXT_INSTRUMENT_SCOPE(EXPR_TYPE)
+#define DAIXT_INSTRUMENT_ADD(EVENT, N)
+#define DAIXT_INSTRUMENT_COUNT(EVENT)
+#define DAIXT_INSTRUMENT_CAPTURE
+#define DAIXT_INSTRUMENT_ENTER_CAPTURED
+
+#endif
+
+
+namespace Daixt 
+{
+
+namespace Instrumentation
+{
+
+enum Event 
+{
+  assignments,          // evaluations of a whole expression
+  rows_evaluated,       // rows, columns (matrix) or entries (vector) 
+                        // extracted, those of subexpressions included
+  entries_produced,     // nonzeros in these matrix rows and columns, which
+                        // approximates the map nodes allocated for them
+  aliasing_temporaries, // the target occurs on the rhs: a temporary is built
+  vector_temporaries,   // shared or nested products evaluated into temporaries
+  column_extractions,   // GetColumn calls, mostly caused by Transpose
+  pool_allocations,     // blocks taken from Linalg::NodePool (pooled rows)
+  NumberOfEvents
+};
+
+
+inline const char* EventName(Event E)
+{
+  static const char* Names[NumberOfEvents] = 
+    {
+      "assign", "rows", "~map-nodes", "alias-tmp", "vec-tmp", "GetColumn", 
+      "pool"
+    };
+  return Names[E];
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// readable names of expression types
+
+namespace Private
+{
+
+inline std::string Demangle(const char* Name)
+{
+#if defined(__GNUC__)
+  int Status = 0;
+  char* Demangled = abi::__cxa_demangle(Name, 0, 0, &Status);
+  if (Status == 0 && Demangled != 0)
+    {
+      std::string Result(Demangled);
+      std::free(Demangled);
+      return Result;
+    }
+#endif
+  return Name;
+}
+
+
+// "Linalg::Matrix<double, ...>" -> "Matrix"
+inline std::string ShortName(const std::type_info& Info)
+{
+  std::string Name = Demangle(Info.name());
+  Name = Name.substr(0, Name.find('<'));
+
+  std::string::size_type pos = Name.rfind("::");
+  if (pos != std::string::npos)
+    {
+      Name = Name.substr(pos + 2);
+    }
+  return Name;
+}
+
+
+// Operations generated by the DAIXT_DEFINE_* macros carry the C++ operator as
+// their symbol, all others (e.g. Linalg::Transpose) carry a function name.
+inline bool IsOperatorSymbol(const char* Symbol)
+{
+  return (Symbol[0] != '\0') && 
+    !std::isalnum(static_cast<unsigned char>(Symbol[0])) && 
+    (Symbol[0] != '_');
+}
+
+} // namespace Private
+
+
+// leaves
+template <class T> 
+struct TypeName
+{
+  static std::string Get() { return Private::ShortName(typeid(T)); }
+};
+
+template <class T> 
+struct TypeName<Daixt::Expr<T> >
+{
+  static std::string Get() { return TypeName<T>::Get(); }
+};
+
+template <class T> 
+struct TypeName<Daixt::ConstRef<T> >
+{
+  static std::string Get() { return TypeName<T>::Get(); }
+};
+
+template <class ARG, class OP> 
+struct TypeName<Daixt::UnOp<ARG, OP> >
+{
+  static std::string Get() 
+  { 
+    const std::string Op = Private::IsOperatorSymbol(OP::Symbol()) ? 
+      std::string(OP::Symbol()) : Private::ShortName(typeid(OP));
+
+    return Op + "(" + TypeName<ARG>::Get() + ")";
+  }
+};
+
+template <class LHS, class RHS, class OP> 
+struct TypeName<Daixt::BinOp<LHS, RHS, OP> >
+{
+  static std::string Get() 
+  { 
+    return "(" + TypeName<LHS>::Get() + " " + OP::Symbol() + " " 
+      + TypeName<RHS>::Get() + ")";
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// counters: one static instance per expression type names the counts, every 
+// thread keeps its own counts in a block of its own
+
+struct Counters
+{
+  std::string (*Name)();
+  std::size_t Slot;           // 1 + its row in the blocks, 0 if unregistered
+  Counters* Next;
+
+  // the sum over all threads
+  inline unsigned long Total(Event E) const;
+};
+
+
+namespace Private
+{
+
+// per thread: Size rows of NumberOfEvents counts, indexed by Counters::Slot.
+// Only the owning thread writes, so an increment needs no atomic operation.
+// The blocks outlive their threads, since Report must still see the counts.
+struct ThreadCounts
+{
+  unsigned long* Count;
+  std::size_t Size;
+  ThreadCounts* Next;
+};
+
+
+inline Counters*& RegistryHead()
+{
+  static Counters* Head = 0;
+  return Head;
+}
+
+inline std::size_t& NumberOfSlots()
+{
+  static std::size_t Number = 0;
+  return Number;
+}
+
+inline ThreadCounts*& ThreadsHead()
+{
+  static ThreadCounts* Head = 0;
+  return Head;
+}
+
+inline std::string NoName() { return "(outside of any assignment)"; }
+
+inline Counters& Unattributed()
+{
+  static Counters C = { &NoName, 0, 0 };
+  return C;
+}
+
+inline Counters*& ThisThreadsCurrent()
+{
+  static DAIXT_THREAD_LOCAL Counters* C = 0;
+  return C;
+}
+
+inline ThreadCounts*& ThisThreadsCounts()
+{
+  static DAIXT_THREAD_LOCAL ThreadCounts* T = 0;
+  return T;
+}
+
+// Slot is read without the lock by SlotOf, so both sides access it 
+// atomically. Next and the list heads are only touched under the lock.
+inline std::size_t SlotOf(const Counters& C)
+{
+  std::size_t Result;
+#ifdef _OPENMP
+#pragma omp atomic read
+#endif
+  Result = C.Slot;
+  return Result;
+}
+
+inline void Register(Counters& C)
+{
+#ifdef _OPENMP
+#pragma omp critical (daixt_instrumentation_registry)
+#endif
+  {
+    if (C.Slot == 0)
+      {
+        C.Next = RegistryHead();
+        RegistryHead() = &C;
+        const std::size_t Slot = ++NumberOfSlots();
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+        C.Slot = Slot;
+      }
+  }
+}
+
+
+// makes room for all registered counters in the block of this thread
+inline ThreadCounts& GrowThisThreadsCounts()
+{
+  ThreadCounts*& T = ThisThreadsCounts();
+
+#ifdef _OPENMP
+#pragma omp critical (daixt_instrumentation_registry)
+#endif
+  {
+    if (T == 0)
+      {
+        T = new ThreadCounts;
+        T->Count = 0;
+        T->Size = 0;
+        T->Next = ThreadsHead();
+        ThreadsHead() = T;
+      }
+
+    const std::size_t Size = NumberOfSlots();
+    if (T->Size < Size)
+      {
+        unsigned long* Count = new unsigned long[Size * NumberOfEvents];
+        std::fill(Count, Count + Size * NumberOfEvents, 0UL);
+        std::copy(T->Count, T->Count + T->Size * NumberOfEvents, Count);
+        delete [] T->Count;
+        T->Count = Count;
+        T->Size = Size;
+      }
+  }
+  return *T;
+}
+
+
+// the sum over all threads, call it under the lock
+inline unsigned long SumOverThreads(const Counters& C, Event E)
+{
+  unsigned long Sum = 0;
+  for (const ThreadCounts* T = ThreadsHead(); T != 0; T = T->Next)
+    {
+      if (C.Slot != 0 && C.Slot <= T->Size)
+        {
+          Sum += T->Count[(C.Slot - 1) * NumberOfEvents + E];
+        }
+    }
+  return Sum;
+}
+
+} // namespace Private
+
+
+inline unsigned long Counters::Total(Event E) const
+{
+  unsigned long Sum;
+#ifdef _OPENMP
+#pragma omp critical (daixt_instrumentation_registry)
+#endif
+  Sum = Private::SumOverThreads(*this, E);
+  return Sum;
+}
+
+
+namespace Private
+{
+template <class T>
+inline Counters& CountersOfType()
+{
+  static Counters C = { &TypeName<T>::Get, 0, 0 };
+  return C;
+}
+} // namespace Private
+
+
+// Expr<T> and T share their counters
+template <class T>
+inline Counters& CountersOf()
+{
+  return Private::CountersOfType<typename Daixt::UnwrapExpr<T>::Type>();
+}
+
+
+inline Counters* Current()
+{
+  Counters* C = Private::ThisThreadsCurrent();
+  if (C == 0)
+    {
+      C = &Private::Unattributed();
+    }
+  if (Private::SlotOf(*C) == 0) 
+    {
+      Private::Register(*C);
+    }
+  return C;
+}
+
+
+inline void Add(Event E, unsigned long N)
+{
+  const std::size_t Slot = Private::SlotOf(*Current());
+
+  Private::ThreadCounts* T = Private::ThisThreadsCounts();
+  if (T == 0 || T->Size < Slot)
+    {
+      T = &Private::GrowThisThreadsCounts();
+    }
+  T->Count[(Slot - 1) * NumberOfEvents + E] += N;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// makes C the current counters of this thread during its lifetime
+
+class Scope
+{
+public:
+  inline explicit Scope(Counters& C) 
+    : Previous_(Private::ThisThreadsCurrent()) 
+  {
+    if (Private::SlotOf(C) == 0) 
+      {
+        Private::Register(C);
+      }
+    Private::ThisThreadsCurrent() = &C;
+  }
+
+  inline ~Scope() 
+  { 
+    Private::ThisThreadsCurrent() = Previous_; 
+  }
+
+private:
+  Scope(const Scope&);
+  Scope& operator=(const Scope&);
+
+  Counters* Previous_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// report and reset: call them while no other thread is counting
+
+namespace Private
+{
+
+struct ReportLine
+{
+  const Counters* Of;
+  unsigned long Count[NumberOfEvents];
+};
+
+struct MoreEntries
+{
+  inline bool operator()(const ReportLine& lhs, const ReportLine& rhs) const
+  {
+    if (lhs.Count[entries_produced] != rhs.Count[entries_produced])
+      return lhs.Count[entries_produced] > rhs.Count[entries_produced];
+    return lhs.Count[rows_evaluated] > rhs.Count[rows_evaluated];
+  }
+};
+
+} // namespace Private
+
+
+inline void Report(std::ostream& os)
+{
+#ifndef DAIXT_ENABLE_INSTRUMENTATION
+  os << "Daixtrose instrumentation is disabled "
+     << "(compile with -DDAIXT_ENABLE_INSTRUMENTATION)" << std::endl;
+#else
+  std::vector<Private::ReportLine> All;
+
+#ifdef _OPENMP
+#pragma omp critical (daixt_instrumentation_registry)
+#endif
+  for (const Counters* C = Private::RegistryHead(); C != 0; C = C->Next)
+    {
+      Private::ReportLine Line;
+      Line.Of = C;
+      for (int E = 0; E != NumberOfEvents; ++E)
+        {
+          Line.Count[E] = Private::SumOverThreads(*C, Event(E));
+        }
+      All.push_back(Line);
+    }
+
+  std::stable_sort(All.begin(), All.end(), Private::MoreEntries());
+
+  os << "Daixtrose instrumentation report "
+     << "(~map-nodes: entries produced, about the row nodes allocated)\n";
+  for (int E = 0; E != NumberOfEvents; ++E)
+    {
+      os << std::setw(11) << EventName(Event(E)) << ' ';
+    }
+  os << " expression\n";
+
+  for (std::size_t k = 0; k != All.size(); ++k)
+    {
+      for (int E = 0; E != NumberOfEvents; ++E)
+        {
+          os << std::setw(11) << All[k].Count[E] << ' ';
+        }
+      os << ' ' << All[k].Of->Name() << '\n';
+    }
+  os << std::flush;
+#endif
+}
+
+
+inline void Reset()
+{
+#ifdef _OPENMP
+#pragma omp critical (daixt_instrumentation_registry)
+#endif
+  for (Private::ThreadCounts* T = Private::ThreadsHead(); T != 0; T = T->Next)
+    {
+      std::fill(T->Count, T->Count + T->Size * NumberOfEvents, 0UL);
+    }
+}
+
+} // namespace Instrumentation
+
+} // namespace Daixt
+
+
+#endif // DAIXT_INSTRUMENTATION_INC
@@ -0,0 +1,418 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_JACOBIAN_INC
+#define DAIXT_JACOBIAN_INC
+
+#include "daixtrose/Tape.h"
+#include "daixtrose/Simplify.h"
+#include "daixtrose/Differentiation.h"
+#include "daixtrose/WorkStealing.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "boost/lexical_cast.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Jacobian: residuals and all their derivatives in one Program
+////////////////////////////////////////////////////////////////////////////////
+
+// Storing every d(r_i)/d(x_j) as an object of its own means N * M virtual
+// calls per point, each walking its own tree, and the subexpressions the
+// entries have in common with each other and with the residual are computed
+// again and again.
+//
+// JacobianCompiler differentiates at compile time, as before, but compiles
+// the residuals and the simplified derivatives with one Tape::Compiler, so
+// identical subexpressions are shared across all of them. The resulting
+// Jacobian evaluates residual and matrix in one pass per point, or for blocks
+// of points at once:
+//
+//   Daixt::Tape::JacobianCompiler<Variable, 2> JC(2);
+//   JC.AddResidual(1, x * y - y);
+//   JC.AddResidual(2, x + y);
+//   Daixt::Tape::Jacobian J = JC.Finish();
+//   J.Evaluate(Point, Residual, Entries);            // one point
+//   J.EvaluateInterleaved(Points, Results, Count);    // many points
+//   J.EvaluateInParallel(Points, Residuals, Entries, Count);
+//
+// Var<1>, ..., Var<NumberOfVariables> are the variables, known to
+// Differentiation::LeafTraits (see Tape.h). Rows and columns are counted
+// from 1, as usual for daixtrose. The entries of a point are stored
+// row by row: Entries[(i - 1) * NumberOfVariables + j - 1] = d(r_i)/d(x_j)
+//
+// EvaluateInParallel is meant for huge numbers of small local systems: the
+// points are shared among the threads by work stealing (see WorkStealing.h),
+// each thread evaluates whole chunks of points with registers of its own, and
+// the results end up in two matrices with one row per point, ready for the
+// local Newton steps.
+
+namespace Daixt 
+{
+
+namespace Tape
+{
+
+template <template <std::size_t> class Var, std::size_t NumberOfVariables>
+class JacobianCompiler;
+
+namespace Private
+{
+class JacobianChunks;
+} // namespace Private
+
+
+class Jacobian
+{
+public:
+  inline Jacobian() : NumberOfResiduals_(0), NumberOfVariables_(0) {}
+
+  inline std::size_t NumberOfResiduals() const { return NumberOfResiduals_; }
+  inline std::size_t NumberOfVariables() const { return NumberOfVariables_; }
+  inline std::size_t NumberOfEntries() const 
+  { 
+    return NumberOfResiduals_ * NumberOfVariables_; 
+  }
+
+  inline const Program& GetProgram() const { return Program_; }
+
+  // a single point: Residual[i - 1], Entries[(i - 1) * NumberOfVariables + j - 1]
+  inline void Evaluate(const double* Point, 
+                       double* Residual, double* Entries) const;
+
+  // one array per variable, residual and entry: Variables[v][Point], 
+  // Residuals[i - 1][Point], Entries[(i - 1) * NumberOfVariables + j - 1][Point]
+  inline void Evaluate(const double* const* Variables, 
+                       double* const* Residuals, double* const* Entries, 
+                       std::size_t NumberOfPoints) const;
+
+  // all values of a point side by side: Values[Point * NumberOfVariables + v].
+  // The results of a point form a block of NumberOfValues(): the residual 
+  // first, then the entries
+  inline std::size_t NumberOfValues() const 
+  { 
+    return NumberOfResiduals_ + NumberOfEntries(); 
+  }
+
+  inline void EvaluateInterleaved(const double* Values, double* Results, 
+                                  std::size_t NumberOfPoints) const;
+
+  // the values as for EvaluateInterleaved, the results in a row per point:
+  // Residuals[Point * NumberOfResiduals() + i - 1],
+  // Entries[Point * NumberOfEntries() + (i - 1) * NumberOfVariables + j - 1]
+  // The points are evaluated in parallel, ChunkSize points at a time.
+  inline void EvaluateInParallel(const double* Values, 
+                                 double* Residuals, double* Entries, 
+                                 std::size_t NumberOfPoints, 
+                                 std::size_t ChunkSize = Program::BlockSize) 
+    const;
+
+private:
+  template <template <std::size_t> class Var, std::size_t N>
+  friend class JacobianCompiler;
+
+  friend class Private::JacobianChunks;
+
+  // the program's outputs point to Residual[i - 1] and Entries[k]
+  inline void Connect(double* Residual, double* Entries, 
+                      std::vector<double*>& Outputs) const;
+
+  Program Program_;
+  std::size_t NumberOfResiduals_;
+  std::size_t NumberOfVariables_;
+
+  // the output numbers inside Program_
+  std::vector<std::size_t> ResidualOutput_;
+  std::vector<std::size_t> EntryOutput_; 
+};
+
+
+namespace Private
+{
+
+// d(e)/d(Var<1>), ..., d(e)/d(Var<Col>) into Entries[0], ..., Entries[Col - 1]
+template <template <std::size_t> class Var, std::size_t Col>
+struct CompileDerivatives
+{
+  template <class T>
+  static inline void Apply(const Daixt::Expr<T>& e, Compiler& C, 
+                           std::size_t* Entries)
+  {
+    using Daixt::ExprManip::Simplify;
+    using Daixt::Differentiation::Diff;
+
+    CompileDerivatives<Var, Col - 1>::Apply(e, C, Entries);
+    Entries[Col - 1] = C.AddOutput(C.Compile(Simplify(Diff(e, Var<Col>()))));
+  }
+};
+
+template <template <std::size_t> class Var>
+struct CompileDerivatives<Var, 0>
+{
+  template <class T>
+  static inline void Apply(const Daixt::Expr<T>&, Compiler&, std::size_t*) {}
+};
+
+
+
+// the work of one thread in Jacobian::EvaluateInParallel. The scratch memory 
+// is allocated by the first call, i.e. by the thread owning the copy.
+class JacobianChunks
+{
+public:
+  inline JacobianChunks(const Jacobian& J, const double* Values, 
+                        double* Residuals, double* Entries, 
+                        std::size_t ChunkSize)
+    : J_(J), Values_(Values), Residuals_(Residuals), Entries_(Entries), 
+      ChunkSize_(ChunkSize)
+  {}
+
+  inline void operator()(std::size_t First, std::size_t Last);
+
+private:
+  const Jacobian& J_;
+  const double* Values_;
+  double* Residuals_;
+  double* Entries_;
+  std::size_t ChunkSize_;
+
+  std::vector<double> Registers_;
+  std::vector<double> Results_; // ChunkSize_ points as in EvaluateInterleaved
+  std::vector<const double*> Variables_;
+  std::vector<double*> Outputs_;
+};
+
+} // namespace Private
+
+
+template <template <std::size_t> class Var, std::size_t NumberOfVariables>
+class JacobianCompiler
+{
+public:
+  explicit JacobianCompiler(std::size_t NumberOfResiduals)
+    : NumberOfResiduals_(NumberOfResiduals), 
+      ResidualOutput_(NumberOfResiduals, Missing()),
+      EntryOutput_(NumberOfResiduals * NumberOfVariables, Missing())
+  {}
+
+  // the residual number Row and all its derivatives, once per row
+  template <class T>
+  void AddResidual(std::size_t Row, const Daixt::Expr<T>& e)
+  {
+    if (Row < 1 || Row > NumberOfResiduals_)
+      {
+        throw std::range_error
+          ("Daixt::Tape::JacobianCompiler::AddResidual: no such row: " 
+           + boost::lexical_cast<std::string>(Row));
+      }
+
+    // the outputs of a first residual would stay in the program unconnected
+    if (ResidualOutput_[Row - 1] != Missing())
+      {
+        throw std::logic_error
+          ("Daixt::Tape::JacobianCompiler::AddResidual: row " 
+           + boost::lexical_cast<std::string>(Row) + " has a residual already");
+      }
+
+    ResidualOutput_[Row - 1] = Compiler_.AddOutput(Compiler_.Compile(e));
+    Private::CompileDerivatives<Var, NumberOfVariables>::
+      Apply(e, Compiler_, &EntryOutput_[(Row - 1) * NumberOfVariables]);
+  }
+
+  // the number of distinct nodes of all residuals and derivatives so far
+  std::size_t NumberOfNodes() const { return Compiler_.NumberOfNodes(); }
+
+  Jacobian Finish() const
+  {
+    for (std::size_t i = 0; i != NumberOfResiduals_; ++i)
+      {
+        if (ResidualOutput_[i] == Missing())
+          {
+            throw std::logic_error
+              ("Daixt::Tape::JacobianCompiler::Finish: missing residual " 
+               + boost::lexical_cast<std::string>(i + 1));
+          }
+      }
+
+    Jacobian Result;
+    Result.Program_ = Compiler_.Finish();
+
+    if (Result.Program_.NumberOfVariables() > NumberOfVariables)
+      {
+        throw std::logic_error
+          ("Daixt::Tape::JacobianCompiler::Finish: a residual depends on "
+           "a variable beyond NumberOfVariables");
+      }
+
+    Result.NumberOfResiduals_ = NumberOfResiduals_;
+    Result.NumberOfVariables_ = NumberOfVariables;
+    Result.ResidualOutput_ = ResidualOutput_;
+    Result.EntryOutput_ = EntryOutput_;
+    return Result;
+  }
+
+private:
+  static std::size_t Missing() { return static_cast<std::size_t>(-1); }
+
+  Compiler Compiler_;
+  std::size_t NumberOfResiduals_;
+  std::vector<std::size_t> ResidualOutput_;
+  std::vector<std::size_t> EntryOutput_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// implementation
+
+void Jacobian::Connect(double* Residual, double* Entries, 
+                       std::vector<double*>& Outputs) const
+{
+  Outputs.resize(Program_.NumberOfOutputs() + 1);
+
+  for (std::size_t i = 0; i != NumberOfResiduals_; ++i)
+    {
+      Outputs[ResidualOutput_[i]] = Residual + i;
+    }
+  for (std::size_t k = 0; k != EntryOutput_.size(); ++k)
+    {
+      Outputs[EntryOutput_[k]] = Entries + k;
+    }
+}
+
+
+void Jacobian::Evaluate(const double* Point, 
+                        double* Residual, double* Entries) const
+{
+  std::vector<const double*> Variables(NumberOfVariables_ + 1);
+  for (std::size_t v = 0; v != NumberOfVariables_; ++v)
+    {
+      Variables[v] = Point + v;
+    }
+
+  std::vector<double*> Outputs;
+  Connect(Residual, Entries, Outputs);
+
+  Program_.Evaluate(&Variables[0], 1, &Outputs[0], 1, 1);
+}
+
+
+void Jacobian::Evaluate(const double* const* Variables, 
+                        double* const* Residuals, double* const* Entries, 
+                        std::size_t NumberOfPoints) const
+{
+  std::vector<double*> Outputs(Program_.NumberOfOutputs() + 1);
+
+  for (std::size_t i = 0; i != NumberOfResiduals_; ++i)
+    {
+      Outputs[ResidualOutput_[i]] = Residuals[i];
+    }
+  for (std::size_t k = 0; k != EntryOutput_.size(); ++k)
+    {
+      Outputs[EntryOutput_[k]] = Entries[k];
+    }
+
+  Program_.Evaluate(Variables, 1, &Outputs[0], 1, NumberOfPoints);
+}
+
+
+void Jacobian::EvaluateInterleaved(const double* Values, double* Results, 
+                                   std::size_t NumberOfPoints) const
+{
+  std::vector<const double*> Variables(NumberOfVariables_ + 1);
+  for (std::size_t v = 0; v != NumberOfVariables_; ++v)
+    {
+      Variables[v] = Values + v;
+    }
+
+  std::vector<double*> Outputs;
+  Connect(Results, Results + NumberOfResiduals_, Outputs);
+
+  Program_.Evaluate(&Variables[0], NumberOfVariables_, 
+                    &Outputs[0], NumberOfValues(), NumberOfPoints);
+}
+
+
+void Jacobian::EvaluateInParallel(const double* Values, 
+                                  double* Residuals, double* Entries, 
+                                  std::size_t NumberOfPoints, 
+                                  std::size_t ChunkSize) const
+{
+  Daixt::WorkStealing::
+    ForEachChunk(NumberOfPoints, ChunkSize, 
+                 Private::JacobianChunks(*this, Values, Residuals, Entries, 
+                                         ChunkSize));
+}
+
+
+void Private::JacobianChunks::operator()(std::size_t First, std::size_t Last)
+{
+  const std::size_t NumberOfVariables = J_.NumberOfVariables_;
+  const std::size_t NumberOfResiduals = J_.NumberOfResiduals_;
+  const std::size_t NumberOfEntries = J_.NumberOfEntries();
+  const std::size_t NumberOfValues = J_.NumberOfValues();
+
+  if (Registers_.empty())
+    {
+      Registers_.resize(J_.Program_.NumberOfScratchValues());
+      Results_.resize(ChunkSize_ * NumberOfValues + 1);
+      Variables_.resize(NumberOfVariables + 1);
+      J_.Connect(&Results_[0], &Results_[0] + NumberOfResiduals, Outputs_);
+    }
+
+  for (std::size_t v = 0; v != NumberOfVariables; ++v)
+    {
+      Variables_[v] = Values_ + First * NumberOfVariables + v;
+    }
+
+  J_.Program_.Evaluate(&Variables_[0], NumberOfVariables, 
+                       &Outputs_[0], NumberOfValues, Last - First, 
+                       &Registers_[0]);
+
+  // split the block into the rows of the two matrices
+  const double* Result = &Results_[0];
+  for (std::size_t Point = First; Point != Last; ++Point)
+    {
+      std::copy(Result, Result + NumberOfResiduals, 
+                Residuals_ + Point * NumberOfResiduals);
+      std::copy(Result + NumberOfResiduals, Result + NumberOfValues, 
+                Entries_ + Point * NumberOfEntries);
+      Result += NumberOfValues;
+    }
+}
+
+} // namespace Tape
+
+} // namespace Daixt 
+
+
+#endif // DAIXT_JACOBIAN_INC
@@ -0,0 +1,206 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LOCAL_DERIVATIVES_INC
+#define DAIXT_LOCAL_DERIVATIVES_INC
+
+#include "daixtrose/Scalar.h"
+#include "daixtrose/NeutralElements.h"
+#include "daixtrose/DefaultOps.h"
+
+#include <cmath>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// local derivatives for numerical differentiation passes
+////////////////////////////////////////////////////////////////////////////////
+
+// Symbolic differentiation (see Differentiation.h) builds a new expression
+// per variable. The reverse mode (ReverseMode.h) evaluates derivatives
+// numerically instead and only needs to know, at every node, the derivative
+// of the op with respect to its arguments, evaluated at the current values.
+//
+// UnaryDerivative<OP>::Apply(Arg, Value) returns d(OP(Arg))/d(Arg), where
+// Value is OP(Arg). BinaryDerivative<OP>::Apply(Lhs, Rhs, Value, dLhs, dRhs)
+// stores both partial derivatives. Specialize both for your own ops.
+//
+// The leaves are seen through LeafTraits, by the forward mode (DualNumbers.h)
+// as well: variables have a number, counted from 0, everything else is a
+// constant. Scalar, IsNull and IsOne are known, variables are specializations
+// like
+//
+//   template <std::size_t N> struct LeafTraits<MyVariable<N> >
+//   {
+//     enum { is_variable = true };
+//     static std::size_t Number(const MyVariable<N>&) { return N - 1; }
+//   };
+//
+// and constants provide "static double Value(const T&)" instead.
+
+namespace Daixt 
+{
+
+namespace Differentiation
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// leaves
+
+template <class T> struct LeafTraits;
+
+template <class D> struct LeafTraits<Daixt::Scalar<D> >
+{
+  enum { is_variable = false };
+  static inline double Value(const Daixt::Scalar<D>& S) { return S.Value(); }
+};
+
+template <class D> struct LeafTraits<Daixt::IsNull<D> >
+{
+  enum { is_variable = false };
+  static inline double Value(const Daixt::IsNull<D>&) { return 0.0; }
+};
+
+template <class D> struct LeafTraits<Daixt::IsOne<D> >
+{
+  enum { is_variable = false };
+  static inline double Value(const Daixt::IsOne<D>&) { return 1.0; }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// unary ops
+
+template <class OP> struct UnaryDerivative;
+
+template <> struct UnaryDerivative<Daixt::DefaultOps::UnaryPlus>
+{
+  static inline double Apply(double, double) { return 1.0; }
+};
+
+template <> struct UnaryDerivative<Daixt::DefaultOps::UnaryMinus>
+{
+  static inline double Apply(double, double) { return -1.0; }
+};
+
+// (m/n) * x^(m/n - 1)
+template <int m, int n> 
+struct UnaryDerivative<Daixt::DefaultOps::RationalPower<m, n> >
+{
+  static inline double Apply(double Arg, double) 
+  { 
+    const double Exponent = static_cast<double>(m) / static_cast<double>(n);
+    return Exponent * std::pow(Arg, Exponent - 1.0);
+  }
+};
+
+template <int m> 
+struct UnaryDerivative<Daixt::DefaultOps::RationalPower<m, 1> >
+{
+  static inline double Apply(double Arg, double) 
+  { 
+    return m * std::pow(Arg, m - 1);
+  }
+};
+
+template <> 
+struct UnaryDerivative<Daixt::DefaultOps::RationalPower<1, 1> >
+{
+  static inline double Apply(double, double) { return 1.0; }
+};
+
+// the common cases can reuse the value: -1/x^2 and 1/(2 sqrt(x))
+template <> 
+struct UnaryDerivative<Daixt::DefaultOps::RationalPower<-1, 1> >
+{
+  static inline double Apply(double, double Value) { return -Value * Value; }
+};
+
+template <> 
+struct UnaryDerivative<Daixt::DefaultOps::RationalPower<1, -1> >
+{
+  static inline double Apply(double, double Value) { return -Value * Value; }
+};
+
+template <> 
+struct UnaryDerivative<Daixt::DefaultOps::RationalPower<1, 2> >
+{
+  static inline double Apply(double, double Value) { return 0.5 / Value; }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// binary ops
+
+template <class OP> struct BinaryDerivative;
+
+template <> struct BinaryDerivative<Daixt::DefaultOps::BinaryPlus>
+{
+  static inline void Apply(double, double, double, double& dLhs, double& dRhs)
+  { 
+    dLhs = 1.0; 
+    dRhs = 1.0;
+  }
+};
+
+template <> struct BinaryDerivative<Daixt::DefaultOps::BinaryMinus>
+{
+  static inline void Apply(double, double, double, double& dLhs, double& dRhs)
+  { 
+    dLhs = 1.0; 
+    dRhs = -1.0;
+  }
+};
+
+template <> struct BinaryDerivative<Daixt::DefaultOps::BinaryMultiply>
+{
+  static inline void Apply(double Lhs, double Rhs, double, 
+                           double& dLhs, double& dRhs)
+  { 
+    dLhs = Rhs; 
+    dRhs = Lhs;
+  }
+};
+
+// d(l/r)/dl = 1/r, d(l/r)/dr = -(l/r)/r
+template <> struct BinaryDerivative<Daixt::DefaultOps::BinaryDivide>
+{
+  static inline void Apply(double, double Rhs, double Value, 
+                           double& dLhs, double& dRhs)
+  { 
+    dLhs = 1.0 / Rhs; 
+    dRhs = -Value / Rhs;
+  }
+};
+
+} // namespace Differentiation
+
+} // namespace Daixt 
+
+
+#endif // DAIXT_LOCAL_DERIVATIVES_INC
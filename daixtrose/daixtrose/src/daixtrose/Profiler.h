@@ -0,0 +1,539 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_PROFILER_INC
+#define DAIXT_PROFILER_INC
+
+#include "daixtrose/Expr.h"
+#include "daixtrose/Instrumentation.h"
+#include "daixtrose/ThreadLocal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <ctime>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#elif defined(unix) || defined(__unix) || defined(__unix__) || defined(__APPLE__)
+#include <sys/time.h>
+#define DAIXT_PROFILER_GETTIMEOFDAY
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Profiler for assignments of Linalg::Matrix and Linalg::Vector
+////////////////////////////////////////////////////////////////////////////////
+
+// Compile with -DDAIXT_ENABLE_PROFILER to measure every assignment from an
+// expression. Recorded per assignment:
+//   - wall time, total and self (without nested assignments, e.g. temporaries)
+//   - bytes allocated from Linalg::NodePool in the meantime, which holds all
+//     rows and row temporaries of matrices with a pooled RowStorage (see
+//     PoolAllocator.h). Only the calling thread and the threads working for
+//     it inside parallel loops count.
+//   - entries produced and their payload bytes (index + value)
+//
+// Bandwidth in the report is payload bytes / total time, i.e. the rate at
+// which results are written. Records are appended to a buffer owned by the
+// calling thread without any locking; a full buffer is folded into a
+// per-thread summary. Report() and ReportJSON() merge all threads into a flat
+// profile keyed by the expression type (see Instrumentation.h for the names).
+// Call them only while no assignment is running.
+
+#ifdef DAIXT_ENABLE_PROFILER
+
+#define DAIXT_PROFILE_SCOPE(EXPR_TYPE)                                         \
+  Daixt::Profiler::Scope DaixtProfilerScope                                    \
+    (Daixt::Profiler::SiteOf<EXPR_TYPE>())
+
+#define DAIXT_PROFILE_ENTRIES(N, BYTES_PER_ENTRY)                              \
+  Daixt::Profiler::AddEntries(N, BYTES_PER_ENTRY)
+
+#define DAIXT_PROFILE_ALLOCATION(BYTES)                                        \
+  Daixt::Profiler::AddAllocation(BYTES)
+
+// OpenMP worker threads do not see the scope of the master thread: capture it
+// before the parallel region and enter it in the loop body
+#define DAIXT_PROFILE_CAPTURE                                                  \
+  Daixt::Profiler::Scope* DaixtProfilerCaptured =                              \
+    Daixt::Profiler::Private::ThisThreadsScope()
+
+#define DAIXT_PROFILE_ENTER_CAPTURED                                           \
+  Daixt::Profiler::Private::Worker DaixtProfilerWorker(DaixtProfilerCaptured)
+
+#else
+
+#define DAIXT_PROFILE_SCOPE(EXPR_TYPE)
+#define DAIXT_PROFILE_ENTRIES(N, BYTES_PER_ENTRY)
+#define DAIXT_PROFILE_ALLOCATION(BYTES)
+#define DAIXT_PROFILE_CAPTURE
+#define DAIXT_PROFILE_ENTER_CAPTURED
+
+#endif
+
+
+namespace Daixt 
+{
+
+namespace Profiler
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// one per expression type
+
+struct Site
+{
+  std::string (*Name)();
+};
+
+
+namespace Private
+{
+template <class T>
+inline const Site& SiteOfType()
+{
+  static const Site S = { &Daixt::Instrumentation::TypeName<T>::Get };
+  return S;
+}
+} // namespace Private
+
+
+// Expr<T> and T share their site
+template <class T>
+inline const Site& SiteOf()
+{
+  return Private::SiteOfType<typename Daixt::UnwrapExpr<T>::Type>();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// measurements
+
+struct Record
+{
+  const Site* Where;
+  double Total;
+  double Self;
+  unsigned long Bytes;
+  unsigned long Entries;
+  unsigned long PayloadBytes;
+};
+
+
+struct Summary
+{
+  inline Summary() 
+    : Calls(0), Total(0.0), Self(0.0), Bytes(0), Entries(0), PayloadBytes(0) 
+  {}
+
+  inline void Add(const Record& R)
+  {
+    ++Calls;
+    Total += R.Total;
+    Self += R.Self;
+    Bytes += R.Bytes;
+    Entries += R.Entries;
+    PayloadBytes += R.PayloadBytes;
+  }
+
+  inline void Add(const Summary& S)
+  {
+    Calls += S.Calls;
+    Total += S.Total;
+    Self += S.Self;
+    Bytes += S.Bytes;
+    Entries += S.Entries;
+    PayloadBytes += S.PayloadBytes;
+  }
+
+  unsigned long Calls;
+  double Total;
+  double Self;
+  unsigned long Bytes;
+  unsigned long Entries;
+  unsigned long PayloadBytes;
+};
+
+
+namespace Private
+{
+
+inline double WallTime()
+{
+#if defined(_OPENMP)
+  return omp_get_wtime();
+#elif defined(DAIXT_PROFILER_GETTIMEOFDAY)
+  timeval Now;
+  gettimeofday(&Now, 0);
+  return Now.tv_sec + 1e-6 * Now.tv_usec;
+#else
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+
+// the buffer of one thread. Only its owner writes to it.
+struct ThreadBuffer
+{
+  enum { Capacity = 4096 };
+
+  inline ThreadBuffer() : Next(0) { Records.reserve(Capacity); }
+
+  inline void Push(const Record& R)
+  {
+    if (Records.size() == Capacity) Fold();
+    Records.push_back(R);
+  }
+
+  inline void Fold()
+  {
+    for (std::size_t k = 0; k != Records.size(); ++k)
+      {
+        Folded[Records[k].Where].Add(Records[k]);
+      }
+    Records.clear();
+  }
+
+  std::vector<Record> Records;
+  std::map<const Site*, Summary> Folded;
+  ThreadBuffer* Next;
+};
+
+
+inline ThreadBuffer*& BufferListHead()
+{
+  static ThreadBuffer* Head = 0;
+  return Head;
+}
+
+
+inline ThreadBuffer& ThisThreadsBuffer()
+{
+  static DAIXT_THREAD_LOCAL ThreadBuffer* Buffer = 0;
+  if (Buffer == 0)
+    {
+      // once per thread
+      Buffer = new ThreadBuffer;
+#ifdef _OPENMP
+#pragma omp critical (daixt_profiler_buffers)
+#endif
+      {
+        Buffer->Next = BufferListHead();
+        BufferListHead() = Buffer;
+      }
+    }
+  return *Buffer;
+}
+
+
+// NodePool allocations of this thread
+inline unsigned long& ThisThreadsAllocatedBytes()
+{
+  static DAIXT_THREAD_LOCAL unsigned long Bytes = 0;
+  return Bytes;
+}
+
+
+class ScopeBase;
+
+inline ScopeBase*& ThisThreadsScope()
+{
+  static DAIXT_THREAD_LOCAL ScopeBase* Current = 0;
+  return Current;
+}
+
+
+class ScopeBase
+{
+public:
+  inline explicit ScopeBase(const Site& Where)
+    : Parent_(ThisThreadsScope()), Start_(WallTime()), 
+      StartBytes_(ThisThreadsAllocatedBytes()), ForeignBytes_(0), 
+      Children_(0.0)
+  {
+    Record_.Where = &Where;
+    Record_.Bytes = 0;
+    Record_.Entries = 0;
+    Record_.PayloadBytes = 0;
+    ThisThreadsScope() = this;
+  }
+
+  inline ~ScopeBase()
+  {
+    Record_.Total = WallTime() - Start_;
+    Record_.Self = Record_.Total - Children_;
+    Record_.Bytes = ThisThreadsAllocatedBytes() - StartBytes_ + ForeignBytes_;
+
+    ThisThreadsScope() = Parent_;
+    if (Parent_ != 0) 
+      {
+        // the parent sees the bytes of this thread anyway
+        Parent_->Children_ += Record_.Total;
+        Parent_->AddForeignBytes(ForeignBytes_);
+      }
+
+    ThisThreadsBuffer().Push(Record_);
+  }
+
+  inline void AddEntries(unsigned long N, unsigned long BytesPerEntry)
+  {
+    Record_.Entries += N;
+    Record_.PayloadBytes += N * BytesPerEntry;
+  }
+
+  // allocations of other threads working for this scope
+  inline void AddForeignBytes(unsigned long Bytes)
+  {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+    ForeignBytes_ += Bytes;
+  }
+
+private:
+  ScopeBase(const ScopeBase&);
+  ScopeBase& operator=(const ScopeBase&);
+
+  ScopeBase* Parent_;
+  double Start_;
+  unsigned long StartBytes_;
+  unsigned long ForeignBytes_;
+  double Children_;
+  Record Record_;
+};
+
+
+// one iteration of a parallel loop run for the captured scope: the bytes
+// allocated by a worker thread meanwhile are handed over to that scope
+class Worker
+{
+public:
+  inline explicit Worker(ScopeBase* Captured)
+    : Captured_(Captured), StartBytes_(ThisThreadsAllocatedBytes())
+  {}
+
+  inline ~Worker()
+  {
+    // the thread owning the scope counts its own bytes
+    if (Captured_ != 0 && Captured_ != ThisThreadsScope())
+      {
+        Captured_->AddForeignBytes(ThisThreadsAllocatedBytes() - StartBytes_);
+      }
+  }
+
+private:
+  Worker(const Worker&);
+  Worker& operator=(const Worker&);
+
+  ScopeBase* Captured_;
+  unsigned long StartBytes_;
+};
+
+} // namespace Private
+
+
+typedef Private::ScopeBase Scope;
+
+
+inline void AddEntries(unsigned long N, unsigned long BytesPerEntry)
+{
+  Scope* Current = Private::ThisThreadsScope();
+  if (Current != 0) 
+    {
+      Current->AddEntries(N, BytesPerEntry);
+    }
+}
+
+
+inline void AddAllocation(unsigned long Bytes)
+{
+  Private::ThisThreadsAllocatedBytes() += Bytes;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// flat profile
+
+struct ProfileEntry
+{
+  std::string Expression;
+  Summary Values;
+};
+
+
+namespace Private
+{
+
+struct MoreSelfTime
+{
+  inline bool operator()(const ProfileEntry& lhs, const ProfileEntry& rhs) const
+  {
+    return lhs.Values.Self > rhs.Values.Self;
+  }
+};
+
+
+inline double Bandwidth(const Summary& S)
+{
+  return S.Total > 0.0 ? S.PayloadBytes / S.Total : 0.0;
+}
+
+
+inline std::string JSONString(const std::string& s)
+{
+  std::string Result = "\"";
+  for (std::string::const_iterator iter = s.begin(); iter != s.end(); ++iter)
+    {
+      switch (*iter)
+        {
+        case '"': Result += "\\\""; break;
+        case '\\': Result += "\\\\"; break;
+        case '\n': Result += "\\n"; break;
+        case '\t': Result += "\\t"; break;
+        default: Result += *iter;
+        }
+    }
+  return Result + "\"";
+}
+
+} // namespace Private
+
+
+// merged over all threads, most expensive (self time) first
+inline std::vector<ProfileEntry> FlatProfile()
+{
+  std::map<const Site*, Summary> Merged;
+
+  for (Private::ThreadBuffer* Buffer = Private::BufferListHead(); 
+       Buffer != 0; Buffer = Buffer->Next)
+    {
+      Buffer->Fold();
+      typedef std::map<const Site*, Summary>::const_iterator const_iterator;
+      for (const_iterator iter = Buffer->Folded.begin(); 
+           iter != Buffer->Folded.end(); ++iter)
+        {
+          Merged[iter->first].Add(iter->second);
+        }
+    }
+
+  std::vector<ProfileEntry> Result;
+  typedef std::map<const Site*, Summary>::const_iterator const_iterator;
+  for (const_iterator iter = Merged.begin(); iter != Merged.end(); ++iter)
+    {
+      ProfileEntry Entry;
+      Entry.Expression = iter->first->Name();
+      Entry.Values = iter->second;
+      Result.push_back(Entry);
+    }
+
+  std::stable_sort(Result.begin(), Result.end(), Private::MoreSelfTime());
+  return Result;
+}
+
+
+inline void Report(std::ostream& os)
+{
+#ifndef DAIXT_ENABLE_PROFILER
+  os << "Daixtrose profiler is disabled "
+     << "(compile with -DDAIXT_ENABLE_PROFILER)" << std::endl;
+#else
+  std::vector<ProfileEntry> Profile = FlatProfile();
+  std::streamsize OldPrecision = os.precision();
+
+  os << "Daixtrose flat profile\n"
+     << std::setw(9) << "calls" << ' '
+     << std::setw(11) << "total[s]" << ' '
+     << std::setw(11) << "self[s]" << ' '
+     << std::setw(11) << "alloc[B]" << ' '
+     << std::setw(11) << "entries" << ' '
+     << std::setw(9) << "MB/s" << "  expression\n";
+
+  for (std::size_t k = 0; k != Profile.size(); ++k)
+    {
+      const Summary& S = Profile[k].Values;
+      os << std::setw(9) << S.Calls << ' '
+         << std::setw(11) << std::setprecision(4) << S.Total << ' '
+         << std::setw(11) << std::setprecision(4) << S.Self << ' '
+         << std::setw(11) << S.Bytes << ' '
+         << std::setw(11) << S.Entries << ' '
+         << std::setw(9) << std::setprecision(4) 
+         << Private::Bandwidth(S) * 1e-6 
+         << "  " << Profile[k].Expression << '\n';
+    }
+  os.precision(OldPrecision);
+  os << std::flush;
+#endif
+}
+
+
+inline void ReportJSON(std::ostream& os)
+{
+  std::vector<ProfileEntry> Profile = FlatProfile();
+  std::streamsize OldPrecision = os.precision(9);
+
+  os << "{\"profile\": [";
+  for (std::size_t k = 0; k != Profile.size(); ++k)
+    {
+      const Summary& S = Profile[k].Values;
+      os << (k == 0 ? "\n" : ",\n")
+         << "  {\"expression\": " << Private::JSONString(Profile[k].Expression)
+         << ", \"calls\": " << S.Calls
+         << ", \"total_seconds\": " << S.Total
+         << ", \"self_seconds\": " << S.Self
+         << ", \"bytes_allocated\": " << S.Bytes
+         << ", \"entries\": " << S.Entries
+         << ", \"payload_bytes\": " << S.PayloadBytes
+         << ", \"bytes_per_second\": " << Private::Bandwidth(S)
+         << "}";
+    }
+  os << "\n]}" << std::endl;
+  os.precision(OldPrecision);
+}
+
+
+inline void Reset()
+{
+  for (Private::ThreadBuffer* Buffer = Private::BufferListHead(); 
+       Buffer != 0; Buffer = Buffer->Next)
+    {
+      Buffer->Records.clear();
+      Buffer->Folded.clear();
+    }
+}
+
+} // namespace Profiler
+
+} // namespace Daixt
+
+
+#endif // DAIXT_PROFILER_INC
@@ -0,0 +1,251 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_REVERSE_MODE_INC
+#define DAIXT_REVERSE_MODE_INC
+
+#include "daixtrose/Expr.h"
+#include "daixtrose/BinOps.h"
+#include "daixtrose/UnOps.h"
+#include "daixtrose/ChangeDisambiguation.h"
+#include "daixtrose/CountLeaves.h"
+#include "daixtrose/LocalDerivatives.h"
+
+#include <algorithm>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// reverse mode: value and full gradient in two sweeps
+////////////////////////////////////////////////////////////////////////////////
+
+// Diff(e, Variable<k>) costs a new expression per variable, so a gradient
+// with respect to n variables means n derivative expressions and n
+// evaluations. 
+//
+// Gradient(e, Point, Result, n) does a forward sweep, which evaluates the
+// expression and stores the value of every node, followed by a backward
+// sweep, which passes the adjoint d(e)/d(node) from the root to the leaves
+// using the local derivatives of LocalDerivatives.h. The variables collect
+// their adjoints into Result. Both sweeps visit every node once, so the
+// whole gradient costs about as much as two evaluations, whatever n is.
+//
+// The tape holding the intermediate values is an array on the stack, sized
+// at compile time by NodeCounter (see CountLeaves.h). The node values are
+// stored in post-order: the subtrees first, the node itself last.
+//
+// The leaves must be known to Differentiation::LeafTraits, the ops to
+// UnaryDerivative and BinaryDerivative.
+
+namespace Daixt 
+{
+
+namespace ReverseMode
+{
+
+namespace Private
+{
+
+using Daixt::Differentiation::LeafTraits;
+using Daixt::Differentiation::UnaryDerivative;
+using Daixt::Differentiation::BinaryDerivative;
+
+
+template <bool IsVariable> struct LeafSweep;
+
+template <> struct LeafSweep<true>
+{
+  template <class T>
+  static inline double Value(const T& t, const double* Point)
+  {
+    return Point[LeafTraits<T>::Number(t)];
+  }
+
+  template <class T>
+  static inline void AddAdjoint(const T& t, double Adjoint, double* Gradient)
+  {
+    Gradient[LeafTraits<T>::Number(t)] += Adjoint;
+  }
+};
+
+template <> struct LeafSweep<false>
+{
+  template <class T>
+  static inline double Value(const T& t, const double*)
+  {
+    return LeafTraits<T>::Value(t);
+  }
+
+  template <class T>
+  static inline void AddAdjoint(const T&, double, double*) {}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Forward stores the node values into Tape[0] ... Tape[Size - 1] and returns
+// the value of the node, Backward reads them back
+
+template <class T> 
+struct Sweep
+{
+  typedef LeafSweep<LeafTraits<T>::is_variable> Leaf;
+
+  static inline double Forward(const T& t, const double* Point, double* Tape)
+  {
+    return Tape[0] = Leaf::Value(t, Point);
+  }
+
+  static inline void Backward(const T& t, double Adjoint, 
+                              const double* Tape, double* Gradient)
+  {
+    Leaf::AddAdjoint(t, Adjoint, Gradient);
+  }
+};
+
+
+template <class T> 
+struct Sweep<Daixt::Expr<T> >
+{
+  static inline double Forward(const Daixt::Expr<T>& E, 
+                               const double* Point, double* Tape)
+  {
+    return Sweep<T>::Forward(E.content(), Point, Tape);
+  }
+
+  static inline void Backward(const Daixt::Expr<T>& E, double Adjoint, 
+                              const double* Tape, double* Gradient)
+  {
+    Sweep<T>::Backward(E.content(), Adjoint, Tape, Gradient);
+  }
+};
+
+
+// content() is not a DisambiguationChanger here
+template <class T, class D> 
+struct Sweep<Daixt::Expr<Daixt::DisambiguationChanger<T, D> > >
+{
+  typedef Daixt::Expr<Daixt::DisambiguationChanger<T, D> > ArgT;
+
+  static inline double Forward(const ArgT& E, const double* Point, double* Tape)
+  {
+    return Sweep<T>::Forward(E.content(), Point, Tape);
+  }
+
+  static inline void Backward(const ArgT& E, double Adjoint, 
+                              const double* Tape, double* Gradient)
+  {
+    Sweep<T>::Backward(E.content(), Adjoint, Tape, Gradient);
+  }
+};
+
+
+template <class ARG, class OP> 
+struct Sweep<Daixt::UnOp<ARG, OP> >
+{
+  typedef Daixt::UnOp<ARG, OP> ArgT;
+  static const std::size_t Size = Daixt::NodeCounter<ARG>::Result;
+
+  static inline double Forward(const ArgT& UO, const double* Point, 
+                               double* Tape)
+  {
+    const double Arg = Sweep<ARG>::Forward(UO.arg(), Point, Tape);
+    return Tape[Size] = OP::Apply(Arg, Daixt::Hint<double>());
+  }
+
+  static inline void Backward(const ArgT& UO, double Adjoint, 
+                              const double* Tape, double* Gradient)
+  {
+    const double d = UnaryDerivative<OP>::Apply(Tape[Size - 1], Tape[Size]);
+    Sweep<ARG>::Backward(UO.arg(), Adjoint * d, Tape, Gradient);
+  }
+};
+
+
+template <class LHS, class RHS, class OP> 
+struct Sweep<Daixt::BinOp<LHS, RHS, OP> >
+{
+  typedef Daixt::BinOp<LHS, RHS, OP> ArgT;
+  static const std::size_t LhsSize = Daixt::NodeCounter<LHS>::Result;
+  static const std::size_t Size = LhsSize + Daixt::NodeCounter<RHS>::Result;
+
+  static inline double Forward(const ArgT& BO, const double* Point, 
+                               double* Tape)
+  {
+    const double Lhs = Sweep<LHS>::Forward(BO.lhs(), Point, Tape);
+    const double Rhs = Sweep<RHS>::Forward(BO.rhs(), Point, Tape + LhsSize);
+    return Tape[Size] = OP::Apply(Lhs, Rhs, Daixt::Hint<double>());
+  }
+
+  static inline void Backward(const ArgT& BO, double Adjoint, 
+                              const double* Tape, double* Gradient)
+  {
+    double dLhs, dRhs;
+    BinaryDerivative<OP>::Apply(Tape[LhsSize - 1], Tape[Size - 1], Tape[Size],
+                                dLhs, dRhs);
+
+    Sweep<LHS>::Backward(BO.lhs(), Adjoint * dLhs, Tape, Gradient);
+    Sweep<RHS>::Backward(BO.rhs(), Adjoint * dRhs, Tape + LhsSize, Gradient);
+  }
+};
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the value of e at Point, d(e)/d(x_k) in Result[k] for k < NumberOfVariables.
+// The variables' numbers must be smaller than NumberOfVariables.
+
+template <class T>
+inline double Gradient(const T& e, const double* Point, 
+                       double* Result, std::size_t NumberOfVariables)
+{
+  double Tape[Daixt::NodeCounter<T>::Result];
+
+  std::fill(Result, Result + NumberOfVariables, 0.0);
+
+  const double Value = Private::Sweep<T>::Forward(e, Point, Tape);
+  Private::Sweep<T>::Backward(e, 1.0, Tape, Result);
+
+  return Value;
+}
+
+
+// the value only, on the same tape
+template <class T>
+inline double Evaluate(const T& e, const double* Point)
+{
+  double Tape[Daixt::NodeCounter<T>::Result];
+  return Private::Sweep<T>::Forward(e, Point, Tape);
+}
+
+} // namespace ReverseMode
+
+} // namespace Daixt 
+
+
+#endif // DAIXT_REVERSE_MODE_INC
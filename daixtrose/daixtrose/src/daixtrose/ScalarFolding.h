@@ -0,0 +1,355 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+
+#ifndef DAIXT_SCALAR_FOLDING_INC
+#define DAIXT_SCALAR_FOLDING_INC
+
+#include "daixtrose/Expr.h"
+#include "daixtrose/BinOps.h"
+#include "daixtrose/Scalar.h"
+#include "daixtrose/DefaultOps.h"
+
+#include "boost/mpl/bool.hpp"
+#include "boost/mpl/if.hpp"
+#include "boost/mpl/eval_if.hpp"
+#include "boost/mpl/identity.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// scalar folding at construction time
+////////////////////////////////////////////////////////////////////////////////
+
+// "2.0 * (3.0 * A)" is built as "6.0 * A", so no evaluation ever multiplies an
+// entry twice. Unlike Simplify this happens while the expression is built,
+// with a look at one level only: the inner expression has been folded already
+// when it was built. Only scalars of the same disambiguation are folded, and
+// the folded scalar stays where it was in the inner expression:
+//
+//   (s * X) * t = (s * t) * X      (X * s) * t = X * (s * t)
+//   (s / X) * t = (s * t) / X      (X / s) * t = X * (t / s)
+//   (s * X) / t = (s / t) * X      (X * s) / t = X * (s / t)
+//   (s / X) / t = (s / t) / X      (X / s) / t = X / (s * t)
+//   (s + X) + t = (s + t) + X      (X + s) + t = X + (s + t)
+//   (s - X) + t = (s + t) - X      (X - s) + t = X + (t - s)
+//   (s + X) - t = (s - t) + X      (X + s) - t = X + (s - t)
+//   (s - X) - t = (s - t) - X      (X - s) - t = X - (s + t)
+//
+// and the same with t on the left of * and +. Everything else is built as
+// before.
+
+namespace Daixt 
+{
+
+namespace Private
+{
+
+enum ScalarPosition { no_scalar, scalar_on_left, scalar_on_right };
+
+template <class T, class D> 
+struct IsScalarOf { enum { Result = false }; };
+
+template <class D> 
+struct IsScalarOf<Scalar<D>, D> { enum { Result = true }; };
+
+
+template <class T, class D> 
+struct ScalarPositionOf { enum { Result = no_scalar }; };
+
+template <class LHS, class RHS, class OP, class D> 
+struct ScalarPositionOf<BinOp<LHS, RHS, OP>, D> 
+{ 
+  enum { Result = 
+         IsScalarOf<LHS, D>::Result ? scalar_on_left : 
+         (IsScalarOf<RHS, D>::Result ? scalar_on_right : no_scalar) };
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// a BinOp of X and a scalar at Position
+
+template <class X, class D, class OP, int Position> 
+struct WithScalar;
+
+template <class X, class D, class OP> 
+struct WithScalar<X, D, OP, scalar_on_left>
+{
+  typedef BinOp<Scalar<D>, X, OP> type;
+  typedef typename Scalar<D>::NumericalType NumericalType;
+
+  static inline const X& Rest(const type& BO) { return BO.rhs(); }
+  static inline NumericalType Value(const type& BO) 
+  { 
+    return BO.lhs().Value(); 
+  }
+  static inline type Make(const X& x, const NumericalType& Value)
+  {
+    return type(Scalar<D>(Value), x);
+  }
+};
+
+template <class X, class D, class OP> 
+struct WithScalar<X, D, OP, scalar_on_right>
+{
+  typedef BinOp<X, Scalar<D>, OP> type;
+  typedef typename Scalar<D>::NumericalType NumericalType;
+
+  static inline const X& Rest(const type& BO) { return BO.lhs(); }
+  static inline NumericalType Value(const type& BO) 
+  { 
+    return BO.rhs().Value(); 
+  }
+  static inline type Make(const X& x, const NumericalType& Value)
+  {
+    return type(x, Scalar<D>(Value));
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the rules: "Inner OuterOP t" (or "t OuterOP Inner" if OuterOnLeft) 
+
+template <class Inner, class D, class OuterOP, bool OuterOnLeft, int Position>
+struct ScalarFoldingRule
+{
+  enum { Result = false };
+};
+
+
+#define DAIXT_SCALAR_ON_LEFT(OP) BinOp<Scalar<D>, X, OP>
+#define DAIXT_SCALAR_ON_RIGHT(OP) BinOp<X, Scalar<D>, OP>
+#define DAIXT_POSITION_SCALAR_ON_LEFT scalar_on_left
+#define DAIXT_POSITION_SCALAR_ON_RIGHT scalar_on_right
+
+#define DAIXT_DEFINE_SCALAR_FOLDING(POSITION, INNER_OP, OUTER_OP,              \
+                                    OUTER_ON_LEFT, RESULT_OP, VALUE)          \
+template <class X, class D>                                                   \
+struct ScalarFoldingRule<DAIXT_##POSITION(DefaultOps::INNER_OP), D,           \
+                         DefaultOps::OUTER_OP, OUTER_ON_LEFT,                 \
+                         DAIXT_POSITION_##POSITION>                           \
+{                                                                             \
+  enum { Result = true };                                                     \
+                                                                              \
+  typedef WithScalar<X, D, DefaultOps::INNER_OP,                              \
+                     DAIXT_POSITION_##POSITION> Before;                       \
+  typedef WithScalar<X, D, DefaultOps::RESULT_OP,                             \
+                     DAIXT_POSITION_##POSITION> After;                        \
+  typedef typename After::type type;                                          \
+                                                                              \
+  static inline type Apply(const typename Before::type& Inner,                \
+                           const Scalar<D>& Outer)                            \
+  {                                                                           \
+    typedef typename Scalar<D>::NumericalType NumericalType;                  \
+    const NumericalType s = Before::Value(Inner);                             \
+    const NumericalType t = Outer.Value();                                    \
+    return After::Make(Before::Rest(Inner), VALUE);                           \
+  }                                                                           \
+}
+
+#define DAIXT_DEFINE_SCALAR_FOLDINGS(POSITION, INNER_OP, OUTER_OP,             \
+                                     RESULT_OP, VALUE)                        \
+DAIXT_DEFINE_SCALAR_FOLDING(POSITION, INNER_OP, OUTER_OP, false,              \
+                            RESULT_OP, VALUE);                                \
+DAIXT_DEFINE_SCALAR_FOLDING(POSITION, INNER_OP, OUTER_OP, true,               \
+                            RESULT_OP, VALUE)
+
+
+// * and + are commutative: t may be on either side
+DAIXT_DEFINE_SCALAR_FOLDINGS(SCALAR_ON_LEFT, BinaryMultiply, BinaryMultiply,
+                             BinaryMultiply, s * t);
+DAIXT_DEFINE_SCALAR_FOLDINGS(SCALAR_ON_RIGHT, BinaryMultiply, BinaryMultiply,
+                             BinaryMultiply, s * t);
+DAIXT_DEFINE_SCALAR_FOLDINGS(SCALAR_ON_LEFT, BinaryDivide, BinaryMultiply,
+                             BinaryDivide, s * t);
+DAIXT_DEFINE_SCALAR_FOLDINGS(SCALAR_ON_RIGHT, BinaryDivide, BinaryMultiply,
+                             BinaryMultiply, t / s);
+
+DAIXT_DEFINE_SCALAR_FOLDINGS(SCALAR_ON_LEFT, BinaryPlus, BinaryPlus,
+                             BinaryPlus, s + t);
+DAIXT_DEFINE_SCALAR_FOLDINGS(SCALAR_ON_RIGHT, BinaryPlus, BinaryPlus,
+                             BinaryPlus, s + t);
+DAIXT_DEFINE_SCALAR_FOLDINGS(SCALAR_ON_LEFT, BinaryMinus, BinaryPlus,
+                             BinaryMinus, s + t);
+DAIXT_DEFINE_SCALAR_FOLDINGS(SCALAR_ON_RIGHT, BinaryMinus, BinaryPlus,
+                             BinaryPlus, t - s);
+
+// / and - only with t on the right
+DAIXT_DEFINE_SCALAR_FOLDING(SCALAR_ON_LEFT, BinaryMultiply, BinaryDivide, 
+                            false, BinaryMultiply, s / t);
+DAIXT_DEFINE_SCALAR_FOLDING(SCALAR_ON_RIGHT, BinaryMultiply, BinaryDivide, 
+                            false, BinaryMultiply, s / t);
+DAIXT_DEFINE_SCALAR_FOLDING(SCALAR_ON_LEFT, BinaryDivide, BinaryDivide, 
+                            false, BinaryDivide, s / t);
+DAIXT_DEFINE_SCALAR_FOLDING(SCALAR_ON_RIGHT, BinaryDivide, BinaryDivide, 
+                            false, BinaryDivide, s * t);
+
+DAIXT_DEFINE_SCALAR_FOLDING(SCALAR_ON_LEFT, BinaryPlus, BinaryMinus, 
+                            false, BinaryPlus, s - t);
+DAIXT_DEFINE_SCALAR_FOLDING(SCALAR_ON_RIGHT, BinaryPlus, BinaryMinus, 
+                            false, BinaryPlus, s - t);
+DAIXT_DEFINE_SCALAR_FOLDING(SCALAR_ON_LEFT, BinaryMinus, BinaryMinus, 
+                            false, BinaryMinus, s - t);
+DAIXT_DEFINE_SCALAR_FOLDING(SCALAR_ON_RIGHT, BinaryMinus, BinaryMinus, 
+                            false, BinaryMinus, s + t);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// folds if a rule applies, builds the plain BinOp otherwise
+
+template <class Inner, class D, class OuterOP, bool OuterOnLeft>
+class ScalarFolder
+{
+  typedef ScalarFoldingRule<Inner, D, OuterOP, OuterOnLeft, 
+                            ScalarPositionOf<Inner, D>::Result> Rule;
+
+  typedef typename 
+  boost::mpl::if_c<OuterOnLeft, 
+                   BinOp<Scalar<D>, Inner, OuterOP>,
+                   BinOp<Inner, Scalar<D>, OuterOP> >::type Unfolded;
+
+public:
+  typedef typename 
+  boost::mpl::eval_if_c<Rule::Result, 
+                        Rule, 
+                        boost::mpl::identity<Unfolded> >::type type;
+
+  typedef Expr<type> ReturnType;
+
+  static inline ReturnType Apply(const Inner& i, const Scalar<D>& s)
+  {
+    return ReturnType(Apply(i, s, boost::mpl::bool_<Rule::Result>(),
+                            boost::mpl::bool_<OuterOnLeft>()));
+  }
+
+private:
+  template <class OnLeft>
+  static inline type Apply(const Inner& i, const Scalar<D>& s, 
+                           const boost::mpl::true_& Folded, const OnLeft&)
+  {
+    return Rule::Apply(i, s);
+  }
+
+  static inline type Apply(const Inner& i, const Scalar<D>& s, 
+                           const boost::mpl::false_& Folded, 
+                           const boost::mpl::true_& OnLeft)
+  {
+    return type(s, i);
+  }
+
+  static inline type Apply(const Inner& i, const Scalar<D>& s, 
+                           const boost::mpl::false_& Folded, 
+                           const boost::mpl::false_& OnLeft)
+  {
+    return type(i, s);
+  }
+};
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the operators: more specialized than the ones of DefaultOps.h and Scalar.h.
+// Those of Convenience take a double like the ones of Scalar.h, the folding
+// itself is done in Scalar<D>::NumericalType.
+
+#define DAIXT_DEFINE_FOLDING_SCALAR_BINOP(FN_NAME, OP_NAME)                    \
+template <class LHS, class RHS, class OP, class D>                            \
+inline                                                                        \
+typename Daixt::Private::ScalarFolder<Daixt::BinOp<LHS, RHS, OP>, D,          \
+                                      OP_NAME, false>::ReturnType             \
+FN_NAME(const Daixt::Expr<Daixt::BinOp<LHS, RHS, OP> >& lhs,                  \
+        const Daixt::Scalar<D>& rhs)                                          \
+{                                                                             \
+  return Daixt::Private::ScalarFolder<Daixt::BinOp<LHS, RHS, OP>, D,          \
+                                      OP_NAME, false>::Apply(lhs.content(),   \
+                                                             rhs);            \
+}                                                                             \
+                                                                              \
+template <class LHS, class RHS, class OP, class D>                            \
+inline                                                                        \
+typename Daixt::Private::ScalarFolder<Daixt::BinOp<LHS, RHS, OP>, D,          \
+                                      OP_NAME, true>::ReturnType              \
+FN_NAME(const Daixt::Scalar<D>& lhs,                                          \
+        const Daixt::Expr<Daixt::BinOp<LHS, RHS, OP> >& rhs)                  \
+{                                                                             \
+  return Daixt::Private::ScalarFolder<Daixt::BinOp<LHS, RHS, OP>, D,          \
+                                      OP_NAME, true>::Apply(rhs.content(),    \
+                                                            lhs);             \
+}
+
+#define DAIXT_DEFINE_FOLDING_CONVENIENCE_BINOP(FN_NAME, OP_NAME)               \
+template <class LHS, class RHS, class OP>                                     \
+inline                                                                        \
+typename Daixt::Private::ScalarFolder<                                         \
+  Daixt::BinOp<LHS, RHS, OP>,                                                  \
+  typename Daixt::Expr<Daixt::BinOp<LHS, RHS, OP> >::Disambiguation,           \
+  OP_NAME, false>::ReturnType                                                 \
+FN_NAME(const Daixt::Expr<Daixt::BinOp<LHS, RHS, OP> >& lhs, double d)        \
+{                                                                             \
+  typedef typename                                                            \
+    Daixt::Expr<Daixt::BinOp<LHS, RHS, OP> >::Disambiguation D;                \
+  return Daixt::Private::ScalarFolder<Daixt::BinOp<LHS, RHS, OP>, D,          \
+                                      OP_NAME, false>::Apply(lhs.content(),   \
+                                                      Daixt::Scalar<D>(d));    \
+}                                                                             \
+                                                                              \
+template <class LHS, class RHS, class OP>                                     \
+inline                                                                        \
+typename Daixt::Private::ScalarFolder<                                         \
+  Daixt::BinOp<LHS, RHS, OP>,                                                  \
+  typename Daixt::Expr<Daixt::BinOp<LHS, RHS, OP> >::Disambiguation,           \
+  OP_NAME, true>::ReturnType                                                  \
+FN_NAME(double d, const Daixt::Expr<Daixt::BinOp<LHS, RHS, OP> >& rhs)        \
+{                                                                             \
+  typedef typename                                                            \
+    Daixt::Expr<Daixt::BinOp<LHS, RHS, OP> >::Disambiguation D;                \
+  return Daixt::Private::ScalarFolder<Daixt::BinOp<LHS, RHS, OP>, D,          \
+                                      OP_NAME, true>::Apply(rhs.content(),    \
+                                                     Daixt::Scalar<D>(d));     \
+}
+
+
+namespace DefaultOps
+{
+DAIXT_DEFINE_FOLDING_SCALAR_BINOP(operator*, BinaryMultiply)
+DAIXT_DEFINE_FOLDING_SCALAR_BINOP(operator/, BinaryDivide)
+DAIXT_DEFINE_FOLDING_SCALAR_BINOP(operator+, BinaryPlus)
+DAIXT_DEFINE_FOLDING_SCALAR_BINOP(operator-, BinaryMinus)
+} // namespace DefaultOps
+
+namespace Convenience
+{
+DAIXT_DEFINE_FOLDING_CONVENIENCE_BINOP(operator*, DefaultOps::BinaryMultiply)
+DAIXT_DEFINE_FOLDING_CONVENIENCE_BINOP(operator/, DefaultOps::BinaryDivide)
+DAIXT_DEFINE_FOLDING_CONVENIENCE_BINOP(operator+, DefaultOps::BinaryPlus)
+DAIXT_DEFINE_FOLDING_CONVENIENCE_BINOP(operator-, DefaultOps::BinaryMinus)
+} // namespace Convenience
+
+} // namespace Daixt 
+
+#endif // DAIXT_SCALAR_FOLDING_INC
@@ -0,0 +1,631 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_TAPE_INC
+#define DAIXT_TAPE_INC
+
+#include "daixtrose/Dynamic.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Tape: expressions compiled to a flat list of instructions
+////////////////////////////////////////////////////////////////////////////////
+
+// Formulas which are evaluated for huge numbers of points should not walk
+// through templates and virtual functions for every single point. 
+//
+// Compiler compiles the nodes of a Dynamic::Graph (see Dynamic.h), a static
+// expression is converted to such a graph first. The compiled nodes live in
+// a graph of their own: identical subexpressions are compiled only once,
+// operations on constants only are evaluated at compile time, and the
+// operands of + and * are ordered, so a * b and b * a are the same node.
+// Finish() removes what does not contribute to an output and assigns 
+// registers such that a register is reused as soon as its value is dead.
+//
+// Program interprets the instructions for blocks of BlockSize points: every
+// instruction is a loop over the points of a block, which the compiler can
+// vectorize, and the dispatch costs once per instruction and block.
+//
+// An instruction is a node of the graph with registers as operands: all ops
+// known to Daixt work, the standard arithmetic and RationalPower get loops
+// of their own, all others are called via a pointer to OP::Apply. The
+// conversion is customized via Dynamic::ConvertImpl.
+//
+// Formulas behind a runtime-polymorphic base class (see
+// demos/Formulas/UsingFeaturesOfExpression.C) get a virtual Compile member
+// by deriving the base from Compilable and its FeaturesOfExpression from
+// CompilableExpression:
+//
+//   struct MyBase : public Daixt::Tape::Compilable { ... };
+//
+//   template <class T> class FeaturesOfExpression<MyBase, T> 
+//     : public Daixt::Tape::CompilableExpression<MyBase, T> { ... };
+
+namespace Daixt 
+{
+
+namespace Tape
+{
+
+// a node on registers: Target is the register of the result, Lhs and Rhs 
+// those of the operands, a variable keeps its number in Lhs. A store copies
+// register Lhs to the output Target.
+struct Instruction : public Daixt::Dynamic::Node
+{
+  bool Store;
+  std::size_t Target;
+};
+
+
+class Compiler;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Program: the result of Compiler::Finish()
+
+class Program
+{
+public:
+  static const std::size_t BlockSize = 64;
+
+  inline Program() 
+    : NumberOfVariables_(0), NumberOfOutputs_(0), NumberOfRegisters_(0), 
+      NumberOfConstants_(0) 
+  {}
+
+  inline std::size_t NumberOfVariables() const { return NumberOfVariables_; }
+  inline std::size_t NumberOfOutputs() const { return NumberOfOutputs_; }
+  inline std::size_t NumberOfRegisters() const { return NumberOfRegisters_; }
+  inline const std::vector<Instruction>& Code() const { return Code_; }
+
+  // one array per variable: Variables[v][Point], Outputs[o][Point]
+  inline void Evaluate(const double* const* Variables, 
+                       double* const* Outputs, 
+                       std::size_t NumberOfPoints) const;
+
+  // all variables of a point side by side:
+  // Values[Point * NumberOfVariables() + v], Outputs[o][Point]
+  inline void EvaluateInterleaved(const double* Values, 
+                                  double* const* Outputs, 
+                                  std::size_t NumberOfPoints) const;
+
+  // a single point: Results[o]
+  inline void Evaluate(const double* Point, double* Results) const;
+
+  // the general form: Variables[v][Point * InputStride], 
+  // Outputs[o][Point * OutputStride]
+  inline void Evaluate(const double* const* Variables, std::size_t InputStride,
+                       double* const* Outputs, std::size_t OutputStride, 
+                       std::size_t NumberOfPoints) const
+  {
+    Run(Variables, InputStride, Outputs, OutputStride, NumberOfPoints);
+  }
+
+  // the same with the caller's scratch memory of NumberOfScratchValues()
+  // doubles, e.g. one per thread, instead of a fresh one per call
+  inline std::size_t NumberOfScratchValues() const 
+  { 
+    return NumberOfRegisters_ * BlockSize + 1; 
+  }
+
+  inline void Evaluate(const double* const* Variables, std::size_t InputStride,
+                       double* const* Outputs, std::size_t OutputStride, 
+                       std::size_t NumberOfPoints, double* Scratch) const
+  {
+    Run(Variables, InputStride, Outputs, OutputStride, NumberOfPoints, 
+        Scratch);
+  }
+
+private:
+  friend class Compiler;
+
+  inline void Run(const double* const* Variables, std::size_t InputStride, 
+                  double* const* Outputs, std::size_t OutputStride, 
+                  std::size_t NumberOfPoints) const;
+
+  inline void Run(const double* const* Variables, std::size_t InputStride, 
+                  double* const* Outputs, std::size_t OutputStride, 
+                  std::size_t NumberOfPoints, double* Registers) const;
+
+  inline void Execute(const Instruction& I, double* Registers, 
+                      const double* const* Variables, 
+                      std::size_t InputStride, 
+                      double* const* Outputs, std::size_t OutputStride, 
+                      std::size_t First, std::size_t Count) const;
+
+  std::vector<Instruction> Code_; // the constants come first
+  std::size_t NumberOfVariables_;
+  std::size_t NumberOfOutputs_;
+  std::size_t NumberOfRegisters_;
+  std::size_t NumberOfConstants_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compiler
+
+class Compiler
+{
+public:
+  // the leaves
+  inline std::size_t Constant(double Value) { return Graph_.Constant(Value); }
+
+  inline std::size_t Variable(std::size_t Number) // counted from 0
+  { 
+    return Graph_.Variable(Number); 
+  }
+
+  // Node of G and all nodes it depends on
+  inline std::size_t Compile(const Daixt::Dynamic::Graph& G, std::size_t Node);
+
+  template <class T> inline std::size_t Compile(const T& Expression)
+  {
+    Daixt::Dynamic::Graph G;
+    return Compile(G, G.Convert(Expression));
+  }
+
+  // returns the number of the output
+  inline std::size_t AddOutput(std::size_t Node)
+  {
+    if (Node >= Graph_.NumberOfNodes())
+      {
+        throw std::range_error("Daixt::Tape::Compiler::AddOutput: "
+                               "no such node");
+      }
+    Outputs_.push_back(Node);
+    return Outputs_.size() - 1;
+  }
+
+  inline std::size_t NumberOfNodes() const { return Graph_.NumberOfNodes(); }
+
+  // the compiled nodes
+  inline const Daixt::Dynamic::Graph& GetGraph() const { return Graph_; }
+
+  inline Program Finish() const;
+
+private:
+  inline std::size_t Fold(Daixt::Dynamic::Node N);
+
+  Daixt::Dynamic::Graph Graph_;
+  std::vector<std::size_t> Outputs_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+//**************************** Implementation ********************************//
+////////////////////////////////////////////////////////////////////////////////
+
+namespace Private
+{
+
+inline Instruction MakeInstruction(const Daixt::Dynamic::Node& N, 
+                                   std::size_t Target)
+{
+  Instruction I;
+  static_cast<Daixt::Dynamic::Node&>(I) = N;
+  I.Store = false;
+  I.Target = Target;
+  return I;
+}
+
+
+inline Instruction MakeStore(std::size_t Register, std::size_t Output)
+{
+  Instruction I = MakeInstruction(Daixt::Dynamic::Private::
+                                  MakeNode(Daixt::Dynamic::variable, Register),
+                                  Output);
+  I.Store = true;
+  return I;
+}
+
+} // namespace Private
+
+
+// N refers to compiled nodes already
+std::size_t Compiler::Fold(Daixt::Dynamic::Node N)
+{
+  using Daixt::Dynamic::Private::IsLeaf;
+  using Daixt::Dynamic::Private::IsUnary;
+
+  // x^(1/-1) is 1 / x
+  if (N.What == Daixt::Dynamic::power && N.n < 0)
+    {
+      N.m = -N.m;
+      N.n = -N.n;
+    }
+
+  if (!IsLeaf(N.What))
+    {
+      const bool Unary = IsUnary(N.What);
+      if (Graph_[N.Lhs].What == Daixt::Dynamic::constant 
+          && (Unary || Graph_[N.Rhs].What == Daixt::Dynamic::constant))
+        {
+          return Constant(Daixt::Dynamic::Private::
+                          Apply(N, Graph_[N.Lhs].Constant, 
+                                Unary ? 0.0 : Graph_[N.Rhs].Constant));
+        }
+
+      // a + b and b + a are the same
+      if ((N.What == Daixt::Dynamic::plus || N.What == Daixt::Dynamic::multiply)
+          && N.Rhs < N.Lhs)
+        std::swap(N.Lhs, N.Rhs);
+    }
+
+  return Graph_.Add(N);
+}
+
+
+std::size_t Compiler::Compile(const Daixt::Dynamic::Graph& G, std::size_t Node)
+{
+  std::vector<std::size_t> Order;
+  Daixt::Dynamic::Private::CollectNodes(G, std::vector<std::size_t>(1, Node), 
+                                        "Daixt::Tape::Compiler::Compile", 
+                                        Order);
+
+  // the node of G -> the compiled node
+  std::vector<std::size_t> Compiled(G.NumberOfNodes());
+  for (std::size_t i = 0; i != Order.size(); ++i)
+    {
+      Daixt::Dynamic::Node N = G[Order[i]];
+      if (!Daixt::Dynamic::Private::IsLeaf(N.What))
+        {
+          N.Lhs = Compiled[N.Lhs];
+          if (!Daixt::Dynamic::Private::IsUnary(N.What)) 
+            N.Rhs = Compiled[N.Rhs];
+        }
+      Compiled[Order[i]] = Fold(N);
+    }
+  return Compiled[Node];
+}
+
+
+Program Compiler::Finish() const
+{
+  using Daixt::Dynamic::Private::IsLeaf;
+  using Daixt::Dynamic::Private::IsUnary;
+
+  const std::size_t n = Graph_.NumberOfNodes();
+  const std::size_t Unused = static_cast<std::size_t>(-1);
+
+  // the nodes which contribute to an output, in order of evaluation
+  std::vector<std::size_t> Order;
+  Daixt::Dynamic::Private::CollectNodes(Graph_, Outputs_, 
+                                        "Daixt::Tape::Compiler::Finish", 
+                                        Order);
+
+  // last reader of each node; outputs are stored right after their node
+  std::vector<std::size_t> LastUse(n, Unused);
+  std::vector<std::vector<std::size_t> > OutputsOf(n);
+  for (std::size_t k = 0; k != Outputs_.size(); ++k) 
+    {
+      OutputsOf[Outputs_[k]].push_back(k);
+      LastUse[Outputs_[k]] = Outputs_[k];
+    }
+  for (std::size_t i = 0; i != Order.size(); ++i)
+    {
+      const Daixt::Dynamic::Node& N = Graph_[Order[i]];
+      if (IsLeaf(N.What)) continue;
+      LastUse[N.Lhs] = Order[i];
+      if (!IsUnary(N.What)) LastUse[N.Rhs] = Order[i];
+    }
+
+  Program Result;
+  Result.NumberOfVariables_ = Graph_.NumberOfVariables();
+  Result.NumberOfOutputs_ = Outputs_.size();
+
+  std::vector<std::size_t> Register(n, Unused);
+  std::vector<std::size_t> Free;
+
+  // constants live in registers of their own which are filled only once
+  for (std::size_t i = 0; i != Order.size(); ++i)
+    {
+      const std::size_t k = Order[i];
+      if (Graph_[k].What != Daixt::Dynamic::constant) continue;
+      Register[k] = Result.NumberOfRegisters_++;
+      Result.Code_.push_back(Private::MakeInstruction(Graph_[k], Register[k]));
+      ++Result.NumberOfConstants_;
+    }
+
+  for (std::size_t i = 0; i != Order.size(); ++i)
+    {
+      const std::size_t k = Order[i];
+      const Daixt::Dynamic::Node& N = Graph_[k];
+      if (N.What == Daixt::Dynamic::constant) continue;
+
+      Instruction I = Private::MakeInstruction(N, 0);
+
+      if (N.What != Daixt::Dynamic::variable)
+        {
+          const std::size_t Lhs = N.Lhs;
+          const std::size_t Rhs = IsUnary(N.What) ? N.Lhs : N.Rhs;
+          I.Lhs = Register[Lhs];
+          I.Rhs = Register[Rhs];
+
+          // operands read for the last time may hand over their registers
+          // right away: the interpreter works entry by entry
+          if (LastUse[Lhs] == k && Graph_[Lhs].What != Daixt::Dynamic::constant)
+            Free.push_back(Register[Lhs]);
+          if (Rhs != Lhs && LastUse[Rhs] == k 
+              && Graph_[Rhs].What != Daixt::Dynamic::constant) 
+            Free.push_back(Register[Rhs]);
+        }
+
+      if (Free.empty())
+        {
+          Register[k] = Result.NumberOfRegisters_++;
+        }
+      else
+        {
+          Register[k] = Free.back();
+          Free.pop_back();
+        }
+      I.Target = Register[k];
+      Result.Code_.push_back(I);
+
+      for (std::size_t o = 0; o != OutputsOf[k].size(); ++o)
+        {
+          Result.Code_.push_back(Private::MakeStore(Register[k], 
+                                                    OutputsOf[k][o]));
+        }
+
+      if (LastUse[k] == k || LastUse[k] == Unused) Free.push_back(Register[k]);
+    }
+
+  // outputs which are constants
+  for (std::size_t k = 0; k != Outputs_.size(); ++k)
+    {
+      if (Graph_[Outputs_[k]].What != Daixt::Dynamic::constant) continue;
+      Result.Code_.push_back(Private::MakeStore(Register[Outputs_[k]], k));
+    }
+
+  return Result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the interpreter
+
+void Program::Execute(const Instruction& I, double* Registers, 
+                      const double* const* Variables, std::size_t InputStride, 
+                      double* const* Outputs, std::size_t OutputStride, 
+                      std::size_t First, std::size_t Count) const
+{
+  double* t = Registers + I.Target * BlockSize;
+  const double* a = Registers + I.Lhs * BlockSize;
+  const double* b = Registers + I.Rhs * BlockSize;
+
+  if (I.Store)
+    {
+      double* Out = Outputs[I.Target] + First * OutputStride;
+      if (OutputStride == 1)
+        for (std::size_t k = 0; k < Count; ++k) Out[k] = a[k];
+      else
+        for (std::size_t k = 0; k < Count; ++k) Out[k * OutputStride] = a[k];
+      return;
+    }
+
+  switch (I.What)
+    {
+    case Daixt::Dynamic::constant:
+      for (std::size_t k = 0; k != BlockSize; ++k) t[k] = I.Constant;
+      break;
+    case Daixt::Dynamic::variable:
+      {
+        const double* In = Variables[I.Lhs] + First * InputStride;
+        if (InputStride == 1)
+          for (std::size_t k = 0; k < Count; ++k) t[k] = In[k];
+        else
+          for (std::size_t k = 0; k < Count; ++k) t[k] = In[k * InputStride];
+      }
+      break;
+    case Daixt::Dynamic::plus:
+      for (std::size_t k = 0; k < Count; ++k) t[k] = a[k] + b[k];
+      break;
+    case Daixt::Dynamic::minus:
+      for (std::size_t k = 0; k < Count; ++k) t[k] = a[k] - b[k];
+      break;
+    case Daixt::Dynamic::multiply:
+      for (std::size_t k = 0; k < Count; ++k) t[k] = a[k] * b[k];
+      break;
+    case Daixt::Dynamic::divide:
+      for (std::size_t k = 0; k < Count; ++k) t[k] = a[k] / b[k];
+      break;
+    case Daixt::Dynamic::negate:
+      for (std::size_t k = 0; k < Count; ++k) t[k] = -a[k];
+      break;
+    case Daixt::Dynamic::power:
+      if (I.m == -1 && I.n == 1)
+        for (std::size_t k = 0; k < Count; ++k) t[k] = 1.0 / a[k];
+      else if (I.m == 1 && I.n == 2)
+        for (std::size_t k = 0; k < Count; ++k) t[k] = std::sqrt(a[k]);
+      else
+        for (std::size_t k = 0; k < Count; ++k) 
+          t[k] = Daixt::Dynamic::Private::Power(a[k], I.m, I.n);
+      break;
+    case Daixt::Dynamic::call_unary:
+      for (std::size_t k = 0; k < Count; ++k) t[k] = I.Unary(a[k]);
+      break;
+    case Daixt::Dynamic::call_binary:
+      for (std::size_t k = 0; k < Count; ++k) t[k] = I.Binary(a[k], b[k]);
+      break;
+    }
+}
+
+
+void Program::Run(const double* const* Variables, std::size_t InputStride, 
+                  double* const* Outputs, std::size_t OutputStride, 
+                  std::size_t NumberOfPoints) const
+{
+  std::vector<double> Registers(NumberOfScratchValues());
+  Run(Variables, InputStride, Outputs, OutputStride, NumberOfPoints, 
+      &Registers[0]);
+}
+
+
+void Program::Run(const double* const* Variables, std::size_t InputStride, 
+                  double* const* Outputs, std::size_t OutputStride, 
+                  std::size_t NumberOfPoints, double* Registers) const
+{
+  for (std::size_t i = 0; i != NumberOfConstants_; ++i)
+    {
+      Execute(Code_[i], Registers, Variables, InputStride, 
+              Outputs, OutputStride, 0, BlockSize);
+    }
+
+  for (std::size_t First = 0; First < NumberOfPoints; First += BlockSize)
+    {
+      const std::size_t Count = 
+        (NumberOfPoints - First < BlockSize) ? NumberOfPoints - First 
+        : BlockSize;
+
+      for (std::size_t i = NumberOfConstants_; i != Code_.size(); ++i)
+        {
+          Execute(Code_[i], Registers, Variables, InputStride, 
+                  Outputs, OutputStride, First, Count);
+        }
+    }
+}
+
+
+void Program::Evaluate(const double* const* Variables, 
+                       double* const* Outputs, 
+                       std::size_t NumberOfPoints) const
+{
+  Run(Variables, 1, Outputs, 1, NumberOfPoints);
+}
+
+
+void Program::EvaluateInterleaved(const double* Values, 
+                                  double* const* Outputs, 
+                                  std::size_t NumberOfPoints) const
+{
+  std::vector<const double*> Variables(NumberOfVariables_ + 1);
+  for (std::size_t v = 0; v != NumberOfVariables_; ++v)
+    {
+      Variables[v] = Values + v;
+    }
+  Run(&Variables[0], NumberOfVariables_, Outputs, 1, NumberOfPoints);
+}
+
+
+void Program::Evaluate(const double* Point, double* Results) const
+{
+  std::vector<const double*> Variables(NumberOfVariables_ + 1);
+  for (std::size_t v = 0; v != NumberOfVariables_; ++v)
+    {
+      Variables[v] = Point + v;
+    }
+  std::vector<double*> Outputs(NumberOfOutputs_ + 1);
+  for (std::size_t o = 0; o != NumberOfOutputs_; ++o)
+    {
+      Outputs[o] = Results + o;
+    }
+  Run(&Variables[0], 1, &Outputs[0], 1, 1);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// listing
+
+inline std::ostream& operator<<(std::ostream& os, const Program& P)
+{
+  for (std::size_t i = 0; i != P.Code().size(); ++i)
+    {
+      const Instruction& I = P.Code()[i];
+      if (I.Store)
+        {
+          os << "out" << I.Target << " = r" << I.Lhs << '\n';
+          continue;
+        }
+
+      os << 'r' << I.Target << " = ";
+      switch (I.What)
+        {
+        case Daixt::Dynamic::constant: os << I.Constant; break;
+        case Daixt::Dynamic::variable: os << 'x' << I.Lhs; break;
+        case Daixt::Dynamic::plus: 
+          os << 'r' << I.Lhs << " + r" << I.Rhs; break;
+        case Daixt::Dynamic::minus: 
+          os << 'r' << I.Lhs << " - r" << I.Rhs; break;
+        case Daixt::Dynamic::multiply: 
+          os << 'r' << I.Lhs << " * r" << I.Rhs; break;
+        case Daixt::Dynamic::divide: 
+          os << 'r' << I.Lhs << " / r" << I.Rhs; break;
+        case Daixt::Dynamic::negate: os << "-r" << I.Lhs; break;
+        case Daixt::Dynamic::power: 
+          if (I.m == -1 && I.n == 1) 
+            os << "1 / r" << I.Lhs;
+          else if (I.m == 1 && I.n == 2) 
+            os << "sqrt(r" << I.Lhs << ')';
+          else
+            os << "pow(r" << I.Lhs << ", " << I.m << '/' << I.n << ')';
+          break;
+        case Daixt::Dynamic::call_unary: os << "f(r" << I.Lhs << ')'; break;
+        case Daixt::Dynamic::call_binary: 
+          os << "f(r" << I.Lhs << ", r" << I.Rhs << ')'; break;
+        }
+      os << '\n';
+    }
+  return os;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// runtime-polymorphic formulas, see above
+
+class Compilable
+{
+public:
+  // returns the node of the formula
+  virtual std::size_t Compile(Compiler& C) const = 0;
+  virtual ~Compilable() {}
+};
+
+
+template <class Base, class T> class CompilableExpression : public Base
+{
+public:
+  std::size_t Compile(Compiler& C) const
+  {
+    return C.Compile(static_cast<const T&>(*this));
+  }
+};
+
+} // namespace Tape
+
+} // namespace Daixt
+
+
+#endif // DAIXT_TAPE_INC
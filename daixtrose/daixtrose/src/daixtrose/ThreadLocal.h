@@ -0,0 +1,53 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_THREAD_LOCAL_INC
+#define DAIXT_THREAD_LOCAL_INC
+
+////////////////////////////////////////////////////////////////////////////////
+// DAIXT_THREAD_LOCAL: storage class for per-thread caches
+////////////////////////////////////////////////////////////////////////////////
+
+// Only plain old data (pointers, counters) may be declared DAIXT_THREAD_LOCAL,
+// since the compiler extensions used here do not run constructors.  Define
+// DAIXT_NO_THREAD_LOCAL if Your compiler chokes on it; then the caches are
+// shared by all threads and You must not evaluate expressions concurrently.
+
+#if defined(DAIXT_NO_THREAD_LOCAL)
+#  define DAIXT_THREAD_LOCAL
+#elif defined(__GNUC__)
+#  define DAIXT_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#  define DAIXT_THREAD_LOCAL __declspec(thread)
+#else
+#  define DAIXT_NO_THREAD_LOCAL
+#  define DAIXT_THREAD_LOCAL
+#endif
+
+
+#endif // DAIXT_THREAD_LOCAL_INC
@@ -0,0 +1,271 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_WORK_STEALING_INC
+#define DAIXT_WORK_STEALING_INC
+
+#include "daixtrose/ExceptionTrap.h"
+
+#include <cstddef>
+#include <stdexcept>
+
+#include "boost/scoped_array.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Work stealing over a range of items
+////////////////////////////////////////////////////////////////////////////////
+
+// ForEachChunk(NumberOfItems, ChunkSize, Body) cuts 0, ..., NumberOfItems - 1
+// into chunks of ChunkSize items (the last one may be shorter) and calls 
+//
+//   Local(First, Last)
+//
+// exactly once for every chunk [First, Last), where Local is a copy of Body
+// made by the thread which processes the chunk. Everything a thread needs as
+// scratch memory belongs into Body: it is allocated once per thread and
+// reused for all chunks of that thread.
+//
+// Each thread of the OpenMP team starts with a contiguous share of the
+// chunks, which it takes from the front. A thread running out of work steals
+// the back half of the remaining chunks of another thread, so expensive
+// items, or a thread delayed by the system, do not leave the others idle,
+// while a balanced load costs no more than one lock per chunk. Without 
+// OpenMP the chunks are processed in order by the calling thread.
+//
+// The first exception thrown by a Body is rethrown after all threads are 
+// done (see ExceptionTrap.h). The return value is the number of steals.
+
+namespace Daixt 
+{
+
+namespace WorkStealing
+{
+
+namespace Private
+{
+
+#ifdef _OPENMP
+
+class Lock
+{
+public:
+  inline Lock() { omp_init_lock(&Lock_); }
+  inline ~Lock() { omp_destroy_lock(&Lock_); }
+  inline void Acquire() { omp_set_lock(&Lock_); }
+  inline void Release() { omp_unset_lock(&Lock_); }
+
+private:
+  // not copyable
+  Lock(const Lock&);
+  Lock& operator=(const Lock&);
+
+  omp_lock_t Lock_;
+};
+
+#else
+
+class Lock
+{
+public:
+  inline void Acquire() {}
+  inline void Release() {}
+};
+
+#endif
+
+
+// the chunks Begin, ..., End - 1 of a thread. The owner pops from the front,
+// thieves take from the back. Each queue gets a cache line of its own.
+class ChunkQueue
+{
+public:
+  inline ChunkQueue() : Begin_(0), End_(0) {}
+
+  inline void Assign(std::size_t Begin, std::size_t End)
+  {
+    Lock_.Acquire();
+    Begin_ = Begin;
+    End_ = End;
+    Lock_.Release();
+  }
+
+  inline bool PopFront(std::size_t& Chunk)
+  {
+    Lock_.Acquire();
+    const bool Found = Begin_ != End_;
+    if (Found)
+      {
+        Chunk = Begin_++;
+      }
+    Lock_.Release();
+    return Found;
+  }
+
+  // the back half, rounded up
+  inline bool StealBack(std::size_t& Begin, std::size_t& End)
+  {
+    Lock_.Acquire();
+    const bool Found = Begin_ != End_;
+    if (Found)
+      {
+        End = End_;
+        Begin = End_ - (End_ - Begin_ + 1) / 2;
+        End_ = Begin;
+      }
+    Lock_.Release();
+    return Found;
+  }
+
+private:
+  // not copyable
+  ChunkQueue(const ChunkQueue&);
+  ChunkQueue& operator=(const ChunkQueue&);
+
+  std::size_t Begin_;
+  std::size_t End_;
+  Lock Lock_;
+  char Padding_[64];
+};
+
+
+template <class Body>
+inline std::size_t 
+Work(std::size_t Thread, ChunkQueue* Queues, std::size_t NumberOfThreads, 
+     std::size_t NumberOfItems, std::size_t ChunkSize, const Body& Prototype)
+{
+  Body Local(Prototype);
+  std::size_t Steals = 0;
+
+  for (;;)
+    {
+      std::size_t Chunk = 0;
+
+      if (!Queues[Thread].PopFront(Chunk))
+        {
+          bool Stolen = false;
+          for (std::size_t k = 1; k != NumberOfThreads && !Stolen; ++k)
+            {
+              std::size_t Begin, End;
+              Stolen = Queues[(Thread + k) % NumberOfThreads].
+                StealBack(Begin, End);
+              if (Stolen)
+                {
+                  Chunk = Begin;
+                  Queues[Thread].Assign(Begin + 1, End);
+                  ++Steals;
+                }
+            }
+
+          // the chunks stolen by others are theirs now, we are done
+          if (!Stolen)
+            {
+              return Steals;
+            }
+        }
+
+      const std::size_t First = Chunk * ChunkSize;
+      const std::size_t Last = 
+        NumberOfItems - First < ChunkSize ? NumberOfItems : First + ChunkSize;
+      Local(First, Last);
+    }
+}
+
+} // namespace Private
+
+
+template <class Body>
+std::size_t ForEachChunk(std::size_t NumberOfItems, std::size_t ChunkSize, 
+                         const Body& Prototype)
+{
+  if (ChunkSize == 0)
+    {
+      throw std::invalid_argument
+        ("Daixt::WorkStealing::ForEachChunk: ChunkSize must not be 0");
+    }
+
+  const std::size_t NumberOfChunks = (NumberOfItems + ChunkSize - 1) / ChunkSize;
+
+#ifdef _OPENMP
+  const std::size_t MaxThreads = omp_get_max_threads();
+#else
+  const std::size_t MaxThreads = 1;
+#endif
+  const std::size_t NumberOfThreads = 
+    NumberOfChunks < MaxThreads ? NumberOfChunks : MaxThreads;
+
+  if (NumberOfThreads == 0)
+    {
+      return 0;
+    }
+
+  boost::scoped_array<Private::ChunkQueue> 
+    Queues(new Private::ChunkQueue[NumberOfThreads]);
+  for (std::size_t t = 0; t != NumberOfThreads; ++t)
+    {
+      Queues[t].Assign(t * NumberOfChunks / NumberOfThreads, 
+                       (t + 1) * NumberOfChunks / NumberOfThreads);
+    }
+
+  Daixt::Private::ExceptionTrap Trap;
+  std::size_t Steals = 0;
+
+  // OpenMP wants a signed loop index
+  const long n = static_cast<long>(NumberOfThreads);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(NumberOfThreads) \
+  reduction(+:Steals)
+#endif
+  for (long t = 0; t < n; ++t)
+    {
+      try 
+        {
+          Steals += Private::Work(t, &Queues[0], NumberOfThreads, 
+                                  NumberOfItems, ChunkSize, Prototype);
+        }
+      catch (...) 
+        {
+          Trap.StoreCurrent();
+        }
+    }
+
+  Trap.Rethrow();
+  return Steals;
+}
+
+} // namespace WorkStealing
+
+} // namespace Daixt 
+
+
+#endif // DAIXT_WORK_STEALING_INC
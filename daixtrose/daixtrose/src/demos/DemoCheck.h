@@ -0,0 +1,107 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_DEMO_CHECK_INC
+#define DAIXT_DEMO_CHECK_INC
+
+// the little checking helpers shared by the self-checking demos: each
+// check either reports "What: OK" or throws, so main() only needs the
+// usual try/catch around its body
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+
+inline void Expect(bool Condition, const char* What)
+{
+  if (!Condition) 
+    throw std::logic_error(std::string("wrong result in ") + What);
+  std::cerr << What << ": OK" << std::endl;
+}
+
+
+inline void Expect(const std::string& Result, const std::string& Expected, 
+                   const char* What)
+{
+  if (Result != Expected)
+    {
+      std::cerr << "got:\n" << Result << "expected:\n" << Expected;
+      throw std::logic_error(std::string("wrong result in ") + What);
+    }
+  std::cerr << What << ": OK" << std::endl;
+}
+
+
+// relative to the size of a, a Tolerance of 0 asks for equality
+inline bool Close(double a, double b, double Tolerance = 1e-12)
+{
+  return std::fabs(a - b) <= Tolerance * (1.0 + std::fabs(a));
+}
+
+
+// vectors with size() and operator()(i), 1 <= i <= size()
+template <class V1, class V2>
+inline void CheckVector(const V1& x, const V2& y, const char* What, 
+                        double Tolerance = 0.0)
+{
+  if (x.size() != y.size())
+    throw std::logic_error(std::string("wrong size in ") + What);
+
+  for (std::size_t i = 1; i != x.size() + 1; ++i)
+    {
+      if (!Close(x(i), y(i), Tolerance))
+        throw std::logic_error(std::string("wrong result in ") + What);
+    }
+  std::cerr << What << ": OK" << std::endl;
+}
+
+
+// matrices with nrows(), ncols() and operator()(i, j), counted from 1
+template <class M1, class M2>
+inline void CheckMatrix(const M1& A, const M2& B, const char* What, 
+                        double Tolerance = 0.0)
+{
+  if (A.nrows() != B.nrows() || A.ncols() != B.ncols())
+    throw std::logic_error(std::string("wrong size in ") + What);
+
+  for (std::size_t i = 1; i != A.nrows() + 1; ++i)
+    {
+      for (std::size_t j = 1; j != A.ncols() + 1; ++j)
+        {
+          if (!Close(A(i, j), B(i, j), Tolerance))
+            throw std::logic_error(std::string("wrong result in ") + What);
+        }
+    }
+  std::cerr << What << ": OK" << std::endl;
+}
+
+
+#endif // DAIXT_DEMO_CHECK_INC
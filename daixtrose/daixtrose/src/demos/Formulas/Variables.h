@@ -0,0 +1,70 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+
+#ifndef DAIXT_DEMO_FORMULAS_VARIABLES_INC
+#define DAIXT_DEMO_FORMULAS_VARIABLES_INC
+
+// the compile-time-numbered variables shared by the demos on formulas, see
+// UsingFeaturesOfExpression.C: Variable<1>, Variable<2>, ... are the 
+// variables 0, 1, ... of the differentiation passes, the tape and the 
+// code generator
+
+#include "daixtrose/Daixt.h"
+#include "daixtrose/LocalDerivatives.h"
+
+#include <cstddef>
+
+
+struct DisambiguatedVariable {};
+
+template <std::size_t Number>
+class Variable
+{
+public:
+  inline Variable() {}
+  typedef DisambiguatedVariable Disambiguation;
+};
+
+typedef Daixt::Scalar<DisambiguatedVariable> S;
+
+
+namespace Daixt
+{
+namespace Differentiation
+{
+template <std::size_t N> struct LeafTraits<Variable<N> >
+{
+  enum { is_variable = true };
+  static inline std::size_t Number(const Variable<N>&) { return N - 1; }
+};
+} // namespace Differentiation
+} // namespace Daixt
+
+
+#endif // DAIXT_DEMO_FORMULAS_VARIABLES_INC
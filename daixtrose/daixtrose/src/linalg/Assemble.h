@@ -0,0 +1,275 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_ASSEMBLE_INC
+#define DAIXT_LINALG_ASSEMBLE_INC
+
+#include "linalg/Matrix.h"
+
+#include "tiny/TinyMatrix.h"
+
+#include "boost/lexical_cast.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Bulk assembly of a Matrix from (row, column, value) triplets. 
+//
+// Setting the entries one by one via operator()(i, j) pays for a map lookup
+// and a ColumnInfo update per entry. Here the triplets are bucket sorted by
+// row, every row is built in one sweep (concurrently with OpenMP) and the
+// column info is computed once at the end.
+//
+// Duplicate triplets are summed up. For a Matrix of TinyQuadraticMatrix<D, N>
+// the triplets address scalar entries and are grouped into N x N blocks.
+
+namespace Linalg
+{
+
+struct Triplet
+{
+  std::size_t Row; // 1-based
+  std::size_t Col; // 1-based
+  double Value;
+};
+
+
+namespace Private
+{
+////////////////////////////////////////////////////////////////////////////////
+// how a scalar triplet maps onto an entry of the matrix 
+
+template <class T> 
+struct AssemblyBlock
+{
+  typedef T ScalarT;
+  enum { Size = 1 };
+
+  static inline T Zero() { return T(0); }
+
+  static inline void Add(T& Entry, std::size_t, std::size_t, double Value)
+  {
+    Entry += static_cast<T>(Value);
+  }
+
+  static inline T Get(const T& Entry, std::size_t, std::size_t)
+  {
+    return Entry;
+  }
+};
+
+
+template <class D, std::size_t N> 
+struct AssemblyBlock<TinyMat::TinyQuadraticMatrix<D, N> >
+{
+  typedef TinyMat::TinyQuadraticMatrix<D, N> BlockT;
+  typedef D ScalarT;
+  enum { Size = N };
+
+  static inline BlockT Zero() { return BlockT(D(0)); }
+
+  static inline void Add(BlockT& Entry, std::size_t i, std::size_t j, 
+                         double Value)
+  {
+    Entry(i, j) += static_cast<D>(Value);
+  }
+
+  static inline D Get(const BlockT& Entry, std::size_t i, std::size_t j)
+  {
+    return Entry(i, j);
+  }
+};
+
+
+template <std::size_t N>
+struct BlockColumnLess
+{
+  inline bool operator()(const Triplet& lhs, const Triplet& rhs) const
+  {
+    return (lhs.Col - 1) / N < (rhs.Col - 1) / N;
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the triplets may come in several chunks (e.g. one per parser thread)
+
+template<class T, class RowStorage, class Allocator>
+void AssembleMatrix(const std::vector<Triplet>* Chunks,
+                    std::size_t NumberOfChunks,
+                    std::size_t nrows,
+                    std::size_t ncols,
+                    Matrix<T, RowStorage, Allocator>& M)
+{
+  typedef AssemblyBlock<T> Block;
+  const std::size_t N = Block::Size;
+
+  if ((nrows % N != 0) || (ncols % N != 0))
+    {
+      throw std::range_error
+        ("Linalg::AssembleMatrix: matrix dimensions " 
+         + boost::lexical_cast<std::string>(nrows) + " x "
+         + boost::lexical_cast<std::string>(ncols) 
+         + " do not fit the block size " 
+         + boost::lexical_cast<std::string>(N));
+    }
+
+  // see Matrix::Matrix(size_t, size_t)
+  if (nrows != ncols)
+    {
+      throw std::range_error
+        ("Linalg::AssembleMatrix: matrix dimensions " 
+         + boost::lexical_cast<std::string>(nrows) + " x "
+         + boost::lexical_cast<std::string>(ncols) 
+         + ", only square matrices are supported");
+    }
+
+  const std::size_t NumberOfBlockRows = nrows / N;
+
+  typedef std::vector<Triplet>::const_iterator const_iterator;
+
+  // bucket sort by block row: count ...
+  std::vector<std::size_t> RowStart(NumberOfBlockRows + 1, 0);
+  for (std::size_t c = 0; c != NumberOfChunks; ++c)
+    {
+      for (const_iterator iter = Chunks[c].begin(); 
+           iter != Chunks[c].end(); ++iter)
+        {
+          if ((iter->Row == 0) || (iter->Row > nrows) || 
+              (iter->Col == 0) || (iter->Col > ncols))
+            {
+              throw std::range_error
+                ("Linalg::AssembleMatrix: index out of range: (" 
+                 + boost::lexical_cast<std::string>(iter->Row) + ", "
+                 + boost::lexical_cast<std::string>(iter->Col) + ")");
+            }
+          ++RowStart[(iter->Row - 1) / N + 1];
+        }
+    }
+
+  for (std::size_t i = 0; i != NumberOfBlockRows; ++i)
+    {
+      RowStart[i + 1] += RowStart[i];
+    }
+
+  // ... and scatter. The input order is kept within each row.
+  std::vector<Triplet> Sorted(RowStart[NumberOfBlockRows]);
+  {
+    std::vector<std::size_t> Position(RowStart.begin(), RowStart.end() - 1);
+    for (std::size_t c = 0; c != NumberOfChunks; ++c)
+      {
+        for (const_iterator iter = Chunks[c].begin(); 
+             iter != Chunks[c].end(); ++iter)
+          {
+            Sorted[Position[(iter->Row - 1) / N]++] = *iter;
+          }
+      }
+  }
+
+  // build the rows 
+  typedef typename Matrix<T, RowStorage, Allocator>::DataStorageT DataStorageT;
+  typedef typename RowStorage::iterator iterator;
+  typedef typename RowStorage::value_type value_type;
+
+  DataStorageT Rows(NumberOfBlockRows);
+
+  ExceptionTrap Trap;
+  const long n = static_cast<long>(NumberOfBlockRows);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (long i = 0; i < n; ++i)
+    {
+      try
+        {
+          std::vector<Triplet>::iterator begin = Sorted.begin() + RowStart[i];
+          std::vector<Triplet>::iterator end = Sorted.begin() + RowStart[i + 1];
+
+          // stable: duplicates are summed up in input order
+          std::stable_sort(begin, end, BlockColumnLess<N>());
+
+          RowStorage& Row = Rows[i];
+          iterator Entry = Row.end();
+
+          for (std::vector<Triplet>::iterator iter = begin; iter != end; ++iter)
+            {
+              const std::size_t j = (iter->Col - 1) / N + 1;
+              
+              if (Entry == Row.end() || Entry->first != j)
+                {
+                  // columns come in ascending order: hinted insertion at the
+                  // end is amortized O(1)
+                  Entry = Row.insert(Row.end(), value_type(j, Block::Zero()));
+                }
+
+              Block::Add(Entry->second, 
+                         (iter->Row - 1) % N + 1, 
+                         (iter->Col - 1) % N + 1, 
+                         iter->Value);
+            }
+        }
+      catch (...) 
+        {
+          Trap.StoreCurrent();
+        }
+    }
+
+  Trap.Rethrow();
+
+  Matrix<T, RowStorage, Allocator> Result(NumberOfBlockRows, ncols / N);
+  Result.SwapRows(Rows);
+  M.swap(Result);
+}
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// user's interface: M is replaced by the assembled nrows x ncols matrix. 
+// nrows and ncols count scalar entries, i.e. a Matrix of blocks ends up with
+// nrows / N block rows.
+
+template<class T, class RowStorage, class Allocator>
+inline void AssembleMatrix(const std::vector<Triplet>& Triplets,
+                           std::size_t nrows,
+                           std::size_t ncols,
+                           Matrix<T, RowStorage, Allocator>& M)
+{
+  Private::AssembleMatrix(&Triplets, 1, nrows, ncols, M);
+}
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_ASSEMBLE_INC
@@ -0,0 +1,1015 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_BINARY_IO_INC
+#define DAIXT_LINALG_BINARY_IO_INC
+
+#include "daixtrose/Daixt.h"
+
+#include "linalg/Disambiguation.h"
+#include "linalg/Matrix.h"
+#include "linalg/Vector.h"
+#include "linalg/RowAndColumCounters.h"
+#include "linalg/RowAndColumExtractors.h"
+
+#include "tiny/TinyMatrix.h"
+#include "tiny/TinyVector.h"
+
+#include "boost/cstdint.hpp"
+#include "boost/lexical_cast.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// mmap is used wherever POSIX is available. Elsewhere (or if DAIXT_NO_MMAP is
+// defined) the file is read into memory in one go.
+#if !defined(DAIXT_NO_MMAP) && \
+    (defined(unix) || defined(__unix) || defined(__unix__) || defined(__APPLE__))
+#define DAIXT_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// A versioned binary format for Matrix and Vector. It is designed to be mapped
+// into memory and used in place: MappedMatrix and MappedVector never parse or
+// copy the data, they just point into the mapping. In expressions the rows of
+// a MappedMatrix are views into the mapping (MappedRow), copied only where the
+// result needs a row of its own, e.g. the left operand of a sum.
+//
+// Layout (native byte order, all offsets multiples of 8):
+//
+//   BinaryHeader                      64 bytes
+//   matrix:
+//     RowPointer   (nrows + 1) x uint64   offsets into ColumnIndex, 0-based
+//     ColumnIndex  nnz x uint64           column of each entry, 0-based
+//     Values       nnz x T                entries, ordered like ColumnIndex
+//   vector:
+//     Values       nrows x T
+//
+// T is float or double (CSR) or TinyQuadraticMatrix<float|double, N> (BSR with
+// N x N blocks stored the fortran way, just like in TinyQuadraticMatrix) or
+// TinyVector<float|double, N> (N values per entry). The header's BlockShape
+// tells square blocks (0, also used for scalars) from vectors (1).
+//
+// Files written on a machine with another byte order are rejected. Sizes and
+// the structure of the index arrays are checked when a file is mapped.
+
+namespace Linalg
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// supported value types. Others do not compile.
+
+template <class T> struct BinaryScalarTraits;
+
+enum { BinarySquareBlock = 0, BinaryVectorBlock = 1 };
+
+template <> 
+struct BinaryScalarTraits<float>
+{
+  typedef float BaseT;
+  enum { Code = 1, BlockSize = 1, BlockShape = BinarySquareBlock, 
+         ValuesPerEntry = 1 };
+};
+
+template <> 
+struct BinaryScalarTraits<double>
+{
+  typedef double BaseT;
+  enum { Code = 2, BlockSize = 1, BlockShape = BinarySquareBlock, 
+         ValuesPerEntry = 1 };
+};
+
+template <class D, std::size_t N> 
+struct BinaryScalarTraits<TinyMat::TinyQuadraticMatrix<D, N> >
+{
+  typedef typename BinaryScalarTraits<D>::BaseT BaseT;
+  enum { Code = BinaryScalarTraits<D>::Code, BlockSize = N, 
+         BlockShape = BinarySquareBlock, ValuesPerEntry = N * N };
+};
+
+template <class D, std::size_t N> 
+struct BinaryScalarTraits<TinyVec::TinyVector<D, N> >
+{
+  typedef typename BinaryScalarTraits<D>::BaseT BaseT;
+  enum { Code = BinaryScalarTraits<D>::Code, BlockSize = N, 
+         BlockShape = BinaryVectorBlock, ValuesPerEntry = N };
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the header of every file
+
+struct BinaryHeader
+{
+  char Magic[8];
+  boost::uint32_t Version;
+  boost::uint32_t ByteOrder;
+  boost::uint32_t Kind;
+  boost::uint32_t ScalarCode;
+  boost::uint64_t BlockSize;
+  boost::uint64_t nrows;
+  boost::uint64_t ncols;
+  boost::uint64_t nnz;
+  boost::uint32_t BlockShape;
+  boost::uint32_t Reserved;
+};
+
+
+namespace Private
+{
+COMPILE_TIME_ASSERT(sizeof(BinaryHeader) == 64);
+
+const char BinaryMagic[8] = "DAIXTLA";
+
+enum 
+{ 
+  BinaryVersion = 1, 
+  BinaryByteOrder = 0x01020304,
+  BinaryMatrixKind = 1, 
+  BinaryVectorKind = 2 
+};
+
+
+template <class T>
+inline BinaryHeader MakeBinaryHeader(boost::uint32_t Kind,
+                                     std::size_t nrows, 
+                                     std::size_t ncols, 
+                                     std::size_t nnz)
+{
+  // the file is used in place, so the values must be stored without padding
+  typedef BinaryScalarTraits<T> Traits;
+  COMPILE_TIME_ASSERT((sizeof(T) == Traits::ValuesPerEntry 
+                       * sizeof(typename Traits::BaseT)));
+
+  BinaryHeader Header;
+  std::memset(&Header, 0, sizeof(Header));
+  std::memcpy(Header.Magic, BinaryMagic, sizeof(Header.Magic));
+  Header.Version = BinaryVersion;
+  Header.ByteOrder = BinaryByteOrder;
+  Header.Kind = Kind;
+  Header.ScalarCode = Traits::Code;
+  Header.BlockSize = Traits::BlockSize;
+  Header.BlockShape = Traits::BlockShape;
+  Header.nrows = nrows;
+  Header.ncols = ncols;
+  Header.nnz = nnz;
+
+  return Header;
+}
+
+
+inline void ThrowBinaryIOError(const char* Where, const std::string& What)
+{
+  throw std::runtime_error(std::string(Where) + ": " + What);
+}
+
+
+// a * b + c. The factors come from the header of a file, which may be
+// corrupt, so the result is checked.
+inline std::size_t CheckedMultiplyAdd(std::size_t a, std::size_t b, 
+                                      std::size_t c, const char* Where)
+{
+  const std::size_t Max = std::numeric_limits<std::size_t>::max();
+  if (b != 0 && a > (Max - c) / b)
+    ThrowBinaryIOError(Where, "sizes in the header are too large");
+  return a * b + c;
+}
+
+
+// a value of the header as std::size_t
+inline std::size_t CheckedSize(boost::uint64_t Value, const char* Where)
+{
+  if (Value > std::numeric_limits<std::size_t>::max())
+    ThrowBinaryIOError(Where, "sizes in the header are too large");
+  return static_cast<std::size_t>(Value);
+}
+
+
+// Checks everything that does not depend on the size of the data section
+template <class T>
+inline const BinaryHeader& CheckBinaryHeader(const char* Data, 
+                                             std::size_t Size,
+                                             boost::uint32_t Kind,
+                                             const char* Where)
+{
+  typedef BinaryScalarTraits<T> Traits;
+
+  if (Size < sizeof(BinaryHeader))
+    ThrowBinaryIOError(Where, "file too short for a header");
+
+  const BinaryHeader& Header = *reinterpret_cast<const BinaryHeader*>(Data);
+
+  if (std::memcmp(Header.Magic, BinaryMagic, sizeof(Header.Magic)) != 0)
+    ThrowBinaryIOError(Where, "not a daixtrose binary file");
+
+  if (Header.ByteOrder != BinaryByteOrder)
+    ThrowBinaryIOError(Where, "file was written with another byte order");
+
+  if (Header.Version != BinaryVersion)
+    ThrowBinaryIOError(Where, "unsupported version " 
+                       + boost::lexical_cast<std::string>(Header.Version));
+
+  if (Header.Kind != Kind)
+    ThrowBinaryIOError(Where, Kind == BinaryMatrixKind ? 
+                       "file does not contain a matrix" :
+                       "file does not contain a vector");
+
+  if (Header.ScalarCode != static_cast<boost::uint32_t>(Traits::Code))
+    ThrowBinaryIOError(Where, "scalar type mismatch");
+
+  if (Header.BlockSize != static_cast<boost::uint64_t>(Traits::BlockSize))
+    ThrowBinaryIOError(Where, "block size mismatch: file has " 
+                       + boost::lexical_cast<std::string>(Header.BlockSize));
+
+  if (Header.BlockShape != static_cast<boost::uint32_t>(Traits::BlockShape))
+    ThrowBinaryIOError(Where, Header.BlockShape == BinaryVectorBlock ? 
+                       "file contains vector blocks" : 
+                       "file contains square blocks");
+
+  return Header;
+}
+
+
+template <class T>
+inline void WriteRaw(std::ostream& os, const T* Data, std::size_t n)
+{
+  os.write(reinterpret_cast<const char*>(Data), 
+           static_cast<std::streamsize>(n * sizeof(T)));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// read-only view of a whole file 
+
+class MappedFile
+{
+public:
+  inline explicit MappedFile(const std::string& FileName);
+  inline ~MappedFile();
+
+  inline const char* data() const { return data_; }
+  inline std::size_t size() const { return size_; }
+
+private:
+  // not copyable
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char* data_;
+  std::size_t size_;
+
+#ifndef DAIXT_HAVE_MMAP
+  // double keeps the alignment of the data section intact
+  std::vector<double> Buffer_;
+#endif
+};
+
+
+#ifdef DAIXT_HAVE_MMAP
+
+MappedFile::MappedFile(const std::string& FileName)
+  : data_(0), size_(0)
+{
+  int fd = ::open(FileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    ThrowBinaryIOError("Linalg::Private::MappedFile", 
+                       "cannot open " + FileName);
+
+  struct stat Status;
+  if (::fstat(fd, &Status) != 0)
+    {
+      ::close(fd);
+      ThrowBinaryIOError("Linalg::Private::MappedFile", 
+                         "cannot stat " + FileName);
+    }
+
+  size_ = static_cast<std::size_t>(Status.st_size);
+
+  if (size_ != 0)
+    {
+      void* Address = ::mmap(0, size_, PROT_READ, MAP_SHARED, fd, 0);
+      if (Address == MAP_FAILED)
+        {
+          ::close(fd);
+          ThrowBinaryIOError("Linalg::Private::MappedFile", 
+                             "cannot map " + FileName);
+        }
+      data_ = static_cast<const char*>(Address);
+    }
+
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+}
+
+
+MappedFile::~MappedFile()
+{
+  if (data_ != 0)
+    {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#else // DAIXT_HAVE_MMAP
+
+MappedFile::MappedFile(const std::string& FileName)
+  : data_(0), size_(0)
+{
+  std::ifstream File(FileName.c_str(), std::ios::in | std::ios::binary);
+  if (!File)
+    ThrowBinaryIOError("Linalg::Private::MappedFile", 
+                       "cannot open " + FileName);
+
+  File.seekg(0, std::ios::end);
+  size_ = static_cast<std::size_t>(File.tellg());
+  File.seekg(0, std::ios::beg);
+
+  Buffer_.resize((size_ + sizeof(double) - 1) / sizeof(double));
+  if (size_ != 0)
+    {
+      File.read(reinterpret_cast<char*>(&Buffer_[0]), 
+                static_cast<std::streamsize>(size_));
+      if (!File)
+        ThrowBinaryIOError("Linalg::Private::MappedFile", 
+                           "cannot read " + FileName);
+      data_ = reinterpret_cast<const char*>(&Buffer_[0]);
+    }
+}
+
+
+MappedFile::~MappedFile()
+{
+}
+
+#endif // DAIXT_HAVE_MMAP
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// writers
+////////////////////////////////////////////////////////////////////////////////
+
+template<class T, class RowStorage, class Allocator>
+void WriteBinary(std::ostream& os, const Matrix<T, RowStorage, Allocator>& M)
+{
+  typedef typename RowStorage::const_iterator const_iterator;
+
+  const std::size_t nrows = M.nrows();
+
+  // pass 1: row pointers
+  std::vector<boost::uint64_t> RowPointer(nrows + 1, 0);
+  for (std::size_t i = 1; i != nrows + 1; ++i)
+    {
+      RowPointer[i] = RowPointer[i - 1] + M(i).size();
+    }
+
+  const BinaryHeader Header = 
+    Private::MakeBinaryHeader<T>(Private::BinaryMatrixKind, 
+                                 nrows, M.ncols(), RowPointer[nrows]);
+  Private::WriteRaw(os, &Header, 1);
+  Private::WriteRaw(os, &RowPointer[0], RowPointer.size());
+
+  // pass 2: column indices, row by row
+  std::vector<boost::uint64_t> ColumnIndex;
+  for (std::size_t i = 1; i != nrows + 1; ++i)
+    {
+      const RowStorage& Row = M(i);
+      ColumnIndex.clear();
+      for (const_iterator iter = Row.begin(); iter != Row.end(); ++iter)
+        {
+          ColumnIndex.push_back(iter->first - 1);
+        }
+      if (!ColumnIndex.empty())
+        Private::WriteRaw(os, &ColumnIndex[0], ColumnIndex.size());
+    }
+
+  // pass 3: values
+  for (std::size_t i = 1; i != nrows + 1; ++i)
+    {
+      const RowStorage& Row = M(i);
+      for (const_iterator iter = Row.begin(); iter != Row.end(); ++iter)
+        {
+          Private::WriteRaw(os, &iter->second, 1);
+        }
+    }
+
+  if (!os)
+    Private::ThrowBinaryIOError("Linalg::WriteBinary", "write error");
+}
+
+
+template<class T, class Allocator>
+void WriteBinary(std::ostream& os, const Vector<T, Allocator>& V)
+{
+  const BinaryHeader Header = 
+    Private::MakeBinaryHeader<T>(Private::BinaryVectorKind, 
+                                 V.size(), 1, V.size());
+  Private::WriteRaw(os, &Header, 1);
+
+  if (V.size() != 0)
+    Private::WriteRaw(os, &V(1), V.size());
+
+  if (!os)
+    Private::ThrowBinaryIOError("Linalg::WriteBinary", "write error");
+}
+
+
+template<class T>
+void WriteBinary(const std::string& FileName, const T& t)
+{
+  std::ofstream File(FileName.c_str(), 
+                     std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!File)
+    Private::ThrowBinaryIOError("Linalg::WriteBinary", 
+                                "cannot open " + FileName);
+
+  WriteBinary(static_cast<std::ostream&>(File), t);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MappedMatrix: a read-only matrix which lives in a file
+////////////////////////////////////////////////////////////////////////////////
+
+// a row of a MappedMatrix where it lies in the file. It iterates like a
+// RowStorage over (column, value) pairs with 1-based columns, and converts
+// to a RowStorage only where a consumer needs its own copy.
+template <class RowStorage, class IndexT>
+class MappedRow
+{
+public:
+  typedef typename RowStorage::mapped_type T;
+  typedef std::pair<std::size_t, T> value_type;
+
+  class const_iterator
+  {
+  public:
+    inline const_iterator(const IndexT* Column, const T* Value) 
+      : Column_(Column), Value_(Value) {}
+
+    inline const value_type& operator*() const 
+    { 
+      Current_ = value_type(*Column_ + 1, *Value_);
+      return Current_; 
+    }
+    inline const value_type* operator->() const { return &**this; }
+
+    inline const_iterator& operator++() 
+    { 
+      ++Column_; 
+      ++Value_; 
+      return *this; 
+    }
+
+    inline bool operator==(const const_iterator& rhs) const 
+    { 
+      return Column_ == rhs.Column_; 
+    }
+    inline bool operator!=(const const_iterator& rhs) const 
+    { 
+      return Column_ != rhs.Column_; 
+    }
+
+  private:
+    const IndexT* Column_;
+    const T* Value_;
+    mutable value_type Current_;
+  };
+
+  inline MappedRow(const IndexT* Column, const T* Value, std::size_t Size)
+    : Column_(Column), Value_(Value), Size_(Size) {}
+
+  inline std::size_t size() const { return Size_; }
+  inline bool empty() const { return Size_ == 0; }
+
+  inline const_iterator begin() const { return const_iterator(Column_, Value_); }
+  inline const_iterator end() const 
+  { 
+    return const_iterator(Column_ + Size_, Value_ + Size_); 
+  }
+
+  inline operator RowStorage() const
+  {
+    typedef typename RowStorage::value_type Pair;
+
+    RowStorage Row;
+    for (std::size_t k = 0; k != Size_; ++k)
+      {
+        // indices are sorted: hinted insertion at the end is amortized O(1)
+        Row.insert(Row.end(), Pair(Column_[k] + 1, Value_[k]));
+      }
+    return Row;
+  }
+
+private:
+  const IndexT* Column_;
+  const T* Value_;
+  std::size_t Size_;
+};
+
+
+// RowStorage and Allocator only determine the disambiguation, i.e. which kind
+// of Matrix the MappedMatrix may be combined with in expressions.
+template <
+          class T,
+          class RowStorage = std::map<std::size_t, 
+                                      T, 
+                                      std::less<std::size_t>,
+                                      std::allocator<std::pair<const std::size_t, T> > >,
+          class Allocator = std::allocator<RowStorage> 
+          >
+class MappedMatrix
+{
+public:
+  typedef MatrixExpression<MatrixDisambiguator<T, RowStorage, Allocator> > 
+  Disambiguation;
+
+  typedef RowStorage RowStorageT;
+  typedef boost::uint64_t IndexT;
+  typedef MappedRow<RowStorage, IndexT> RowViewT;
+
+  inline explicit MappedMatrix(const std::string& FileName);
+
+  inline size_t nrows() const { return nrows_; }
+  inline size_t ncols() const { return ncols_; }
+  inline size_t nnz() const { return nnz_; }
+
+  inline const T& operator()(size_t i, size_t j) const;
+
+  // row i in place, and as a copy
+  inline RowViewT GetRowView(size_t i) const;
+  inline RowStorage GetRow(size_t i) const { return GetRowView(i); }
+
+  // column j as a copy: a binary search in every row
+  inline RowStorage GetColumn(size_t j) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // political incorrect, but this is numerics: direct access to the CSR (BSR)
+  // arrays. Note the 0-based indices.
+  inline const IndexT* RowPointer() const { return RowPointer_; }
+  inline const IndexT* ColumnIndex() const { return ColumnIndex_; }
+  inline const T* Values() const { return Values_; }
+
+private:
+  // not copyable: pass a reference or wrap it into an expression
+  MappedMatrix(const MappedMatrix&);
+  MappedMatrix& operator=(const MappedMatrix&);
+
+  inline void RangeCheck(size_t i, size_t j) const; 
+  inline void CheckStructure() const; 
+
+  Private::MappedFile File_;
+
+  size_t nrows_;
+  size_t ncols_;
+  size_t nnz_;
+
+  const IndexT* RowPointer_;
+  const IndexT* ColumnIndex_;
+  const T* Values_;
+};
+
+
+template <class T, class RowStorage, class Allocator>
+MappedMatrix<T, RowStorage, Allocator>::MappedMatrix(const std::string& FileName)
+  : File_(FileName)
+{
+  const char* Where = "Linalg::MappedMatrix";
+
+  const BinaryHeader& Header = 
+    Private::CheckBinaryHeader<T>(File_.data(), File_.size(), 
+                                  Private::BinaryMatrixKind, Where);
+
+  nrows_ = Private::CheckedSize(Header.nrows, Where);
+  ncols_ = Private::CheckedSize(Header.ncols, Where);
+  nnz_ = Private::CheckedSize(Header.nnz, Where);
+
+  // header + row pointers + column indices + values
+  std::size_t ExpectedSize = 
+    Private::CheckedMultiplyAdd(nrows_, sizeof(IndexT), 
+                                sizeof(BinaryHeader) + sizeof(IndexT), Where);
+  ExpectedSize = 
+    Private::CheckedMultiplyAdd(nnz_, sizeof(IndexT), ExpectedSize, Where);
+  ExpectedSize = 
+    Private::CheckedMultiplyAdd(nnz_, sizeof(T), ExpectedSize, Where);
+
+  if (File_.size() < ExpectedSize)
+    Private::ThrowBinaryIOError(Where, "file is truncated");
+
+  const char* Data = File_.data() + sizeof(BinaryHeader);
+  RowPointer_ = reinterpret_cast<const IndexT*>(Data);
+
+  Data += (nrows_ + 1) * sizeof(IndexT);
+  ColumnIndex_ = reinterpret_cast<const IndexT*>(Data);
+
+  Data += nnz_ * sizeof(IndexT);
+  Values_ = reinterpret_cast<const T*>(Data);
+
+  if (RowPointer_[0] != 0 || RowPointer_[nrows_] != nnz_)
+    Private::ThrowBinaryIOError(Where, "inconsistent row pointers");
+
+  CheckStructure();
+}
+
+
+template <class T, class RowStorage, class Allocator>
+void
+MappedMatrix<T, RowStorage, Allocator>::CheckStructure() const
+{
+  // A corrupt index would make every access go astray, so all of them are
+  // checked once. This reads the index arrays, but not the values.
+
+  // first the row pointers: afterwards none of them exceeds nnz
+  for (size_t i = 0; i != nrows_; ++i)
+    {
+      if (RowPointer_[i] > RowPointer_[i + 1])
+        {
+          Private::ThrowBinaryIOError
+            ("Linalg::MappedMatrix", "row pointers are not monotonic in row " 
+             + boost::lexical_cast<std::string>(i + 1));
+        }
+    }
+
+  for (size_t i = 0; i != nrows_; ++i)
+    {
+      for (IndexT k = RowPointer_[i]; k != RowPointer_[i + 1]; ++k)
+        {
+          if ((ColumnIndex_[k] >= ncols_) || 
+              (k != RowPointer_[i] && ColumnIndex_[k] <= ColumnIndex_[k - 1]))
+            {
+              Private::ThrowBinaryIOError
+                ("Linalg::MappedMatrix", "invalid column indices in row " 
+                 + boost::lexical_cast<std::string>(i + 1));
+            }
+        }
+    }
+}
+
+
+template <class T, class RowStorage, class Allocator>
+void
+MappedMatrix<T, RowStorage, Allocator>::RangeCheck(size_t i, size_t j) const
+{
+#ifndef NDEBUG
+  if ((i > nrows_) || (i == 0))
+    {
+      throw std::range_error
+        (std::string
+         ("MappedMatrix<T, RowStorage, Allocator>::RangeCheck: index i is out of range: ")
+         + boost::lexical_cast<std::string>(i));
+    }
+  
+  if ((j > ncols_) || (j == 0))
+    {
+      throw std::range_error
+        (std::string
+         ("MappedMatrix<T, RowStorage, Allocator>::RangeCheck: index j is out of range: ")
+         + boost::lexical_cast<std::string>(j));
+    }
+#endif
+}
+
+
+template <class T, class RowStorage, class Allocator>
+const T&
+MappedMatrix<T, RowStorage, Allocator>::operator()(size_t i, size_t j) const
+{
+  RangeCheck(i, j);
+
+  const IndexT* begin = ColumnIndex_ + RowPointer_[i - 1];
+  const IndexT* end = ColumnIndex_ + RowPointer_[i];
+  const IndexT* Position = std::lower_bound(begin, end, IndexT(j - 1));
+
+  if (Position != end && *Position == j - 1)
+    {
+      return Values_[Position - ColumnIndex_];
+    }
+
+  // see Matrix::Zero()
+  static const T Zero = T(0); 
+  return Zero;
+}
+
+
+template <class T, class RowStorage, class Allocator>
+typename MappedMatrix<T, RowStorage, Allocator>::RowViewT
+MappedMatrix<T, RowStorage, Allocator>::GetRowView(size_t i) const
+{
+  RangeCheck(i, 1);
+
+  const IndexT Begin = RowPointer_[i - 1];
+  return RowViewT(ColumnIndex_ + Begin, Values_ + Begin, 
+                  static_cast<size_t>(RowPointer_[i] - Begin));
+}
+
+
+template <class T, class RowStorage, class Allocator>
+RowStorage
+MappedMatrix<T, RowStorage, Allocator>::GetColumn(size_t j) const
+{
+  RangeCheck(1, j);
+
+  typedef typename RowStorage::value_type value_type;
+
+  RowStorage Column;
+  for (size_t i = 0; i != nrows_; ++i)
+    {
+      const IndexT* begin = ColumnIndex_ + RowPointer_[i];
+      const IndexT* end = ColumnIndex_ + RowPointer_[i + 1];
+      const IndexT* Position = std::lower_bound(begin, end, IndexT(j - 1));
+
+      if (Position != end && *Position == j - 1)
+        {
+          Column.insert(Column.end(), 
+                        value_type(i + 1, Values_[Position - ColumnIndex_]));
+        }
+    }
+  return Column;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MappedVector: a read-only vector which lives in a file
+////////////////////////////////////////////////////////////////////////////////
+
+template <
+          class T, 
+          class Allocator = std::allocator<T> 
+          >
+class MappedVector
+{
+public:
+  typedef VectorExpression<VectorDisambiguator<T, Allocator> > Disambiguation;
+
+  typedef const T* const_iterator;
+
+  inline explicit MappedVector(const std::string& FileName);
+
+  inline size_t size() const { return size_; }
+
+  inline const T& operator()(size_t i) const;
+
+  inline const_iterator begin() const { return Values_; }
+  inline const_iterator end() const { return Values_ + size_; }
+
+private:
+  // not copyable
+  MappedVector(const MappedVector&);
+  MappedVector& operator=(const MappedVector&);
+
+  Private::MappedFile File_;
+
+  size_t size_;
+  const T* Values_;
+};
+
+
+template <class T, class Allocator>
+MappedVector<T, Allocator>::MappedVector(const std::string& FileName)
+  : File_(FileName)
+{
+  const char* Where = "Linalg::MappedVector";
+
+  const BinaryHeader& Header = 
+    Private::CheckBinaryHeader<T>(File_.data(), File_.size(), 
+                                  Private::BinaryVectorKind, Where);
+
+  size_ = Private::CheckedSize(Header.nrows, Where);
+
+  if (File_.size() < Private::CheckedMultiplyAdd(size_, sizeof(T), 
+                                                 sizeof(BinaryHeader), Where))
+    Private::ThrowBinaryIOError(Where, "file is truncated");
+
+  Values_ = reinterpret_cast<const T*>(File_.data() + sizeof(BinaryHeader));
+}
+
+
+template <class T, class Allocator>
+const T&
+MappedVector<T, Allocator>::operator()(size_t i) const
+{
+#ifndef NDEBUG
+  if ((i > size_) || (i == 0))
+    {
+      throw std::range_error
+        (std::string
+         ("MappedVector<T, Allocator>::operator(): index out of range: ")
+         + boost::lexical_cast<std::string>(i));
+    }
+#endif
+  return Values_[i - 1];
+}
+
+} // namespace Linalg
+
+
+////////////////////////////////////////////////////////////////////////////////
+// never copy a mapped object into an expression, see MatrixVectorOps.h
+
+namespace Daixt 
+{
+
+template <class T, class RowStorage, class Allocator>
+struct CRefOrVal<Linalg::MappedMatrix<T, RowStorage, Allocator> > 
+{
+  typedef Daixt::ConstRef<Linalg::MappedMatrix<T, RowStorage, Allocator> > Type;
+};
+
+template <class T, class Allocator>
+struct CRefOrVal<Linalg::MappedVector<T, Allocator> > 
+{
+  typedef Daixt::ConstRef<Linalg::MappedVector<T, Allocator> > Type;
+};
+
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// mapped objects as leaves of expressions
+////////////////////////////////////////////////////////////////////////////////
+
+namespace Linalg
+{
+
+template<class T>
+struct
+OperatorDelimImpl<RowCounter<MatrixExpression<T> >, 
+                  MappedMatrix<typename T::NumT, 
+                               typename T::RowStorage,
+                               typename T::Allocator> >
+{
+  static inline size_t Apply(const MappedMatrix<typename T::NumT, 
+                                                typename T::RowStorage,
+                                                typename T::Allocator>& arg) 
+  {
+    return arg.nrows();
+  }
+};
+
+
+template<class T>
+struct
+OperatorDelimImpl<ColumnCounter<MatrixExpression<T> >, 
+                  MappedMatrix<typename T::NumT, 
+                               typename T::RowStorage,
+                               typename T::Allocator> >
+{
+  static inline size_t Apply(const MappedMatrix<typename T::NumT, 
+                                                typename T::RowStorage,
+                                                typename T::Allocator>& arg) 
+  {
+    return arg.ncols();
+  }
+};
+
+
+template<class T>
+struct
+OperatorDelimImpl<RowCounter<VectorExpression<T> >, 
+                  MappedVector<typename T::NumT, typename T::Allocator> >
+{
+  static inline 
+  size_t Apply(const MappedVector<typename T::NumT, 
+                                  typename T::Allocator>& V) 
+  {
+    return V.size();
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// rows of a mapped matrix are views into the file, columns are copies
+
+template <class D, class T, class RowStorage, class Allocator>
+struct RowOf<D, MappedMatrix<T, RowStorage, Allocator> >
+{
+  typedef typename MappedMatrix<T, RowStorage, Allocator>::RowViewT Type;
+};
+
+template <class D, class T, class RowStorage, class Allocator>
+struct RowOf<D, Daixt::ConstRef<MappedMatrix<T, RowStorage, Allocator> > >
+{
+  typedef typename MappedMatrix<T, RowStorage, Allocator>::RowViewT Type;
+};
+
+
+template<class T>
+struct
+OperatorDelimImpl<RowExtractor<MatrixExpression<T> >, 
+                  MappedMatrix<typename T::NumT, 
+                               typename T::RowStorage,
+                               typename T::Allocator> >
+{
+  typedef MappedMatrix<typename T::NumT, 
+                       typename T::RowStorage,
+                       typename T::Allocator> MappedT;
+
+  static inline
+  typename MappedT::RowViewT
+  Apply(const MappedT& arg, std::size_t i)
+  {
+    return arg.GetRowView(i);
+  }
+};
+
+
+template<class T>
+struct
+OperatorDelimImpl<RowExtractor<MatrixExpression<T> >, 
+                  Daixt::ConstRef<MappedMatrix<typename T::NumT, 
+                                               typename T::RowStorage,
+                                               typename T::Allocator> > >
+{
+  typedef MappedMatrix<typename T::NumT, 
+                       typename T::RowStorage,
+                       typename T::Allocator> MappedT;
+
+  static inline
+  typename MappedT::RowViewT
+  Apply(const Daixt::ConstRef<MappedT>& arg, std::size_t i)
+  {
+    return static_cast<const MappedT&>(arg).GetRowView(i);
+  }
+};
+
+
+// Transpose asks for columns. Daixt::ConstRef is unwrapped by the generic
+// ColExtractor specialization.
+template<class T>
+struct
+OperatorDelimImpl<ColExtractor<MatrixExpression<T> >, 
+                  MappedMatrix<typename T::NumT, 
+                               typename T::RowStorage,
+                               typename T::Allocator> >
+{
+  static inline
+  typename T::RowStorage
+  Apply(const MappedMatrix<typename T::NumT, 
+                           typename T::RowStorage,
+                           typename T::Allocator>& arg,
+        std::size_t j)
+  {
+    DAIXT_INSTRUMENT_COUNT(column_extractions);
+    return arg.GetColumn(j);
+  }
+};
+
+
+template<class T>
+struct
+OperatorDelimImpl<RowExtractor<VectorExpression<T> >, 
+                  MappedVector<typename T::NumT, typename T::Allocator> >
+{
+  static inline 
+  typename T::NumT
+  Apply(const MappedVector<typename T::NumT, typename T::Allocator>& arg,
+        std::size_t i)
+  {
+    return arg(i);
+  }
+};
+
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_BINARY_IO_INC
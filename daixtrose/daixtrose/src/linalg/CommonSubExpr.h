@@ -0,0 +1,143 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_COMMON_SUB_EXPR_INC
+#define DAIXT_LINALG_COMMON_SUB_EXPR_INC
+
+#include "linalg/Disambiguation.h"
+#include "linalg/TemporaryPool.h"
+
+#include "daixtrose/Daixt.h"
+#include "daixtrose/CommonSubExpr.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// common subexpression elimination for vector assignment
+////////////////////////////////////////////////////////////////////////////////
+
+// In "y = A * x + B * (A * x)" the product A * x is evaluated once into a
+// temporary vector, then "y = Tmp + B * Tmp" is assigned. Only matrix * vector
+// products are worth this effort, everything else is cheap enough to be
+// evaluated row by row.
+
+namespace Linalg
+{
+
+namespace Private
+{
+template <class D> 
+struct IsMatrixExpression { enum { Result = false }; };
+
+template <class T> 
+struct IsMatrixExpression<MatrixExpression<T> > { enum { Result = true }; };
+} // namespace Private
+
+} // namespace Linalg
+
+
+namespace Daixt
+{
+namespace ExprManip
+{
+
+template <class T, class LHS, class RHS>
+struct SharingPolicy<Linalg::VectorExpression<T>, 
+                     Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply> >
+{
+  enum { worth_sharing = 
+         Linalg::Private::IsMatrixExpression<typename 
+                                             disambiguation<LHS>::type>::Result };
+};
+
+} // namespace ExprManip
+} // namespace Daixt
+
+
+namespace Linalg
+{
+
+namespace Private
+{
+
+template <class VectorT, class T>
+inline bool 
+EliminateCommonSubExpr(VectorT& Target, const T& t, 
+                       const Daixt::ExprManip::NoCommonSubExpr* Dummy)
+{
+  return false;
+}
+
+
+template <class VectorT, class T, class S>
+inline bool 
+EliminateCommonSubExpr(VectorT& Target, const T& t, const S* Dummy)
+{
+  using namespace Daixt::ExprManip;
+
+  const S* First = FindFirstSubExpr<S>(t);
+
+  // same type does not mean same objects: "A * x + B * (A * y)"
+  if (CountSameSubExpr(t, *First) != Daixt::StaticOccurrenceCounter<T, S>::Result)
+    {
+      return false;
+    }
+
+  DAIXT_INSTRUMENT_COUNT(vector_temporaries);
+
+  PooledTemporary<VectorT> Tmp;
+  *Tmp = *First; // may eliminate further subexpressions inside *First
+
+  typedef Daixt::ConstRef<VectorT> CRefToTmp;
+  typedef SubExprReplacer<T, S, CRefToTmp> Replacer;
+
+  // delegate to operator= which takes care of the remaining ones
+  Target = Replacer::Apply(t, CRefToTmp(*Tmp)); 
+
+  return true;
+}
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// returns true if the assignment Target = t has been performed, false if there
+// was nothing to eliminate and the caller must do the work
+
+template <class VectorT, class T>
+inline bool EliminateCommonSubExpr(VectorT& Target, const T& t)
+{
+  typedef typename Daixt::ExprManip::CommonSubExprFinder<T>::Result S;
+
+  return Private::EliminateCommonSubExpr(Target, t, static_cast<const S*>(0));
+}
+
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_COMMON_SUB_EXPR_INC
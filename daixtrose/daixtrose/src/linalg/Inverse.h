@@ -112,6 +112,69 @@ OperatorDelimImpl<ColExtractor<MatrixExpression<T> >,
 };
 
 
+template<class ARG>
+struct SingleEntryRows<Daixt::UnOp<Daixt::UnOp<ARG, LumpedMatrix>, 
+                                   InverseOfMatrix> >
+{
+  enum { Result = true };
+};
+
+
+// Inverse(Lump(Lump(A))) is taken care of by the rules in Lump.h, the inverse
+// of a diagonal matrix is diagonal again
+
+// Inverse(Inverse(Lump(A))) = Lump(A)
+template<class ARG>
+struct RewriteRule<Daixt::UnOp<Daixt::UnOp<Daixt::UnOp<ARG, LumpedMatrix>, 
+                                           InverseOfMatrix>,
+                               InverseOfMatrix> >
+{
+  typedef Daixt::UnOp<ARG, LumpedMatrix> type;
+  typedef Daixt::UnOp<type, InverseOfMatrix> Inverted;
+
+  static inline 
+  const type& 
+  Apply(const Daixt::UnOp<Inverted, InverseOfMatrix>& arg)
+  {
+    return arg.arg().arg();
+  }
+};
+
+
+// Transpose(Inverse(Lump(A))) = Inverse(Lump(A))
+template<class ARG>
+struct RewriteRule<Daixt::UnOp<Daixt::UnOp<Daixt::UnOp<ARG, LumpedMatrix>, 
+                                           InverseOfMatrix>,
+                               TransposeOfMatrix> >
+{
+  typedef Daixt::UnOp<Daixt::UnOp<ARG, LumpedMatrix>, InverseOfMatrix> type;
+
+  static inline 
+  const type& 
+  Apply(const Daixt::UnOp<type, TransposeOfMatrix>& arg)
+  {
+    return arg.arg();
+  }
+};
+
+
+// Lump(Inverse(Lump(A))) = Inverse(Lump(A))
+template<class ARG>
+struct RewriteRule<Daixt::UnOp<Daixt::UnOp<Daixt::UnOp<ARG, LumpedMatrix>, 
+                                           InverseOfMatrix>,
+                               LumpedMatrix> >
+{
+  typedef Daixt::UnOp<Daixt::UnOp<ARG, LumpedMatrix>, InverseOfMatrix> type;
+
+  static inline 
+  const type& 
+  Apply(const Daixt::UnOp<type, LumpedMatrix>& arg)
+  {
+    return arg.arg();
+  }
+};
+
+
 } // namespace Linalg
 
 
@@ -44,8 +44,15 @@
 #include "linalg/SliceVector.h"
 
 #include "linalg/PrintBlockedMatrix.h"
+#include "linalg/PrintSparseMatrix.h"
 #include "linalg/L2_Norm.h"
 #include "linalg/Inverse.h"
+#include "linalg/CommonSubExpr.h"
+#include "linalg/NestedProducts.h"
+#include "linalg/PoolAllocator.h"
+#include "linalg/BinaryIO.h"
+#include "linalg/MatrixMarket.h"
+#include "linalg/PatternCache.h"
 
 
 
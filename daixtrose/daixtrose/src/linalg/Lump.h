@@ -34,6 +34,9 @@
 #include "linalg/RowAndColumExtractors.h"
 #include "linalg/Disambiguation.h"
 #include "linalg/Matrix.h"
+#include "linalg/NestedProducts.h"
+#include "linalg/RewriteRules.h"
+#include "linalg/Transpose.h"
 
 
 namespace Linalg
@@ -103,6 +106,45 @@ OperatorDelimImpl<ColExtractor<MatrixExpression<T> >,
 };
 
 
+// "Lump(M) * (A * x)" needs each row of A * x only once
+template<class ARG>
+struct SingleEntryRows<Daixt::UnOp<ARG, LumpedMatrix> >
+{
+  enum { Result = true };
+};
+
+
+// Lump(Lump(A)) = Lump(A)
+template<class ARG>
+struct RewriteRule<Daixt::UnOp<Daixt::UnOp<ARG, LumpedMatrix>, LumpedMatrix> >
+{
+  typedef Daixt::UnOp<ARG, LumpedMatrix> type;
+
+  static inline 
+  const type& 
+  Apply(const Daixt::UnOp<type, LumpedMatrix>& arg)
+  {
+    return arg.arg();
+  }
+};
+
+
+// a lumped matrix is diagonal: Transpose(Lump(A)) = Lump(A)
+template<class ARG>
+struct RewriteRule<Daixt::UnOp<Daixt::UnOp<ARG, LumpedMatrix>, 
+                               TransposeOfMatrix> >
+{
+  typedef Daixt::UnOp<ARG, LumpedMatrix> type;
+
+  static inline 
+  const type& 
+  Apply(const Daixt::UnOp<type, TransposeOfMatrix>& arg)
+  {
+    return arg.arg();
+  }
+};
+
+
 } // namespace Linalg
 
 
@@ -31,10 +31,13 @@
 
 
 #include "daixtrose/Daixt.h"
+#include "daixtrose/ExceptionTrap.h"
 
 #include "linalg/RowAndColumCounters.h"
 #include "linalg/RowAndColumExtractors.h"
 #include "linalg/Disambiguation.h"
+#include "linalg/PoolAllocator.h"
+#include "linalg/RewriteRules.h"
 
 
 #include "boost/lambda/lambda.hpp"
@@ -54,6 +57,11 @@
 
 #include <iosfwd>
 #include <iomanip>
+#include <string>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -89,6 +97,9 @@ struct select1st
   }
 };
 
+
+using Daixt::Private::ExceptionTrap;
+
 } // namespace Private
 
 
@@ -190,8 +201,16 @@ public:
   template <class Val>
   inline void SetEntriesInColTo(size_t i, Val val);
 
+  // Row is a sink: pass a temporary and it will be swapped in without a copy
   inline void ReplaceRow(size_t i, RowStorage Row); 
 
+  // exchange row i with Row (which then holds the old row)
+  inline void SwapRow(size_t i, RowStorage& Row); 
+
+  // bulk version: exchange all rows at once. Rows must hold nrows() rows, the
+  // column info is rebuilt in one go.
+  inline void SwapRows(DataStorageT& Rows); 
+
   // yes, sometimes we cannot avoid access to columns
   inline RowStorage GetColumn(size_t j) const;
 
@@ -216,10 +235,22 @@ private:
 
   ColumnInfoStorage ColumnInfo_;
 
+  // the short-lived index vectors used while updating ColumnInfo_ 
+  typedef std::vector<size_t, PoolAllocator<size_t> > KeyStorage;
+
   inline void UpdateColumnInfo(size_t row_index, 
                                const RowStorage& OldRow,
                                const RowStorage& NewRow);
 
+  // evaluate all rows of Other into data_ (concurrently if OpenMP is enabled)
+  // and rebuild ColumnInfo_
+  template<class OtherT> 
+  inline void EvaluateRows(const OtherT& Other);
+
+  // rebuild ColumnInfo_ from scratch via a counting sort. The row indices of
+  // each column are sorted, whatever the number of threads.
+  inline void RebuildColumnInfo();
+
 };
 
 
@@ -272,15 +303,12 @@ Matrix(const OtherT& Other)
   data_(),
   ColumnInfo_(ncols_) // must be initialized
 {
-  data_.reserve(nrows_);
-
-  RowStorage Empty;
-
-  for (size_t i = 1; i != nrows_ + 1; ++i)
+  if (ApplyRewriteRules(*this, Daixt::unwrap_expr(Other)))
     {
-      data_.push_back(RowExtractor<Disambiguation>(i)(Other));
-      UpdateColumnInfo(i, Empty, data_[i-1]);
+      return;
     }
+
+  EvaluateRows(Other);
 }
 
 
@@ -334,52 +362,27 @@ operator=(const OtherT& Other)
   // The check for whether we need a temporary could be refined: if *this does
   // not occur on the rhs of a multiplication, the temporary might not be
   // required.
+  DAIXT_INSTRUMENT_SCOPE(OtherT);
+
+  if (ApplyRewriteRules(*this, Daixt::unwrap_expr(Other)))
+    {
+      return *this;
+    }
+
   if (Daixt::CountOccurrence(Other, *this)) // must use a temporary
     {
-      size_t nrows = NumberOfRows(Other);
-      size_t ncols = NumberOfCols(Other);
+      DAIXT_INSTRUMENT_COUNT(aliasing_temporaries);
 
-      MyOwnType Tmp(nrows, ncols);
-      
-      for (size_t i = 1; i != nrows_ + 1; ++i)
-        {
-          Tmp.ReplaceRow(i, RowExtractor<Disambiguation>(i)(Other));
-        }
-      
+      MyOwnType Tmp(Other);
       this->swap(Tmp);
     }
   else // Not so many temporaries needed
     {
-      size_t nrows = NumberOfRows(Other);
-      size_t ncols = NumberOfCols(Other);
+      nrows_ = NumberOfRows(Other);
+      ncols_ = NumberOfCols(Other);
 
-      // tabula rasa when sizes do not fit
-      if ((nrows_ != nrows) || (ncols_ != ncols))
-        {
-          nrows_ = nrows;
-          ncols_ = ncols;
-
-          std::for_each(ColumnInfo_.begin(), ColumnInfo_.end(),
-                        std::mem_fun_ref(&IndexStorage::clear));
-          
-          ColumnInfo_.resize(nrows_); 
-          
-          std::for_each(data_.begin(), data_.end(),
-                        std::mem_fun_ref(&RowStorage::clear));
-          
-          data_.resize(nrows_);
-        }
-
-      // assing row by row
-      for (size_t i = 1; i != nrows_ + 1; ++i)
-        {
-          RowStorage& ActualRow = data_[i-1];
-          
-          RowStorage NewRow = RowExtractor<Disambiguation>(i)(Other);
-          
-          UpdateColumnInfo(i, ActualRow, NewRow);
-          ActualRow.swap(NewRow);
-        }
+      // the old rows are replaced one by one
+      EvaluateRows(Other);
     }
   
   return *this;
@@ -421,7 +424,8 @@ operator+=(const OtherT& Other)
     {
       for (size_t i = 1; i != nrows_ + 1; ++i)
         {
-          RowStorage Row = RowExtractor<Disambiguation>(i)(Other);
+          // read only: bind to the result, do not copy rows of matrices
+          const RowStorage& Row = RowExtractor<Disambiguation>(i)(Other);
           RowStorage& MyRow = data_[i-1];
 
           // merge Row with MyRow
@@ -619,6 +623,46 @@ ReplaceRow(size_t i, RowStorage Row)
 }
 
 
+template<class T, class RowStorage, class Allocator>
+void 
+Matrix<T, RowStorage, Allocator>::
+SwapRow(size_t i, RowStorage& Row)
+{
+  RangeCheck(i, 1);
+  UpdateColumnInfo(i, data_[i-1], Row);
+  data_[i-1].swap(Row);
+}
+
+
+template<class T, class RowStorage, class Allocator>
+void 
+Matrix<T, RowStorage, Allocator>::
+SwapRows(DataStorageT& Rows)
+{
+  if (Rows.size() != nrows_)
+    {
+      throw std::range_error
+        (std::string
+         ("Matrix<T, RowStorage, Allocator>::SwapRows: wrong number of rows: ")
+         + boost::lexical_cast<std::string>(Rows.size()));
+    }
+
+#ifndef NDEBUG
+  for (size_t i = 0; i != nrows_; ++i)
+    {
+      if (!Rows[i].empty())
+        {
+          RangeCheck(i + 1, Rows[i].begin()->first);
+          RangeCheck(i + 1, Rows[i].rbegin()->first);
+        }
+    }
+#endif
+
+  data_.swap(Rows);
+  RebuildColumnInfo();
+}
+
+
 template<class T, class RowStorage, class Allocator>
 std::vector<size_t> 
 Matrix<T, RowStorage, Allocator>::
@@ -716,6 +760,147 @@ Zero() const
 }
 
 
+template<class T, class RowStorage, class Allocator>
+template<class OtherT>
+void 
+Matrix<T, RowStorage, Allocator>::
+EvaluateRows(const OtherT& Other)
+{
+  DAIXT_PROFILE_SCOPE(OtherT);
+
+  // construct the rows in place and swap the results in: push_back would copy
+  // each row and would force us to work serially
+  data_.resize(nrows_);
+
+  DAIXT_INSTRUMENT_SCOPE(OtherT);
+  DAIXT_INSTRUMENT_COUNT(assignments);
+  DAIXT_INSTRUMENT_CAPTURE;
+  DAIXT_PROFILE_CAPTURE;
+
+  Private::ExceptionTrap Trap;
+
+  // OpenMP wants a signed loop index
+  const long n = static_cast<long>(nrows_);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (long i = 0; i < n; ++i)
+    {
+      DAIXT_INSTRUMENT_ENTER_CAPTURED;
+      DAIXT_PROFILE_ENTER_CAPTURED;
+
+      try 
+        {
+          RowStorage Row = RowExtractor<Disambiguation>(i + 1)(Other);
+          data_[i].swap(Row);
+        }
+      catch (...) 
+        {
+          Trap.StoreCurrent();
+        }
+    }
+
+  Trap.Rethrow();
+
+  // rows and entries are counted by the RowExtractor
+#ifdef DAIXT_ENABLE_PROFILER
+  size_t NumberOfEntries = 0;
+  for (size_t i = 0; i != nrows_; ++i)
+    {
+      NumberOfEntries += data_[i].size();
+    }
+  DAIXT_PROFILE_ENTRIES(NumberOfEntries, 
+                        sizeof(typename RowStorage::value_type));
+#endif
+
+  // inside the profile scope
+  RebuildColumnInfo();
+}
+
+
+template<class T, class RowStorage, class Allocator>
+void 
+Matrix<T, RowStorage, Allocator>::
+RebuildColumnInfo()
+{
+  // The rows are cut into contiguous blocks, one per thread. Each block counts
+  // its entries per column, the counts are turned into offsets (block by
+  // block, so lower rows come first) and finally every block writes its row
+  // indices into its own slots.
+
+#ifdef _OPENMP
+  const long NumberOfBlocks = omp_get_max_threads();
+#else
+  const long NumberOfBlocks = 1;
+#endif
+
+  const long n = static_cast<long>(nrows_);
+  const long m = static_cast<long>(ncols_);
+  const long BlockSize = (n + NumberOfBlocks - 1) / NumberOfBlocks;
+
+  std::vector<IndexStorage> Offsets(NumberOfBlocks, IndexStorage(ncols_, 0));
+  ColumnInfoStorage Result(ncols_);
+
+  typedef typename RowStorage::const_iterator const_iterator;
+
+  // count
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+  for (long b = 0; b < NumberOfBlocks; ++b)
+    {
+      IndexStorage& Counts = Offsets[b];
+      const long end = std::min(n, (b + 1) * BlockSize);
+      for (long i = b * BlockSize; i < end; ++i)
+        {
+          const_iterator rowend = data_[i].end();
+          for (const_iterator iter = data_[i].begin(); iter != rowend; ++iter)
+            {
+              ++Counts[iter->first - 1];
+            }
+        }
+    }
+
+  // exclusive prefix sum over the blocks
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (long j = 0; j < m; ++j)
+    {
+      size_t Sum = 0;
+      for (long b = 0; b < NumberOfBlocks; ++b)
+        {
+          size_t Count = Offsets[b][j];
+          Offsets[b][j] = Sum;
+          Sum += Count;
+        }
+      Result[j].resize(Sum);
+    }
+
+  // scatter
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+  for (long b = 0; b < NumberOfBlocks; ++b)
+    {
+      IndexStorage& Position = Offsets[b];
+      const long end = std::min(n, (b + 1) * BlockSize);
+      for (long i = b * BlockSize; i < end; ++i)
+        {
+          const_iterator rowend = data_[i].end();
+          for (const_iterator iter = data_[i].begin(); iter != rowend; ++iter)
+            {
+              const size_t j = iter->first - 1;
+              Result[j][Position[j]++] = i + 1;
+            }
+        }
+    }
+
+  ColumnInfo_.swap(Result);
+}
+
+
 template<class T, class RowStorage, class Allocator>
 void 
 Matrix<T, RowStorage, Allocator>::
@@ -723,7 +908,7 @@ UpdateColumnInfo(size_t row_index,
                  const RowStorage& OldRow,
                  const RowStorage& NewRow)
 {
-  IndexStorage OldKeys, NewKeys;
+  KeyStorage OldKeys, NewKeys;
   
   OldKeys.reserve(OldRow.size());
   NewKeys.reserve(NewRow.size());
@@ -743,7 +928,7 @@ UpdateColumnInfo(size_t row_index,
   std::sort(NewKeys.begin(), NewKeys.end());
 
 
-  IndexStorage ToErase, ToAdd;
+  KeyStorage ToErase, ToAdd;
 
   std::set_difference(OldKeys.begin(), OldKeys.end(),
                       NewKeys.begin(), NewKeys.end(),
@@ -754,7 +939,7 @@ UpdateColumnInfo(size_t row_index,
                       std::back_inserter(ToAdd));
 
   
-  typedef typename IndexStorage::iterator iterator;
+  typedef typename KeyStorage::iterator iterator;
 
 
   // erase the removed entries
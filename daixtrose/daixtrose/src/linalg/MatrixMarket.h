@@ -0,0 +1,586 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_MATRIX_MARKET_INC
+#define DAIXT_LINALG_MATRIX_MARKET_INC
+
+#include "linalg/Matrix.h"
+#include "linalg/Assemble.h"
+#include "linalg/BinaryIO.h"
+#include "linalg/OutputBuffer.h"
+
+#include "boost/cstdint.hpp"
+#include "boost/lexical_cast.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <clocale>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Matrix Market (.mtx) import and export. 
+//
+// Supported: "matrix coordinate" with field real, double, integer or pattern
+// and symmetry general, symmetric or skew-symmetric.  Complex and hermitian
+// matrices as well as the dense "array" format are rejected.
+//
+// The reader maps the file, cuts the entries into chunks at line boundaries,
+// parses the chunks concurrently (with OpenMP) and hands the triplets over to
+// AssembleMatrix (see linalg/Assemble.h), which also groups them into blocks
+// for a Matrix of TinyQuadraticMatrix<D, N>.
+
+namespace Linalg
+{
+
+namespace Private
+{
+
+inline bool IsBlank(char c)
+{
+  return (c == ' ') || (c == '\t') || (c == '\r');
+}
+
+
+inline bool IsEndOfToken(const char* p, const char* end)
+{
+  return (p == end) || IsBlank(*p) || (*p == '\n');
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Parses an unsigned integer. Returns the position after it or 0 on failure.
+
+inline const char* ParseIndex(const char* p, const char* end, std::size_t& Result)
+{
+  const char* begin = p;
+  Result = 0;
+  while ((p != end) && (*p >= '0') && (*p <= '9'))
+    {
+      Result = 10 * Result + (*p - '0');
+      ++p;
+    }
+  return (p == begin || !IsEndOfToken(p, end)) ? 0 : p;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Parses a real number. Returns the position after it or 0 on failure.
+//
+// Clinger's fast path: if the decimal mantissa fits into 53 bits and the
+// decimal exponent is at most 22 in magnitude, both are exactly representable
+// as doubles and one correctly rounded multiplication or division yields the
+// correctly rounded result. Everything else (long mantissas, large exponents,
+// inf, nan, ...) is left to strtod. Files always use '.' as decimal point, 
+// whatever the current C locale says.
+
+inline const char* ParseReal(const char* p, const char* end, double& Result)
+{
+  static const double PowersOfTen[] = 
+    {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+  const char* begin = p;
+
+  bool Negative = false;
+  if ((p != end) && ((*p == '-') || (*p == '+')))
+    {
+      Negative = (*p == '-');
+      ++p;
+    }
+
+  boost::uint64_t Mantissa = 0;
+  int NumberOfDigits = 0;  // significant ones
+  int Exponent = 0;
+  bool AnyDigit = false;
+  bool Exact = true;
+
+  for (; (p != end) && (*p >= '0') && (*p <= '9'); ++p)
+    {
+      AnyDigit = true;
+      if (NumberOfDigits < 19)
+        {
+          Mantissa = 10 * Mantissa + (*p - '0');
+          if (Mantissa != 0) ++NumberOfDigits;
+        }
+      else 
+        {
+          Exact = false;
+        }
+    }
+
+  if ((p != end) && (*p == '.'))
+    {
+      for (++p; (p != end) && (*p >= '0') && (*p <= '9'); ++p)
+        {
+          AnyDigit = true;
+          if (NumberOfDigits < 19)
+            {
+              Mantissa = 10 * Mantissa + (*p - '0');
+              if (Mantissa != 0) ++NumberOfDigits;
+              --Exponent;
+            }
+          else 
+            {
+              Exact = false;
+            }
+        }
+    }
+
+  if (AnyDigit && (p != end) && ((*p == 'e') || (*p == 'E')))
+    {
+      ++p;
+      bool NegativeExponent = false;
+      if ((p != end) && ((*p == '-') || (*p == '+')))
+        {
+          NegativeExponent = (*p == '-');
+          ++p;
+        }
+
+      const char* ExponentBegin = p;
+      int ExplicitExponent = 0;
+      for (; (p != end) && (*p >= '0') && (*p <= '9'); ++p)
+        {
+          if (ExplicitExponent < 100000) 
+            ExplicitExponent = 10 * ExplicitExponent + (*p - '0');
+        }
+      if (p == ExponentBegin) AnyDigit = false;
+
+      Exponent += NegativeExponent ? -ExplicitExponent : ExplicitExponent;
+    }
+
+  if (AnyDigit && Exact && IsEndOfToken(p, end) &&
+      (Mantissa <= (boost::uint64_t(1) << 53)) &&
+      (Exponent >= -22) && (Exponent <= 22))
+    {
+      double Value = static_cast<double>(Mantissa);
+      Value = (Exponent < 0) ? 
+        Value / PowersOfTen[-Exponent] : 
+        Value * PowersOfTen[Exponent];
+      Result = Negative ? -Value : Value;
+      return p;
+    }
+
+  // slow path: strtod needs a terminated copy of the token
+  p = begin;
+  while (!IsEndOfToken(p, end)) ++p;
+
+  char Token[128];
+  const std::size_t Length = p - begin;
+  if ((Length == 0) || (Length >= sizeof(Token)))
+    return 0;
+
+  std::copy(begin, p, Token);
+  Token[Length] = '\0';
+
+  // strtod follows LC_NUMERIC
+  const char Point = *std::localeconv()->decimal_point;
+  if (Point != '.')
+    std::replace(Token, Token + Length, '.', Point);
+
+  char* TokenEnd = 0;
+  Result = std::strtod(Token, &TokenEnd);
+
+  return (TokenEnd == Token + Length) ? p : 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// header
+
+struct MatrixMarketHeader
+{
+  enum Symmetry { general, symmetric, skew_symmetric };
+
+  bool Pattern;
+  Symmetry Kind;
+  std::size_t nrows;
+  std::size_t ncols;
+  std::size_t nnz;
+
+  const char* Body; // the first entry starts here
+};
+
+
+inline const char* NextLine(const char* p, const char* end)
+{
+  p = std::find(p, end, '\n');
+  return (p == end) ? end : p + 1;
+}
+
+
+inline void ThrowMatrixMarketError(const std::string& What)
+{
+  throw std::runtime_error("Linalg::ReadMatrixMarket: " + What);
+}
+
+
+inline MatrixMarketHeader ParseMatrixMarketHeader(const char* p, 
+                                                  const char* end)
+{
+  MatrixMarketHeader Header;
+
+  // banner, case does not matter
+  const char* LineEnd = std::find(p, end, '\n');
+  std::string Banner(p, LineEnd);
+  for (std::string::iterator iter = Banner.begin(); iter != Banner.end(); ++iter)
+    {
+      *iter = static_cast<char>(std::tolower(static_cast<unsigned char>(*iter)));
+    }
+
+  std::vector<std::string> Words;
+  {
+    std::string::size_type pos = 0;
+    while ((pos = Banner.find_first_not_of(" \t\r", pos)) != std::string::npos)
+      {
+        std::string::size_type WordEnd = Banner.find_first_of(" \t\r", pos);
+        Words.push_back(Banner.substr(pos, WordEnd - pos));
+        pos = WordEnd;
+      }
+  }
+
+  if (Words.size() != 5 || Words[0] != "%%matrixmarket" || Words[1] != "matrix")
+    ThrowMatrixMarketError("missing or malformed %%MatrixMarket banner");
+
+  if (Words[2] != "coordinate")
+    ThrowMatrixMarketError("unsupported format: " + Words[2]);
+
+  if (Words[3] == "pattern")
+    Header.Pattern = true;
+  else if (Words[3] == "real" || Words[3] == "double" || Words[3] == "integer")
+    Header.Pattern = false;
+  else 
+    ThrowMatrixMarketError("unsupported field: " + Words[3]);
+
+  if (Words[4] == "general")
+    Header.Kind = MatrixMarketHeader::general;
+  else if (Words[4] == "symmetric")
+    Header.Kind = MatrixMarketHeader::symmetric;
+  else if (Words[4] == "skew-symmetric")
+    Header.Kind = MatrixMarketHeader::skew_symmetric;
+  else 
+    ThrowMatrixMarketError("unsupported symmetry: " + Words[4]);
+
+  // comments and empty lines up to the size line
+  p = NextLine(p, end);
+  for (;;)
+    {
+      while ((p != end) && IsBlank(*p)) ++p;
+      if (p == end)
+        ThrowMatrixMarketError("missing size line");
+      if ((*p == '%') || (*p == '\n'))
+        {
+          p = NextLine(p, end);
+          continue;
+        }
+      break;
+    }
+
+  std::size_t* Sizes[3] = { &Header.nrows, &Header.ncols, &Header.nnz };
+  for (std::size_t k = 0; k != 3; ++k)
+    {
+      while ((p != end) && IsBlank(*p)) ++p;
+      p = ParseIndex(p, end, *Sizes[k]);
+      if (p == 0)
+        ThrowMatrixMarketError("malformed size line");
+    }
+
+  Header.Body = NextLine(p, end);
+  return Header;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// one chunk of entries: [p, end) starts at a line boundary
+
+inline void ParseMatrixMarketChunk(const char* p, 
+                                   const char* end,
+                                   const MatrixMarketHeader& Header,
+                                   std::vector<Triplet>& Result,
+                                   std::size_t& NumberOfEntries)
+{
+  NumberOfEntries = 0;
+
+  while (p != end)
+    {
+      while ((p != end) && IsBlank(*p)) ++p;
+
+      if (p == end) 
+        break;
+
+      if ((*p == '\n') || (*p == '%'))
+        {
+          p = NextLine(p, end);
+          continue;
+        }
+
+      const char* LineBegin = p;
+
+      Triplet Entry;
+      Entry.Value = 1.0;
+
+      p = ParseIndex(p, end, Entry.Row);
+      if (p != 0)
+        {
+          while ((p != end) && IsBlank(*p)) ++p;
+          p = ParseIndex(p, end, Entry.Col);
+        }
+      if ((p != 0) && !Header.Pattern)
+        {
+          while ((p != end) && IsBlank(*p)) ++p;
+          p = ParseReal(p, end, Entry.Value);
+        }
+
+      if (p == 0)
+        {
+          ThrowMatrixMarketError
+            ("malformed entry: '" 
+             + std::string(LineBegin, std::find(LineBegin, end, '\n')) + "'");
+        }
+
+      if ((Entry.Row == 0) || (Entry.Row > Header.nrows) || 
+          (Entry.Col == 0) || (Entry.Col > Header.ncols))
+        {
+          throw std::range_error
+            ("Linalg::ReadMatrixMarket: index out of range: (" 
+             + boost::lexical_cast<std::string>(Entry.Row) + ", "
+             + boost::lexical_cast<std::string>(Entry.Col) + ")");
+        }
+
+      Result.push_back(Entry);
+      ++NumberOfEntries;
+
+      if ((Header.Kind != MatrixMarketHeader::general) && 
+          (Entry.Row != Entry.Col))
+        {
+          std::swap(Entry.Row, Entry.Col);
+          if (Header.Kind == MatrixMarketHeader::skew_symmetric)
+            Entry.Value = -Entry.Value;
+          Result.push_back(Entry);
+        }
+
+      p = NextLine(p, end);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// whole file in memory: [begin, end)
+
+template<class T, class RowStorage, class Allocator>
+void ReadMatrixMarket(const char* begin, 
+                      const char* end,
+                      Matrix<T, RowStorage, Allocator>& M)
+{
+  const MatrixMarketHeader Header = ParseMatrixMarketHeader(begin, end);
+
+  // see Matrix::Matrix(size_t, size_t)
+  if (Header.nrows != Header.ncols)
+    {
+      throw std::range_error
+        ("Linalg::ReadMatrixMarket: the file contains a " 
+         + boost::lexical_cast<std::string>(Header.nrows) + " x "
+         + boost::lexical_cast<std::string>(Header.ncols) 
+         + " matrix, only square matrices are supported");
+    }
+
+  // chunks of at least 1 MB, a few per thread for load balancing
+  const std::size_t Length = end - Header.Body;
+  std::size_t NumberOfChunks = 1;
+#ifdef _OPENMP
+  NumberOfChunks = 
+    std::min(Length / (1 << 20) + 1, 
+             4 * static_cast<std::size_t>(omp_get_max_threads()));
+#endif
+
+  std::vector<const char*> Bounds(NumberOfChunks + 1, end);
+  Bounds[0] = Header.Body;
+  for (std::size_t k = 1; k != NumberOfChunks; ++k)
+    {
+      const char* p = Header.Body + k * (Length / NumberOfChunks);
+      Bounds[k] = std::max(Bounds[k - 1], NextLine(p - 1, end));
+    }
+
+  std::vector<std::vector<Triplet> > Chunks(NumberOfChunks);
+  std::vector<std::size_t> NumberOfEntries(NumberOfChunks, 0);
+
+  // rough guess: 20 characters per entry
+  const std::size_t Guess = 
+    (Header.Kind == MatrixMarketHeader::general ? 1 : 2) * Length / 20;
+
+  ExceptionTrap Trap;
+  const long n = static_cast<long>(NumberOfChunks);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (long k = 0; k < n; ++k)
+    {
+      try
+        {
+          Chunks[k].reserve(Guess / NumberOfChunks + 1);
+          ParseMatrixMarketChunk(Bounds[k], Bounds[k + 1], Header,
+                                 Chunks[k], NumberOfEntries[k]);
+        }
+      catch (...) 
+        {
+          Trap.StoreCurrent();
+        }
+    }
+
+  Trap.Rethrow();
+
+  std::size_t Total = 0;
+  for (std::size_t k = 0; k != NumberOfChunks; ++k)
+    {
+      Total += NumberOfEntries[k];
+    }
+
+  if (Total != Header.nnz)
+    {
+      ThrowMatrixMarketError
+        ("expected " + boost::lexical_cast<std::string>(Header.nnz) 
+         + " entries, found " + boost::lexical_cast<std::string>(Total));
+    }
+
+  AssembleMatrix(&Chunks[0], NumberOfChunks, Header.nrows, Header.ncols, M);
+}
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// user's interface
+////////////////////////////////////////////////////////////////////////////////
+
+// M is replaced by the matrix in the file
+template<class T, class RowStorage, class Allocator>
+void ReadMatrixMarket(const std::string& FileName,
+                      Matrix<T, RowStorage, Allocator>& M)
+{
+  Private::MappedFile File(FileName);
+  Private::ReadMatrixMarket(File.data(), File.data() + File.size(), M);
+}
+
+
+template<class T, class RowStorage, class Allocator>
+void ReadMatrixMarket(std::istream& is,
+                      Matrix<T, RowStorage, Allocator>& M)
+{
+  std::string Content((std::istreambuf_iterator<char>(is)), 
+                      std::istreambuf_iterator<char>());
+  Private::ReadMatrixMarket(Content.data(), Content.data() + Content.size(), M);
+}
+
+
+// always "coordinate real general". Blocks are written entry by entry.
+template<class T, class RowStorage, class Allocator>
+void WriteMatrixMarket(std::ostream& os,
+                       const Matrix<T, RowStorage, Allocator>& M)
+{
+  typedef Private::AssemblyBlock<T> Block;
+  typedef typename Block::ScalarT ScalarT;
+  typedef typename RowStorage::const_iterator const_iterator;
+
+  const std::size_t N = Block::Size;
+
+  // enough digits to read back the very same value
+  const int Precision = std::numeric_limits<ScalarT>::digits * 30103 / 100000 + 2;
+
+  std::size_t nnz = 0;
+  for (std::size_t i = 1; i != M.nrows() + 1; ++i)
+    {
+      nnz += M(i).size();
+    }
+
+  OutputBuffer Out(os);
+
+  Out.Put("%%MatrixMarket matrix coordinate real general\n");
+  Out.PutUnsigned(M.nrows() * N);
+  Out.Put(' ');
+  Out.PutUnsigned(M.ncols() * N);
+  Out.Put(' ');
+  Out.PutUnsigned(nnz * N * N);
+  Out.Put('\n');
+
+  for (std::size_t i = 1; i != M.nrows() + 1; ++i)
+    {
+      const RowStorage& Row = M(i);
+      for (const_iterator iter = Row.begin(); iter != Row.end(); ++iter)
+        {
+          for (std::size_t k = 1; k != N + 1; ++k)
+            {
+              for (std::size_t l = 1; l != N + 1; ++l)
+                {
+                  Out.PutUnsigned((i - 1) * N + k);
+                  Out.Put(' ');
+                  Out.PutUnsigned((iter->first - 1) * N + l);
+                  Out.Put(' ');
+                  Out.PutReal(Block::Get(iter->second, k, l), Precision);
+                  Out.Put('\n');
+                }
+            }
+        }
+    }
+
+  Out.Flush();
+
+  if (!os)
+    throw std::runtime_error("Linalg::WriteMatrixMarket: write error");
+}
+
+
+template<class T, class RowStorage, class Allocator>
+void WriteMatrixMarket(const std::string& FileName,
+                       const Matrix<T, RowStorage, Allocator>& M)
+{
+  std::ofstream File(FileName.c_str(), std::ios::out | std::ios::trunc);
+  if (!File)
+    throw std::runtime_error("Linalg::WriteMatrixMarket: cannot open " 
+                             + FileName);
+
+  WriteMatrixMarket(static_cast<std::ostream&>(File), M);
+}
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_MATRIX_MARKET_INC
@@ -0,0 +1,308 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_NESTED_PRODUCTS_INC
+#define DAIXT_LINALG_NESTED_PRODUCTS_INC
+
+#include "linalg/Disambiguation.h"
+#include "linalg/TemporaryPool.h"
+#include "linalg/CommonSubExpr.h"
+
+#include "daixtrose/Daixt.h"
+
+#include "boost/mpl/if.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// temporaries for nested matrix * vector products
+////////////////////////////////////////////////////////////////////////////////
+
+// Row i of "A * (B * x)" asks for row j of "B * x" for every entry A(i, j), so
+// the rows of B * x are computed over and over again: the work is of order
+// nnz(A) * (average row length of B) instead of nnz(A) + nnz(B).
+//
+// The cost analysis below is simple: the right hand side of a matrix * vector
+// product is accessed once per entry of a matrix row. If it contains a matrix
+// * vector product itself, the innermost one is evaluated into a pooled
+// temporary before the outer pass. Matrices with at most one entry per row
+// (lumped matrices and their inverses) access their rhs only once per row, so
+// there is nothing to gain: specialize SingleEntryRows for those.
+
+namespace Linalg
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// does a matrix expression have at most one entry per row?
+template <class T>
+struct SingleEntryRows
+{
+  enum { Result = false };
+};
+
+template <class T>
+struct SingleEntryRows<Daixt::Expr<T> >
+{
+  enum { Result = SingleEntryRows<T>::Result };
+};
+
+
+namespace Private
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// paths to a node inside an expression tree
+
+struct Nowhere {};
+struct Here {};
+template <class Path> struct InArg {};
+template <class Path> struct InLHS {};
+template <class Path> struct InRHS {};
+
+
+template <class D> 
+struct IsVectorExpression { enum { Result = false }; };
+
+template <class T> 
+struct IsVectorExpression<VectorExpression<T> > { enum { Result = true }; };
+
+
+template <class LHS, class RHS, class OP>
+struct IsMatrixTimesVector
+{
+  enum { Result = false };
+};
+
+template <class LHS, class RHS>
+struct IsMatrixTimesVector<LHS, RHS, Daixt::DefaultOps::BinaryMultiply>
+{
+  enum { Result = 
+         IsMatrixExpression<typename 
+                            Daixt::disambiguation<LHS>::type>::Result 
+         &&
+         IsVectorExpression<typename 
+                            Daixt::disambiguation<RHS>::type>::Result };
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the cost analysis: find the path to the innermost matrix * vector product
+// whose rows are requested repeatedly
+
+template <class T, bool Repeated = false>
+struct NestedProductFinder
+{
+  typedef Nowhere Path;
+};
+
+template <class T, bool Repeated>
+struct NestedProductFinder<Daixt::Expr<T>, Repeated>
+{
+  typedef typename NestedProductFinder<T, Repeated>::Path Path;
+};
+
+template <class ARG, class OP, bool Repeated>
+struct NestedProductFinder<Daixt::UnOp<ARG, OP>, Repeated>
+{
+  typedef typename NestedProductFinder<ARG, Repeated>::Path InChild;
+
+  typedef typename boost::mpl::if_c<SAME_TYPE(InChild, Nowhere),
+                                    Nowhere,
+                                    InArg<InChild> >::type Path;
+};
+
+template <class LHS, class RHS, class OP, bool Repeated>
+struct NestedProductFinder<Daixt::BinOp<LHS, RHS, OP>, Repeated>
+{
+  enum { is_product = IsMatrixTimesVector<LHS, RHS, OP>::Result };
+
+  // the rhs of a product is requested once per entry of a matrix row
+  enum { rhs_repeated = 
+         Repeated || (is_product && !SingleEntryRows<LHS>::Result) };
+
+  typedef typename NestedProductFinder<LHS, Repeated>::Path InLeft;
+  typedef typename NestedProductFinder<RHS, rhs_repeated>::Path InRight;
+
+  typedef typename boost::mpl::if_c
+  <
+    !SAME_TYPE(InLeft, Nowhere), 
+    InLHS<InLeft>,
+    typename boost::mpl::if_c
+    <
+      !SAME_TYPE(InRight, Nowhere), 
+      InRHS<InRight>,
+      typename boost::mpl::if_c<is_product && Repeated, Here, Nowhere>::type
+    >::type
+  >::type Path;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// access the node at the end of a path
+
+template <class T, class Path>
+struct SubExprAt;
+
+template <class T>
+struct SubExprAt<T, Here>
+{
+  typedef T Result;
+  static inline const T& Get(const T& t) { return t; }
+};
+
+template <class ARG, class OP, class Path>
+struct SubExprAt<Daixt::UnOp<ARG, OP>, InArg<Path> >
+{
+  typedef typename SubExprAt<ARG, Path>::Result Result;
+  static inline const Result& Get(const Daixt::UnOp<ARG, OP>& UO) 
+  { 
+    return SubExprAt<ARG, Path>::Get(UO.arg()); 
+  }
+};
+
+template <class LHS, class RHS, class OP, class Path>
+struct SubExprAt<Daixt::BinOp<LHS, RHS, OP>, InLHS<Path> >
+{
+  typedef typename SubExprAt<LHS, Path>::Result Result;
+  static inline const Result& Get(const Daixt::BinOp<LHS, RHS, OP>& BO) 
+  { 
+    return SubExprAt<LHS, Path>::Get(BO.lhs()); 
+  }
+};
+
+template <class LHS, class RHS, class OP, class Path>
+struct SubExprAt<Daixt::BinOp<LHS, RHS, OP>, InRHS<Path> >
+{
+  typedef typename SubExprAt<RHS, Path>::Result Result;
+  static inline const Result& Get(const Daixt::BinOp<LHS, RHS, OP>& BO) 
+  { 
+    return SubExprAt<RHS, Path>::Get(BO.rhs()); 
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// replace the node at the end of a path by an R
+
+template <class T, class Path, class R>
+struct ReplaceSubExprAt;
+
+template <class T, class R>
+struct ReplaceSubExprAt<T, Here, R>
+{
+  typedef R Result;
+  static inline const R& Apply(const T& t, const R& r) { return r; }
+};
+
+template <class ARG, class OP, class Path, class R>
+struct ReplaceSubExprAt<Daixt::UnOp<ARG, OP>, InArg<Path>, R>
+{
+  typedef typename ReplaceSubExprAt<ARG, Path, R>::Result NewARG;
+  typedef Daixt::UnOp<NewARG, OP> Result;
+
+  static inline Result Apply(const Daixt::UnOp<ARG, OP>& UO, const R& r) 
+  { 
+    return Result(ReplaceSubExprAt<ARG, Path, R>::Apply(UO.arg(), r)); 
+  }
+};
+
+template <class LHS, class RHS, class OP, class Path, class R>
+struct ReplaceSubExprAt<Daixt::BinOp<LHS, RHS, OP>, InLHS<Path>, R>
+{
+  typedef typename ReplaceSubExprAt<LHS, Path, R>::Result NewLHS;
+  typedef Daixt::BinOp<NewLHS, RHS, OP> Result;
+
+  static inline Result Apply(const Daixt::BinOp<LHS, RHS, OP>& BO, const R& r) 
+  { 
+    return Result(ReplaceSubExprAt<LHS, Path, R>::Apply(BO.lhs(), r), 
+                  BO.rhs()); 
+  }
+};
+
+template <class LHS, class RHS, class OP, class Path, class R>
+struct ReplaceSubExprAt<Daixt::BinOp<LHS, RHS, OP>, InRHS<Path>, R>
+{
+  typedef typename ReplaceSubExprAt<RHS, Path, R>::Result NewRHS;
+  typedef Daixt::BinOp<LHS, NewRHS, OP> Result;
+
+  static inline Result Apply(const Daixt::BinOp<LHS, RHS, OP>& BO, const R& r) 
+  { 
+    return Result(BO.lhs(),
+                  ReplaceSubExprAt<RHS, Path, R>::Apply(BO.rhs(), r)); 
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the work horse
+
+template <class VectorT, class T>
+inline bool 
+MaterializeNestedProducts(VectorT& Target, const T& t, const Nowhere& Dummy)
+{
+  return false;
+}
+
+
+template <class VectorT, class T, class Path>
+inline bool 
+MaterializeNestedProducts(VectorT& Target, const T& t, const Path& Dummy)
+{
+  DAIXT_INSTRUMENT_COUNT(vector_temporaries);
+
+  PooledTemporary<VectorT> Tmp;
+  *Tmp = SubExprAt<T, Path>::Get(t);
+
+  typedef Daixt::ConstRef<VectorT> CRefToTmp;
+  typedef ReplaceSubExprAt<T, Path, CRefToTmp> Replacer;
+
+  // delegate to operator= which takes care of the remaining ones
+  Target = Replacer::Apply(t, CRefToTmp(*Tmp)); 
+
+  return true;
+}
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// returns true if the assignment Target = t has been performed, false if there
+// was nothing to materialize and the caller must do the work
+
+template <class VectorT, class T>
+inline bool MaterializeNestedProducts(VectorT& Target, const T& t)
+{
+  typedef typename Private::NestedProductFinder<T>::Path Path;
+
+  return Private::MaterializeNestedProducts(Target, t, Path());
+}
+
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_NESTED_PRODUCTS_INC
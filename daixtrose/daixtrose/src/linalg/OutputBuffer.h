@@ -0,0 +1,135 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_OUTPUT_BUFFER_INC
+#define DAIXT_LINALG_OUTPUT_BUFFER_INC
+
+#include <algorithm>
+#include <clocale>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+namespace Linalg
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// A character buffer in front of a std::ostream for bulk text output. Numbers
+// are formatted by hand (integers) or by sprintf (reals), which avoids the
+// locale and formatting state machinery of operator<< for every single
+// entry. Reals always get '.' as decimal point, whatever LC_NUMERIC says.
+// The buffer is flushed when full and on destruction.
+
+class OutputBuffer
+{
+public:
+  inline explicit OutputBuffer(std::ostream& os, 
+                               std::size_t Capacity = 1 << 16)
+    : os_(os), Buffer_(Capacity < 64 ? 64 : Capacity), Size_(0) {}
+
+  inline ~OutputBuffer() { Flush(); }
+
+  inline void Put(char c) 
+  { 
+    MakeRoom(1); 
+    Buffer_[Size_++] = c; 
+  }
+
+  inline void Put(const char* s) 
+  { 
+    Put(s, std::strlen(s)); 
+  }
+
+  inline void Put(const char* s, std::size_t n) 
+  {
+    if (n > Buffer_.size())
+      {
+        Flush();
+        os_.write(s, static_cast<std::streamsize>(n));
+        return;
+      }
+    MakeRoom(n);
+    std::memcpy(&Buffer_[Size_], s, n);
+    Size_ += n;
+  }
+
+  inline void PutUnsigned(std::size_t n)
+  {
+    char Digits[24];
+    char* p = Digits + sizeof(Digits);
+    do 
+      {
+        *--p = static_cast<char>('0' + n % 10);
+        n /= 10;
+      } 
+    while (n != 0);
+    Put(p, Digits + sizeof(Digits) - p);
+  }
+
+  // %.<Precision>g
+  inline void PutReal(double x, int Precision)
+  {
+    char Digits[64];
+    int n = std::sprintf(Digits, "%.*g", Precision, x);
+
+    const char Point = *std::localeconv()->decimal_point;
+    if (Point != '.')
+      std::replace(Digits, Digits + n, Point, '.');
+
+    Put(Digits, static_cast<std::size_t>(n));
+  }
+
+  inline void Flush()
+  {
+    if (Size_ != 0)
+      {
+        os_.write(&Buffer_[0], static_cast<std::streamsize>(Size_));
+        Size_ = 0;
+      }
+  }
+
+private:
+  // not copyable
+  OutputBuffer(const OutputBuffer&);
+  OutputBuffer& operator=(const OutputBuffer&);
+
+  inline void MakeRoom(std::size_t n)
+  {
+    if (Size_ + n > Buffer_.size()) Flush();
+  }
+
+  std::ostream& os_;
+  std::vector<char> Buffer_;
+  std::size_t Size_;
+};
+
+} // namespace Linalg
+
+#endif // DAIXT_LINALG_OUTPUT_BUFFER_INC
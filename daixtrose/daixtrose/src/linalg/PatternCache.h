@@ -0,0 +1,644 @@
+//-*-C++-*- 
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_PATTERN_CACHE_INC
+#define DAIXT_LINALG_PATTERN_CACHE_INC
+
+#include "linalg/Matrix.h"
+
+#include "daixtrose/Daixt.h"
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+
+#include "boost/lexical_cast.hpp"
+#include "boost/type_traits/is_arithmetic.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// pattern cache for linear combinations of sparse matrices
+////////////////////////////////////////////////////////////////////////////////
+
+// With adaptive time stepping "M + dt * K" is assembled over and over again
+// with a new dt while the sparsity patterns of M and K stay the same. Plain
+// assignment merges the rows of M and K from scratch every time.
+//
+// PatternCache splits the work: the structural pass builds the merged pattern
+// of the result once and records for every entry of every operand where it
+// lands in the result. As long as the expression type and the operands'
+// patterns stay the same, Evaluate only runs the numeric pass, which walks the
+// operands' rows and accumulates Scale * value into the recorded positions.
+//
+//   Linalg::PatternCache<Matrix> Cache;
+//   for (...)
+//     {
+//       const Matrix& A = Cache.Evaluate(M + MatrixScalar(dt) * K);
+//       ...
+//     }
+//
+// Supported are sums and differences of matrices with arithmetic entries which
+// may be scaled by Daixt::Scalar (from either side) and negated. All other
+// expressions (and blocked matrices) are assigned the usual way on every call.
+//
+// The pattern also records the column of every operand entry. The numeric
+// pass compares it with the operand's actual column while it walks the rows,
+// so a changed pattern (even one with the same number of entries) is noticed
+// at the price of one comparison per entry, and the pattern is built again.
+//
+// RowStorage must be a node based associative container (std::map): the
+// numeric pass writes through pointers into the result's rows.
+
+namespace Linalg
+{
+
+namespace Private
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// type-level check: is T a linear combination of MatrixT operands?
+
+template <class MatrixT, class T> 
+struct IsLinearCombination 
+{ 
+  enum { Result = false }; 
+};
+
+template <class MatrixT, class T> 
+struct IsLinearCombination<MatrixT, Daixt::Expr<T> > 
+{ 
+  enum { Result = IsLinearCombination<MatrixT, T>::Result }; 
+};
+
+template <class MatrixT> 
+struct IsLinearCombination<MatrixT, Daixt::ConstRef<MatrixT> > 
+{ 
+  enum { Result = true }; 
+};
+
+template <class MatrixT, class LHS, class RHS> 
+struct IsLinearCombination<MatrixT, 
+                           Daixt::BinOp<LHS, RHS, 
+                                        Daixt::DefaultOps::BinaryPlus> > 
+{ 
+  enum { Result = (IsLinearCombination<MatrixT, LHS>::Result && 
+                   IsLinearCombination<MatrixT, RHS>::Result) }; 
+};
+
+template <class MatrixT, class LHS, class RHS> 
+struct IsLinearCombination<MatrixT, 
+                           Daixt::BinOp<LHS, RHS, 
+                                        Daixt::DefaultOps::BinaryMinus> > 
+{ 
+  enum { Result = (IsLinearCombination<MatrixT, LHS>::Result && 
+                   IsLinearCombination<MatrixT, RHS>::Result) }; 
+};
+
+template <class MatrixT, class D, class RHS> 
+struct IsLinearCombination<MatrixT, 
+                           Daixt::BinOp<Daixt::Scalar<D>, RHS, 
+                                        Daixt::DefaultOps::BinaryMultiply> > 
+{ 
+  enum { Result = IsLinearCombination<MatrixT, RHS>::Result }; 
+};
+
+template <class MatrixT, class LHS, class D> 
+struct IsLinearCombination<MatrixT, 
+                           Daixt::BinOp<LHS, Daixt::Scalar<D>, 
+                                        Daixt::DefaultOps::BinaryMultiply> > 
+{ 
+  enum { Result = IsLinearCombination<MatrixT, LHS>::Result }; 
+};
+
+// resolves the ambiguity of the two above
+template <class MatrixT, class D> 
+struct IsLinearCombination<MatrixT, 
+                           Daixt::BinOp<Daixt::Scalar<D>, Daixt::Scalar<D>, 
+                                        Daixt::DefaultOps::BinaryMultiply> > 
+{ 
+  enum { Result = false }; 
+};
+
+template <class MatrixT, class ARG> 
+struct IsLinearCombination<MatrixT, 
+                           Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus> > 
+{ 
+  enum { Result = IsLinearCombination<MatrixT, ARG>::Result }; 
+};
+
+template <class MatrixT, class ARG> 
+struct IsLinearCombination<MatrixT, 
+                           Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryPlus> > 
+{ 
+  enum { Result = IsLinearCombination<MatrixT, ARG>::Result }; 
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// one operand of the linear combination
+
+template <class MatrixT>
+struct ScaledOperand
+{
+  ScaledOperand(const MatrixT* Operand, double Scale)
+    : Operand_(Operand), Scale_(Scale) {}
+
+  const MatrixT* Operand_;
+  double Scale_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// runtime flattening into a list of ScaledOperands. Only instantiated for
+// types for which IsLinearCombination holds.
+
+template <class MatrixT, class T> 
+struct OperandCollector;
+
+template <class MatrixT, class T> 
+inline void CollectOperands(const T& t, double Scale, 
+                            std::vector<ScaledOperand<MatrixT> >& Operands)
+{
+  OperandCollector<MatrixT, T>::Apply(t, Scale, Operands);
+}
+
+template <class MatrixT, class T> 
+struct OperandCollector<MatrixT, Daixt::Expr<T> >
+{
+  static inline void Apply(const Daixt::Expr<T>& t, double Scale, 
+                           std::vector<ScaledOperand<MatrixT> >& Operands)
+  {
+    CollectOperands<MatrixT>(t.content(), Scale, Operands);
+  }
+};
+
+template <class MatrixT> 
+struct OperandCollector<MatrixT, Daixt::ConstRef<MatrixT> >
+{
+  static inline void Apply(const Daixt::ConstRef<MatrixT>& t, double Scale, 
+                           std::vector<ScaledOperand<MatrixT> >& Operands)
+  {
+    const MatrixT& M = t;
+    Operands.push_back(ScaledOperand<MatrixT>(&M, Scale));
+  }
+};
+
+template <class MatrixT, class LHS, class RHS> 
+struct OperandCollector<MatrixT, 
+                        Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryPlus> >
+{
+  typedef Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryPlus> ArgT;
+
+  static inline void Apply(const ArgT& t, double Scale, 
+                           std::vector<ScaledOperand<MatrixT> >& Operands)
+  {
+    CollectOperands<MatrixT>(t.lhs(), Scale, Operands);
+    CollectOperands<MatrixT>(t.rhs(), Scale, Operands);
+  }
+};
+
+template <class MatrixT, class LHS, class RHS> 
+struct OperandCollector<MatrixT, 
+                        Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMinus> >
+{
+  typedef Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMinus> ArgT;
+
+  static inline void Apply(const ArgT& t, double Scale, 
+                           std::vector<ScaledOperand<MatrixT> >& Operands)
+  {
+    CollectOperands<MatrixT>(t.lhs(), Scale, Operands);
+    CollectOperands<MatrixT>(t.rhs(), -Scale, Operands);
+  }
+};
+
+template <class MatrixT, class D, class RHS> 
+struct OperandCollector<MatrixT, 
+                        Daixt::BinOp<Daixt::Scalar<D>, RHS, 
+                                     Daixt::DefaultOps::BinaryMultiply> >
+{
+  typedef Daixt::BinOp<Daixt::Scalar<D>, RHS, 
+                       Daixt::DefaultOps::BinaryMultiply> ArgT;
+
+  static inline void Apply(const ArgT& t, double Scale, 
+                           std::vector<ScaledOperand<MatrixT> >& Operands)
+  {
+    CollectOperands<MatrixT>(t.rhs(), Scale * t.lhs().Value(), Operands);
+  }
+};
+
+template <class MatrixT, class LHS, class D> 
+struct OperandCollector<MatrixT, 
+                        Daixt::BinOp<LHS, Daixt::Scalar<D>, 
+                                     Daixt::DefaultOps::BinaryMultiply> >
+{
+  typedef Daixt::BinOp<LHS, Daixt::Scalar<D>, 
+                       Daixt::DefaultOps::BinaryMultiply> ArgT;
+
+  static inline void Apply(const ArgT& t, double Scale, 
+                           std::vector<ScaledOperand<MatrixT> >& Operands)
+  {
+    CollectOperands<MatrixT>(t.lhs(), Scale * t.rhs().Value(), Operands);
+  }
+};
+
+template <class MatrixT, class ARG> 
+struct OperandCollector<MatrixT, 
+                        Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus> >
+{
+  typedef Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryMinus> ArgT;
+
+  static inline void Apply(const ArgT& t, double Scale, 
+                           std::vector<ScaledOperand<MatrixT> >& Operands)
+  {
+    CollectOperands<MatrixT>(t.arg(), -Scale, Operands);
+  }
+};
+
+template <class MatrixT, class ARG> 
+struct OperandCollector<MatrixT, 
+                        Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryPlus> >
+{
+  typedef Daixt::UnOp<ARG, Daixt::DefaultOps::UnaryPlus> ArgT;
+
+  static inline void Apply(const ArgT& t, double Scale, 
+                           std::vector<ScaledOperand<MatrixT> >& Operands)
+  {
+    CollectOperands<MatrixT>(t.arg(), Scale, Operands);
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// one address per expression type, used as cache key
+
+template <class T>
+struct ExpressionKey
+{
+  static const void* Get() 
+  { 
+    static const char Tag = 0;
+    return &Tag; 
+  }
+};
+
+
+template <bool B> struct LinearCombinationTag {};
+
+} // namespace Private
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PatternCache
+
+template <class MatrixT>
+class PatternCache
+{
+public:
+  typedef typename MatrixT::RowStorageT::mapped_type NumT;
+  typedef typename MatrixT::RowStorageT RowStorage;
+  typedef typename MatrixT::DataStorageT DataStorageT;
+
+  PatternCache() 
+    : Key_(0), StructuralPasses_(0), NumericPasses_(0) {}
+
+  // Result is only valid until the next call of Evaluate 
+  template <class E> 
+  const MatrixT& Evaluate(const E& e);
+
+  const MatrixT& Result() const { return Result_; }
+
+  // forget the pattern, the next call of Evaluate builds it again
+  void Invalidate() { Key_ = 0; Operands_.clear(); Patterns_.clear(); }
+
+  std::size_t NumberOfStructuralPasses() const { return StructuralPasses_; }
+  std::size_t NumberOfNumericPasses() const { return NumericPasses_; }
+
+private:
+  typedef Private::ScaledOperand<MatrixT> OperandT;
+
+  // where the entries of an operand land in the result: the entries of row i
+  // are found in Position_[RowStart_[i]] ... Position_[RowStart_[i+1] - 1],
+  // Column_ holds their columns in the operand
+  struct Pattern
+  {
+    std::vector<std::size_t> RowStart_;
+    std::vector<NumT*> Position_;
+    std::vector<std::size_t> Column_;
+    std::size_t nrows_;
+    std::size_t ncols_;
+  };
+
+  const void* Key_;
+  std::vector<OperandT> Operands_;
+  std::vector<Pattern> Patterns_;
+  MatrixT Result_;
+
+  std::size_t StructuralPasses_;
+  std::size_t NumericPasses_;
+
+  template <class E> 
+  void Evaluate(const E& e, Private::LinearCombinationTag<true>);
+
+  template <class E> 
+  void Evaluate(const E& e, Private::LinearCombinationTag<false>);
+
+  bool PatternIsValid(const std::vector<OperandT>& Operands) const;
+  void BuildPattern();
+  bool NumericPass();
+
+  static std::size_t NumberOfEntries(const MatrixT& M);
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// implementation 
+
+template <class MatrixT>
+template <class E> 
+inline
+const MatrixT& 
+PatternCache<MatrixT>::Evaluate(const E& e)
+{
+  typedef typename Daixt::UnwrapExpr<E>::Type ArgT;
+
+  enum { cacheable = (Private::IsLinearCombination<MatrixT, ArgT>::Result &&
+                      boost::is_arithmetic<NumT>::value) };
+
+  Evaluate(e, Private::LinearCombinationTag<cacheable>());
+  return Result_;
+}
+
+
+template <class MatrixT>
+template <class E> 
+void
+PatternCache<MatrixT>::Evaluate(const E& e, Private::LinearCombinationTag<false>)
+{
+  // nothing to cache: the usual row-wise assignment
+  Invalidate();
+  Result_ = e;
+  ++StructuralPasses_;
+}
+
+
+template <class MatrixT>
+template <class E> 
+void
+PatternCache<MatrixT>::Evaluate(const E& e, Private::LinearCombinationTag<true>)
+{
+  typedef typename Daixt::UnwrapExpr<E>::Type ArgT;
+
+  DAIXT_PROFILE_SCOPE(ArgT);
+
+  std::vector<OperandT> Operands;
+  Private::CollectOperands<MatrixT>(e, 1.0, Operands);
+
+  for (std::size_t k = 0; k != Operands.size(); ++k)
+    {
+      if (Operands[k].Operand_ == &Result_)
+        {
+          throw std::logic_error
+            ("Linalg::PatternCache::Evaluate: the cached result "
+             "must not be an operand");
+        }
+    }
+
+  const void* Key = Private::ExpressionKey<ArgT>::Get();
+
+  if (Key != Key_ || !PatternIsValid(Operands))
+    {
+      Key_ = 0;
+      Operands_.swap(Operands);
+      BuildPattern();
+      Key_ = Key;
+      ++StructuralPasses_;
+    }
+  else
+    {
+      // same operands, maybe new scales
+      Operands_.swap(Operands);
+    }
+
+  if (!NumericPass())
+    {
+      // an operand's pattern changed behind our back
+      Key_ = 0;
+      BuildPattern();
+      Key_ = Key;
+      ++StructuralPasses_;
+      NumericPass();
+    }
+  ++NumericPasses_;
+}
+
+
+template <class MatrixT>
+std::size_t
+PatternCache<MatrixT>::NumberOfEntries(const MatrixT& M)
+{
+  std::size_t Result = 0;
+  for (std::size_t i = 1; i != M.nrows() + 1; ++i)
+    {
+      Result += M(i).size();
+    }
+  return Result;
+}
+
+
+template <class MatrixT>
+bool
+PatternCache<MatrixT>::PatternIsValid(const std::vector<OperandT>& Operands) const
+{
+  if (Operands.size() != Operands_.size()) return false;
+
+  for (std::size_t k = 0; k != Operands.size(); ++k)
+    {
+      const MatrixT& M = *Operands[k].Operand_;
+      const Pattern& P = Patterns_[k];
+
+      // the columns are checked by the numeric pass
+      if (Operands[k].Operand_ != Operands_[k].Operand_ || 
+          M.nrows() != P.nrows_ || 
+          M.ncols() != P.ncols_)
+        {
+          return false;
+        }
+    }
+
+  return true;
+}
+
+
+template <class MatrixT>
+void
+PatternCache<MatrixT>::BuildPattern()
+{
+  const std::size_t nrows = Operands_.front().Operand_->nrows();
+  const std::size_t ncols = Operands_.front().Operand_->ncols();
+
+  for (std::size_t k = 1; k != Operands_.size(); ++k)
+    {
+      const MatrixT& M = *Operands_[k].Operand_;
+      if (M.nrows() != nrows || M.ncols() != ncols)
+        {
+          throw std::range_error
+            (std::string("Linalg::PatternCache: operand ")
+             + boost::lexical_cast<std::string>(k + 1)
+             + " has size " 
+             + boost::lexical_cast<std::string>(M.nrows()) + "x"
+             + boost::lexical_cast<std::string>(M.ncols()) 
+             + ", expected "
+             + boost::lexical_cast<std::string>(nrows) + "x"
+             + boost::lexical_cast<std::string>(ncols));
+        }
+    }
+
+  typedef typename RowStorage::const_iterator const_iterator;
+
+  // merge the patterns. The rows are built outside Result_ and swapped in
+  // below: swapping the row vector moves no nodes, the positions stay valid
+  DataStorageT Rows(nrows);
+
+  for (std::size_t i = 0; i != nrows; ++i)
+    {
+      for (std::size_t k = 0; k != Operands_.size(); ++k)
+        {
+          const RowStorage& Row = (*Operands_[k].Operand_)(i + 1);
+          const_iterator end = Row.end();
+          for (const_iterator iter = Row.begin(); iter != end; ++iter)
+            {
+              Rows[i].insert(std::make_pair(iter->first, NumT()));
+            }
+        }
+    }
+
+  std::vector<Pattern> Patterns(Operands_.size());
+
+  for (std::size_t k = 0; k != Operands_.size(); ++k)
+    {
+      const MatrixT& M = *Operands_[k].Operand_;
+      Pattern& P = Patterns[k];
+
+      P.nrows_ = nrows;
+      P.ncols_ = ncols;
+      P.RowStart_.reserve(nrows + 1);
+      P.Position_.reserve(NumberOfEntries(M));
+      P.Column_.reserve(NumberOfEntries(M));
+
+      for (std::size_t i = 0; i != nrows; ++i)
+        {
+          P.RowStart_.push_back(P.Position_.size());
+
+          const RowStorage& Row = M(i + 1);
+          const_iterator end = Row.end();
+          for (const_iterator iter = Row.begin(); iter != end; ++iter)
+            {
+              P.Position_.push_back(&Rows[i].find(iter->first)->second);
+              P.Column_.push_back(iter->first);
+            }
+        }
+
+      P.RowStart_.push_back(P.Position_.size());
+    }
+
+  MatrixT Tmp(nrows, ncols);
+  Tmp.SwapRows(Rows);
+  Result_.swap(Tmp);
+
+  Patterns_.swap(Patterns);
+}
+
+
+// false if an operand's entries no longer match the recorded columns. The 
+// result is garbage then, but all writes stayed inside the result's rows.
+template <class MatrixT>
+bool
+PatternCache<MatrixT>::NumericPass()
+{
+  typedef typename RowStorage::const_iterator const_iterator;
+
+  const std::size_t NumberOfOperands = Operands_.size();
+
+  bool Matches = true;
+
+  // OpenMP wants a signed loop index
+  const long n = static_cast<long>(Result_.nrows());
+
+  // every row of the result is only touched via the positions of its own
+  // row, so the rows can be processed in parallel
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (long i = 0; i < n; ++i)
+    {
+      // the merged pattern is covered by the operands' entries
+      for (std::size_t k = 0; k != NumberOfOperands; ++k)
+        {
+          const Pattern& P = Patterns_[k];
+          for (std::size_t e = P.RowStart_[i]; e != P.RowStart_[i + 1]; ++e)
+            {
+              *P.Position_[e] = NumT();
+            }
+        }
+
+      for (std::size_t k = 0; k != NumberOfOperands; ++k)
+        {
+          const Pattern& P = Patterns_[k];
+          const NumT Scale = static_cast<NumT>(Operands_[k].Scale_);
+          const std::size_t RowEnd = P.RowStart_[i + 1];
+          std::size_t e = P.RowStart_[i];
+
+          const RowStorage& Row = (*Operands_[k].Operand_)(i + 1);
+          const_iterator iter = Row.begin();
+          const_iterator end = Row.end();
+          for (; iter != end && e != RowEnd && iter->first == P.Column_[e]; 
+               ++iter, ++e)
+            {
+              *P.Position_[e] += Scale * iter->second;
+            }
+
+          if (iter != end || e != RowEnd)
+            {
+#ifdef _OPENMP
+#pragma omp critical (daixt_pattern_cache)
+#endif
+              Matches = false;
+            }
+        }
+    }
+
+  return Matches;
+}
+
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_PATTERN_CACHE_INC
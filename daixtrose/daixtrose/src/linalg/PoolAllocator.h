@@ -0,0 +1,369 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_POOL_ALLOCATOR_INC
+#define DAIXT_LINALG_POOL_ALLOCATOR_INC
+
+#include "daixtrose/ThreadLocal.h"
+#include "daixtrose/Instrumentation.h"
+#include "daixtrose/Profiler.h"
+
+#include <new>
+#include <map>
+#include <utility>
+#include <cstddef>
+#include <stdexcept>
+#include <functional>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// A per-thread node pool and an STL allocator using it
+////////////////////////////////////////////////////////////////////////////////
+
+// Every row evaluated inside an expression is a fresh std::map whose nodes live
+// only until the row has been consumed. With std::allocator each node costs a
+// malloc/free pair. PoolAllocator hands out small blocks from big chunks owned
+// by the calling thread and keeps freed blocks in per-size free lists, so the
+// nodes of one row are recycled by the next row.
+//
+// Matrices use it if they ask for it:
+//
+//   typedef Linalg::PooledRowStorage<double>::Type RowStorage;
+//   typedef Linalg::Matrix<double, RowStorage> Matrix;
+//
+// and then all their rows and the row temporaries of RowExtractor and
+// ColExtractor come from the pool. The default Matrix<T> uses the heap.
+//
+// Blocks freed by another thread than the allocating one simply migrate to
+// the free lists of the freeing thread, which happens all the time when rows
+// are evaluated in parallel. The pools of all threads are therefore linked
+// together: BlocksInUse() counts the blocks of the whole process, and
+// NodePool::Release() gives the chunks of all threads back to the system and
+// empties all free lists. It is legal when no block is in use any more and
+// must not run concurrently with other threads using the pool.
+//
+// Nothing else gives memory back. If the rows of a matrix are built by the
+// OpenMP workers and dropped by the master thread, the freed blocks pile up
+// in the master's free lists while the workers take new chunks for the next
+// matrix, so memory grows with every round. That is why the pool is opt-in:
+// use it where rows are built and dropped by the same thread, or call 
+// Release() between phases.
+
+namespace Linalg
+{
+
+namespace Private
+{
+
+struct PoolChunk 
+{ 
+  PoolChunk* Next; 
+};
+
+struct FreeBlock 
+{ 
+  FreeBlock* Next; 
+};
+
+// the pool of one thread, created on the thread's first allocation and 
+// never destroyed, so the chunks of finished threads can still be released
+struct PoolState
+{
+  enum { 
+    Granularity = 16,
+    NumberOfSizeClasses = 32, // blocks up to 512 bytes are pooled
+    ChunkSize = 64 * 1024 
+  };
+
+  FreeBlock* FreeList[NumberOfSizeClasses];
+  PoolChunk* Chunks;
+  char* Begin;
+  char* End;
+
+  // allocations minus deallocations by this thread: negative for a thread
+  // freeing what others allocated, only the sum over all threads matters
+  long BlocksInUse; 
+
+  PoolState* Next; // the list of all pools
+};
+
+inline PoolState*& FirstPool()
+{
+  static PoolState* First = 0;
+  return First;
+}
+
+inline PoolState* NewPool()
+{
+  PoolState* State = new PoolState(); // zero initialized
+
+#ifdef _OPENMP
+#pragma omp critical (daixt_node_pool_registry)
+#endif
+  {
+    State->Next = FirstPool();
+    FirstPool() = State;
+  }
+  return State;
+}
+
+inline PoolState& ThisThreadsPool()
+{
+  // only a pointer, since DAIXT_THREAD_LOCAL runs no constructors
+  static DAIXT_THREAD_LOCAL PoolState* State = 0;
+  if (State == 0)
+    {
+      State = NewPool();
+    }
+  return *State;
+}
+
+} // namespace Private
+
+
+class NodePool
+{
+  typedef Private::PoolState PoolState;
+
+public:
+  static inline void* Allocate(std::size_t Bytes)
+  {
+    DAIXT_PROFILE_ALLOCATION(Bytes);
+
+    if (Bytes == 0 || Bytes > MaxPooledSize())
+      {
+        return ::operator new(Bytes);
+      }
+
+    PoolState& State = Private::ThisThreadsPool();
+    std::size_t SizeClass = (Bytes - 1) / PoolState::Granularity;
+
+    ++State.BlocksInUse;
+    DAIXT_INSTRUMENT_COUNT(pool_allocations);
+
+    Private::FreeBlock* Block = State.FreeList[SizeClass];
+    if (Block != 0)
+      {
+        State.FreeList[SizeClass] = Block->Next;
+        return Block;
+      }
+
+    std::size_t BlockSize = (SizeClass + 1) * PoolState::Granularity;
+    if (static_cast<std::size_t>(State.End - State.Begin) < BlockSize)
+      {
+        NewChunk(State);
+      }
+
+    void* Result = State.Begin;
+    State.Begin += BlockSize;
+    return Result;
+  }
+
+  static inline void Deallocate(void* p, std::size_t Bytes)
+  {
+    if (Bytes == 0 || Bytes > MaxPooledSize())
+      {
+        ::operator delete(p);
+        return;
+      }
+
+    PoolState& State = Private::ThisThreadsPool();
+    std::size_t SizeClass = (Bytes - 1) / PoolState::Granularity;
+
+    --State.BlocksInUse;
+
+    Private::FreeBlock* Block = static_cast<Private::FreeBlock*>(p);
+    Block->Next = State.FreeList[SizeClass];
+    State.FreeList[SizeClass] = Block;
+  }
+
+  // number of blocks allocated minus the number of blocks freed, by all 
+  // threads. Exact while no other thread allocates or frees.
+  static inline long BlocksInUse()
+  {
+    long Result = 0;
+
+#ifdef _OPENMP
+#pragma omp critical (daixt_node_pool_registry)
+#endif
+    {
+      for (PoolState* State = Private::FirstPool(); State != 0; 
+           State = State->Next)
+        {
+          Result += State->BlocksInUse;
+        }
+    }
+    return Result;
+  }
+
+  // reset: give the chunks of all threads back to the system. No other 
+  // thread may use the pool meanwhile.
+  static inline void Release()
+  {
+    if (BlocksInUse() != 0)
+      {
+        throw std::logic_error("Linalg::NodePool::Release: "
+                               "there are blocks still in use");
+      }
+
+#ifdef _OPENMP
+#pragma omp critical (daixt_node_pool_registry)
+#endif
+    {
+      for (PoolState* State = Private::FirstPool(); State != 0; 
+           State = State->Next)
+        {
+          while (State->Chunks != 0)
+            {
+              Private::PoolChunk* Tmp = State->Chunks;
+              State->Chunks = Tmp->Next;
+              ::operator delete(Tmp);
+            }
+
+          for (std::size_t i = 0; i != PoolState::NumberOfSizeClasses; ++i)
+            {
+              State->FreeList[i] = 0;
+            }
+          State->Begin = State->End = 0;
+          State->BlocksInUse = 0;
+        }
+    }
+  }
+
+private:
+  static inline std::size_t MaxPooledSize()
+  {
+    return PoolState::Granularity * PoolState::NumberOfSizeClasses;
+  }
+
+  static inline void NewChunk(PoolState& State)
+  {
+    // keep the blocks aligned to Granularity
+    const std::size_t HeaderSize = PoolState::Granularity;
+
+    char* Chunk = 
+      static_cast<char*>(::operator new(HeaderSize + PoolState::ChunkSize));
+    
+    reinterpret_cast<Private::PoolChunk*>(Chunk)->Next = State.Chunks;
+    State.Chunks = reinterpret_cast<Private::PoolChunk*>(Chunk);
+
+    State.Begin = Chunk + HeaderSize;
+    State.End = State.Begin + PoolState::ChunkSize;
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the allocator
+
+template <class T> class PoolAllocator;
+
+template <> 
+class PoolAllocator<void>
+{
+public:
+  typedef void* pointer;
+  typedef const void* const_pointer;
+  typedef void value_type;
+
+  template <class U> struct rebind { typedef PoolAllocator<U> other; };
+};
+
+
+template <class T> 
+class PoolAllocator
+{
+public:
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef T value_type;
+
+  template <class U> struct rebind { typedef PoolAllocator<U> other; };
+
+  inline PoolAllocator() throw() {}
+  inline PoolAllocator(const PoolAllocator&) throw() {}
+  template <class U> inline PoolAllocator(const PoolAllocator<U>&) throw() {}
+  inline ~PoolAllocator() throw() {}
+
+  inline pointer address(reference x) const { return &x; }
+  inline const_pointer address(const_reference x) const { return &x; }
+
+  inline pointer allocate(size_type n, PoolAllocator<void>::const_pointer = 0)
+  {
+    return static_cast<pointer>(NodePool::Allocate(n * sizeof(T)));
+  }
+
+  inline void deallocate(pointer p, size_type n)
+  {
+    NodePool::Deallocate(p, n * sizeof(T));
+  }
+
+  inline size_type max_size() const throw() 
+  { 
+    return static_cast<size_type>(-1) / sizeof(T); 
+  }
+
+  inline void construct(pointer p, const T& val) { new(p) T(val); }
+  inline void destroy(pointer p) { p->~T(); }
+};
+
+
+// all pool allocators are interchangeable
+template <class T1, class T2>
+inline bool operator==(const PoolAllocator<T1>&, const PoolAllocator<T2>&)
+{
+  return true;
+}
+
+template <class T1, class T2>
+inline bool operator!=(const PoolAllocator<T1>&, const PoolAllocator<T2>&)
+{
+  return false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// a row storage for Linalg::Matrix using the pool
+template <class T>
+struct PooledRowStorage
+{
+  typedef std::map<std::size_t, 
+                   T, 
+                   std::less<std::size_t>,
+                   PoolAllocator<std::pair<const std::size_t, T> > > Type;
+};
+
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_POOL_ALLOCATOR_INC
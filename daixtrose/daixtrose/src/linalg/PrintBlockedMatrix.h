@@ -50,6 +50,9 @@ namespace Linalg
 ////////////////////////////////////////////////////////////////////////////////
 // Output utility: treat a Matrix of TinyMatrices in a special way 
 // i.e. human-readable blockwise output with row and column separators
+//
+// Every empty block is padded, so the output grows with nrows * ncols. For
+// large matrices use PrintSparse from linalg/PrintSparseMatrix.h instead.
 
 
 template <class Double, std::size_t N, class RowStorage>
@@ -0,0 +1,229 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_PRINT_SPARSE_MATRIX_INC
+#define DAIXT_LINALG_PRINT_SPARSE_MATRIX_INC
+
+#include "linalg/Matrix.h"
+#include "linalg/OutputBuffer.h"
+
+#include "tiny/TinyMatrix.h"
+#include "tiny/TinyVector.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <ostream>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Streaming output of sparse matrices: only the stored entries are written,
+// one line per entry, led by its coordinates:
+//
+//   i j value                              Matrix<double>
+//   i j | a11 a12 ... | a21 a22 ... | ...  Matrix<TinyQuadraticMatrix<D, N> >
+//   i j | v1 v2 ...                        Matrix<TinyVector<D, N> >
+//
+// The output size is proportional to the number of entries printed (unlike
+// operator<< of PrintBlockedMatrix.h, which pads every empty block) and can be
+// restricted to a window of rows and columns.
+//
+// Usage:
+//   Linalg::PrintSparse(std::cerr, M);
+//   std::cerr << Linalg::Sparse(M, Linalg::PrintWindow(100, 200, 1, 50));
+
+namespace Linalg
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// rows [FirstRow, LastRow] x columns [FirstCol, LastCol], 1-based. The window
+// is clipped to the matrix, the defaults select everything.
+
+struct PrintWindow
+{
+  inline PrintWindow(std::size_t FirstRow_ = 1, 
+                     std::size_t LastRow_ = std::numeric_limits<std::size_t>::max(),
+                     std::size_t FirstCol_ = 1, 
+                     std::size_t LastCol_ = std::numeric_limits<std::size_t>::max())
+    : FirstRow(FirstRow_), LastRow(LastRow_), 
+      FirstCol(FirstCol_), LastCol(LastCol_) 
+  {}
+
+  std::size_t FirstRow;
+  std::size_t LastRow;
+  std::size_t FirstCol;
+  std::size_t LastCol;
+};
+
+
+namespace Private
+{
+////////////////////////////////////////////////////////////////////////////////
+// how to print a single entry
+
+template <class T> 
+struct SparsePrintEntry
+{
+  static inline void Put(OutputBuffer& Out, const T& t, int Precision)
+  {
+    Out.Put(' ');
+    Out.PutReal(t, Precision);
+  }
+};
+
+
+template <class D, std::size_t N> 
+struct SparsePrintEntry<TinyMat::TinyQuadraticMatrix<D, N> >
+{
+  static inline void Put(OutputBuffer& Out, 
+                         const TinyMat::TinyQuadraticMatrix<D, N>& t, 
+                         int Precision)
+  {
+    for (std::size_t i = 1; i != N + 1; ++i)
+      {
+        Out.Put(" |", 2);
+        for (std::size_t j = 1; j != N + 1; ++j)
+          {
+            Out.Put(' ');
+            Out.PutReal(t(i, j), Precision);
+          }
+      }
+  }
+};
+
+
+template <class D, std::size_t N> 
+struct SparsePrintEntry<TinyVec::TinyVector<D, N> >
+{
+  static inline void Put(OutputBuffer& Out, 
+                         const TinyVec::TinyVector<D, N>& t, 
+                         int Precision)
+  {
+    Out.Put(" |", 2);
+    for (std::size_t i = 1; i != N + 1; ++i)
+      {
+        Out.Put(' ');
+        Out.PutReal(t(i), Precision);
+      }
+  }
+};
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// user's interface
+
+template <class T, class RowStorage, class Allocator>
+void PrintSparse(std::ostream& os, 
+                 const Matrix<T, RowStorage, Allocator>& M,
+                 const PrintWindow& Window = PrintWindow(),
+                 int Precision = 6)
+{
+  typedef typename RowStorage::const_iterator const_iterator;
+
+  const std::size_t FirstRow = std::max(Window.FirstRow, std::size_t(1));
+  const std::size_t LastRow = std::min(Window.LastRow, M.nrows());
+  const std::size_t FirstCol = std::max(Window.FirstCol, std::size_t(1));
+  const std::size_t LastCol = std::min(Window.LastCol, M.ncols());
+
+  OutputBuffer Out(os);
+
+  Out.Put("# sparse ");
+  Out.PutUnsigned(M.nrows());
+  Out.Put(" x ");
+  Out.PutUnsigned(M.ncols());
+  Out.Put(", rows ");
+  Out.PutUnsigned(FirstRow);
+  Out.Put("..");
+  Out.PutUnsigned(LastRow);
+  Out.Put(", cols ");
+  Out.PutUnsigned(FirstCol);
+  Out.Put("..");
+  Out.PutUnsigned(LastCol);
+  Out.Put('\n');
+
+  for (std::size_t i = FirstRow; i <= LastRow; ++i)
+    {
+      const RowStorage& Row = M(i);
+      const_iterator end = Row.end();
+
+      for (const_iterator iter = Row.lower_bound(FirstCol); 
+           (iter != end) && (iter->first <= LastCol); 
+           ++iter)
+        {
+          Out.PutUnsigned(i);
+          Out.Put(' ');
+          Out.PutUnsigned(iter->first);
+          Private::SparsePrintEntry<T>::Put(Out, iter->second, Precision);
+          Out.Put('\n');
+        }
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// for use with operator<<
+
+template <class MatrixT>
+struct SparseMatrixView
+{
+  inline SparseMatrixView(const MatrixT& M_, 
+                          const PrintWindow& Window_, 
+                          int Precision_)
+    : M(M_), Window(Window_), Precision(Precision_) {}
+
+  const MatrixT& M;
+  PrintWindow Window;
+  int Precision;
+};
+
+
+template <class T, class RowStorage, class Allocator>
+inline SparseMatrixView<Matrix<T, RowStorage, Allocator> >
+Sparse(const Matrix<T, RowStorage, Allocator>& M, 
+       const PrintWindow& Window = PrintWindow(),
+       int Precision = 6)
+{
+  return SparseMatrixView<Matrix<T, RowStorage, Allocator> >(M, Window, 
+                                                             Precision);
+}
+
+
+template <class MatrixT>
+inline std::ostream& operator<<(std::ostream& os, 
+                                const SparseMatrixView<MatrixT>& View)
+{
+  PrintSparse(os, View.M, View.Window, View.Precision);
+  return os;
+}
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_PRINT_SPARSE_MATRIX_INC
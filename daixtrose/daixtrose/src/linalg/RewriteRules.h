@@ -0,0 +1,490 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_REWRITE_RULES_INC
+#define DAIXT_LINALG_REWRITE_RULES_INC
+
+#include "linalg/Disambiguation.h"
+#include "linalg/NestedProducts.h"
+
+#include "daixtrose/Daixt.h"
+#include "daixtrose/CommonSubExpr.h"
+
+#include "boost/mpl/if.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// rewrite rules for matrix and vector expressions
+////////////////////////////////////////////////////////////////////////////////
+
+// Daixt::ExprManip::Simplify knows about x * 1 and x + 0, the rules below know
+// about matrices. They are applied to the right hand side of every Matrix and
+// Vector assignment before a single row is evaluated (for vectors right after
+// the shared products have been taken out, see CommonSubExpr.h):
+//
+//   alpha * (beta * X), (X * alpha) * beta, ...  ->  (alpha * beta) * X
+//   (alpha * A) * x, (A * alpha) * x             ->  alpha * (A * x)
+//   (-A) * x                                     ->  -(A * x)
+//   (A + B) * x, (A - B) * x                     ->  A * x + B * x, A * x - B * x
+//   A * x + A * y, A * x - A * y                 ->  A * (x + y), A * (x - y)
+//
+// and Transpose.h, Lump.h and Inverse.h add their own ones, e.g.
+// Transpose(Transpose(A)) -> A and Inverse(Lump(Lump(A))) -> Inverse(Lump(A)).
+//
+// The direction of the product rules follows the cost of a row: the rows of a
+// matrix are read by const reference, but the rows of "alpha * A", "-A" and "A
+// + B" are copied (and merged) first. Factoring "A * x + B * x" into "(A + B) *
+// x" would save a pass over x, but the merge of the rows of A and B allocates
+// and costs more than that pass. So only a common matrix is factored out. Since
+// "A * x + A * y" and "A * x + B * y" may have the same type, this last rule is
+// checked at runtime.
+//
+// Every rule maps a node whose children are rewritten already to a node that
+// needs no further rewriting. More rules are added by specializing
+// RewriteRule<T>.
+
+namespace Linalg
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// default: no rule applies to the root of T
+template <class T>
+struct RewriteRule
+{
+  typedef T type;
+  static inline const T& Apply(const T& t) { return t; }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// rewrite the children first, then the root
+
+template <class T>
+struct Rewriter
+{
+  typedef T type;
+  static inline const T& Apply(const T& t) { return t; }
+};
+
+template <class T>
+struct Rewriter<Daixt::Expr<T> >
+{
+  typedef typename Rewriter<T>::type type;
+  static inline type Apply(const Daixt::Expr<T>& E) 
+  { 
+    return Rewriter<T>::Apply(E.content()); 
+  }
+};
+
+template <class ARG, class OP>
+struct Rewriter<Daixt::UnOp<ARG, OP> >
+{
+  typedef Daixt::UnOp<typename Rewriter<ARG>::type, OP> Rebuilt;
+  typedef typename RewriteRule<Rebuilt>::type type;
+
+  static inline type Apply(const Daixt::UnOp<ARG, OP>& UO)
+  {
+    return RewriteRule<Rebuilt>::Apply(Rebuilt(Rewriter<ARG>::Apply(UO.arg())));
+  }
+};
+
+template <class LHS, class RHS, class OP>
+struct Rewriter<Daixt::BinOp<LHS, RHS, OP> >
+{
+  typedef Daixt::BinOp<typename Rewriter<LHS>::type, 
+                       typename Rewriter<RHS>::type, 
+                       OP> Rebuilt;
+  typedef typename RewriteRule<Rebuilt>::type type;
+
+  static inline type Apply(const Daixt::BinOp<LHS, RHS, OP>& BO)
+  {
+    return RewriteRule<Rebuilt>::Apply(Rebuilt(Rewriter<LHS>::Apply(BO.lhs()),
+                                               Rewriter<RHS>::Apply(BO.rhs())));
+  }
+};
+
+
+namespace Private
+{
+
+typedef Daixt::DefaultOps::BinaryMultiply Multiply;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// scalar folding, for matrices and vectors alike
+
+template <class LHS, class RHS, bool MatrixTimesVector>
+struct MultiplyRule
+{
+  typedef Daixt::BinOp<LHS, RHS, Multiply> type;
+  static inline const type& Apply(const type& BO) { return BO; }
+};
+
+
+// alpha * (beta * X) = (alpha * beta) * X
+template <class D, class X>
+struct MultiplyRule<Daixt::Scalar<D>, 
+                    Daixt::BinOp<Daixt::Scalar<D>, X, Multiply>, 
+                    false>
+{
+  typedef Daixt::BinOp<Daixt::Scalar<D>, X, Multiply> type;
+
+  static inline type 
+  Apply(const Daixt::BinOp<Daixt::Scalar<D>, type, Multiply>& BO)
+  {
+    return type(Daixt::Scalar<D>(BO.lhs().Value() * BO.rhs().lhs().Value()),
+                BO.rhs().rhs());
+  }
+};
+
+// alpha * (X * beta) = (alpha * beta) * X
+template <class D, class X>
+struct MultiplyRule<Daixt::Scalar<D>, 
+                    Daixt::BinOp<X, Daixt::Scalar<D>, Multiply>, 
+                    false>
+{
+  typedef Daixt::BinOp<Daixt::Scalar<D>, X, Multiply> type;
+  typedef Daixt::BinOp<X, Daixt::Scalar<D>, Multiply> RHS;
+
+  static inline type 
+  Apply(const Daixt::BinOp<Daixt::Scalar<D>, RHS, Multiply>& BO)
+  {
+    return type(Daixt::Scalar<D>(BO.lhs().Value() * BO.rhs().rhs().Value()),
+                BO.rhs().lhs());
+  }
+};
+
+// (alpha * X) * beta = (alpha * beta) * X
+template <class D, class X>
+struct MultiplyRule<Daixt::BinOp<Daixt::Scalar<D>, X, Multiply>, 
+                    Daixt::Scalar<D>, 
+                    false>
+{
+  typedef Daixt::BinOp<Daixt::Scalar<D>, X, Multiply> type;
+
+  static inline type 
+  Apply(const Daixt::BinOp<type, Daixt::Scalar<D>, Multiply>& BO)
+  {
+    return type(Daixt::Scalar<D>(BO.lhs().lhs().Value() * BO.rhs().Value()),
+                BO.lhs().rhs());
+  }
+};
+
+// (X * alpha) * beta = (alpha * beta) * X
+template <class D, class X>
+struct MultiplyRule<Daixt::BinOp<X, Daixt::Scalar<D>, Multiply>, 
+                    Daixt::Scalar<D>, 
+                    false>
+{
+  typedef Daixt::BinOp<Daixt::Scalar<D>, X, Multiply> type;
+  typedef Daixt::BinOp<X, Daixt::Scalar<D>, Multiply> LHS;
+
+  static inline type 
+  Apply(const Daixt::BinOp<LHS, Daixt::Scalar<D>, Multiply>& BO)
+  {
+    return type(Daixt::Scalar<D>(BO.lhs().rhs().Value() * BO.rhs().Value()),
+                BO.lhs().lhs());
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// matrix * vector: keep the rows of the matrix untouched
+
+// (alpha * A) * x = alpha * (A * x)
+template <class D, class M, class V>
+struct MultiplyRule<Daixt::BinOp<Daixt::Scalar<D>, M, Multiply>, V, true>
+{
+  typedef RewriteRule<Daixt::BinOp<M, V, Multiply> > Product;
+  typedef Daixt::Scalar<typename Daixt::disambiguation<V>::type> Factor;
+  typedef RewriteRule<Daixt::BinOp<Factor, typename Product::type, Multiply> >
+  Result;
+
+  typedef typename Result::type type;
+  typedef Daixt::BinOp<Daixt::Scalar<D>, M, Multiply> LHS;
+
+  static inline type Apply(const Daixt::BinOp<LHS, V, Multiply>& BO)
+  {
+    typedef Daixt::BinOp<M, V, Multiply> MV;
+    typedef Daixt::BinOp<Factor, typename Product::type, Multiply> Scaled;
+
+    return Result::Apply(Scaled(Factor(BO.lhs().lhs().Value()),
+                                Product::Apply(MV(BO.lhs().rhs(), BO.rhs()))));
+  }
+};
+
+// (A * alpha) * x = alpha * (A * x)
+template <class D, class M, class V>
+struct MultiplyRule<Daixt::BinOp<M, Daixt::Scalar<D>, Multiply>, V, true>
+{
+  typedef RewriteRule<Daixt::BinOp<M, V, Multiply> > Product;
+  typedef Daixt::Scalar<typename Daixt::disambiguation<V>::type> Factor;
+  typedef RewriteRule<Daixt::BinOp<Factor, typename Product::type, Multiply> >
+  Result;
+
+  typedef typename Result::type type;
+  typedef Daixt::BinOp<M, Daixt::Scalar<D>, Multiply> LHS;
+
+  static inline type Apply(const Daixt::BinOp<LHS, V, Multiply>& BO)
+  {
+    typedef Daixt::BinOp<M, V, Multiply> MV;
+    typedef Daixt::BinOp<Factor, typename Product::type, Multiply> Scaled;
+
+    return Result::Apply(Scaled(Factor(BO.lhs().rhs().Value()),
+                                Product::Apply(MV(BO.lhs().lhs(), BO.rhs()))));
+  }
+};
+
+// (-A) * x = -(A * x)
+template <class M, class V>
+struct MultiplyRule<Daixt::UnOp<M, Daixt::DefaultOps::UnaryMinus>, V, true>
+{
+  typedef RewriteRule<Daixt::BinOp<M, V, Multiply> > Product;
+  typedef RewriteRule<Daixt::UnOp<typename Product::type, 
+                                  Daixt::DefaultOps::UnaryMinus> > Result;
+
+  typedef typename Result::type type;
+  typedef Daixt::UnOp<M, Daixt::DefaultOps::UnaryMinus> LHS;
+
+  static inline type Apply(const Daixt::BinOp<LHS, V, Multiply>& BO)
+  {
+    typedef Daixt::BinOp<M, V, Multiply> MV;
+    typedef Daixt::UnOp<typename Product::type, 
+                        Daixt::DefaultOps::UnaryMinus> Negated;
+
+    return Result::Apply(Negated(Product::Apply(MV(BO.lhs().arg(), 
+                                                   BO.rhs()))));
+  }
+};
+
+// (A + B) * x = A * x + B * x, (A - B) * x = A * x - B * x
+template <class M, class N, class V, class OP>
+struct DistributedProduct
+{
+  typedef RewriteRule<Daixt::BinOp<M, V, Multiply> > Left;
+  typedef RewriteRule<Daixt::BinOp<N, V, Multiply> > Right;
+  typedef RewriteRule<Daixt::BinOp<typename Left::type, 
+                                   typename Right::type, 
+                                   OP> > Result;
+
+  typedef typename Result::type type;
+  typedef Daixt::BinOp<M, N, OP> LHS;
+
+  static inline type Apply(const Daixt::BinOp<LHS, V, Multiply>& BO)
+  {
+    typedef Daixt::BinOp<M, V, Multiply> MV;
+    typedef Daixt::BinOp<N, V, Multiply> NV;
+    typedef Daixt::BinOp<typename Left::type, typename Right::type, OP> Sum;
+
+    return Result::Apply(Sum(Left::Apply(MV(BO.lhs().lhs(), BO.rhs())),
+                             Right::Apply(NV(BO.lhs().rhs(), BO.rhs()))));
+  }
+};
+
+template <class M, class N, class V>
+struct MultiplyRule<Daixt::BinOp<M, N, Daixt::DefaultOps::BinaryPlus>, V, true>
+  : public DistributedProduct<M, N, V, Daixt::DefaultOps::BinaryPlus>
+{};
+
+template <class M, class N, class V>
+struct MultiplyRule<Daixt::BinOp<M, N, Daixt::DefaultOps::BinaryMinus>, V, true>
+  : public DistributedProduct<M, N, V, Daixt::DefaultOps::BinaryMinus>
+{};
+
+} // namespace Private
+
+
+template <class LHS, class RHS>
+struct RewriteRule<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply> >
+  : public Private::MultiplyRule<LHS, RHS, 
+                                 Private::IsMatrixTimesVector
+                                 <LHS, RHS, 
+                                  Daixt::DefaultOps::BinaryMultiply>::Result>
+{};
+
+
+namespace Private
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// A * x + A * y = A * (x + y): the types only tell us where to look
+
+template <class T>
+struct CommonMatrix
+{
+  enum { Result = false };
+};
+
+template <class M, class X, class Y, class OP>
+struct CommonMatrixInSum
+{
+  enum { Result = IsMatrixTimesVector<M, X, Multiply>::Result };
+
+  typedef Daixt::BinOp<Daixt::BinOp<M, X, Multiply>, 
+                       Daixt::BinOp<M, Y, Multiply>, 
+                       OP> ArgT;
+  typedef Daixt::BinOp<M, Daixt::BinOp<X, Y, OP>, Multiply> type;
+
+  static inline bool Applies(const ArgT& BO)
+  {
+    return Daixt::ExprManip::IsSameSubExpr(BO.lhs().lhs(), BO.rhs().lhs());
+  }
+
+  static inline type Apply(const ArgT& BO)
+  {
+    return type(BO.lhs().lhs(), 
+                Daixt::BinOp<X, Y, OP>(BO.lhs().rhs(), BO.rhs().rhs()));
+  }
+};
+
+template <class M, class X, class Y>
+struct CommonMatrix<Daixt::BinOp<Daixt::BinOp<M, X, Multiply>, 
+                                 Daixt::BinOp<M, Y, Multiply>, 
+                                 Daixt::DefaultOps::BinaryPlus> >
+  : public CommonMatrixInSum<M, X, Y, Daixt::DefaultOps::BinaryPlus>
+{};
+
+template <class M, class X, class Y>
+struct CommonMatrix<Daixt::BinOp<Daixt::BinOp<M, X, Multiply>, 
+                                 Daixt::BinOp<M, Y, Multiply>, 
+                                 Daixt::DefaultOps::BinaryMinus> >
+  : public CommonMatrixInSum<M, X, Y, Daixt::DefaultOps::BinaryMinus>
+{};
+
+
+// the path to the outermost candidate, see NestedProducts.h
+template <class T>
+struct CommonMatrixFinder
+{
+  typedef Nowhere Path;
+};
+
+template <class ARG, class OP>
+struct CommonMatrixFinder<Daixt::UnOp<ARG, OP> >
+{
+  typedef typename CommonMatrixFinder<ARG>::Path InChild;
+
+  typedef typename boost::mpl::if_c<SAME_TYPE(InChild, Nowhere),
+                                    Nowhere,
+                                    InArg<InChild> >::type Path;
+};
+
+template <class LHS, class RHS, class OP>
+struct CommonMatrixFinder<Daixt::BinOp<LHS, RHS, OP> >
+{
+  typedef typename CommonMatrixFinder<LHS>::Path InLeft;
+  typedef typename CommonMatrixFinder<RHS>::Path InRight;
+
+  typedef typename boost::mpl::if_c
+  <
+    CommonMatrix<Daixt::BinOp<LHS, RHS, OP> >::Result, 
+    Here,
+    typename boost::mpl::if_c
+    <
+      !SAME_TYPE(InLeft, Nowhere), 
+      InLHS<InLeft>,
+      typename boost::mpl::if_c<!SAME_TYPE(InRight, Nowhere), 
+                                InRHS<InRight>, 
+                                Nowhere>::type
+    >::type
+  >::type Path;
+};
+
+
+template <class TargetT, class T>
+inline bool 
+FactorCommonMatrix(TargetT& Target, const T& t, const Nowhere& Dummy)
+{
+  return false;
+}
+
+// only the first candidate is tried: if its matrices differ, we give up
+template <class TargetT, class T, class Path>
+inline bool 
+FactorCommonMatrix(TargetT& Target, const T& t, const Path& Dummy)
+{
+  typedef SubExprAt<T, Path> Locator;
+  typedef CommonMatrix<typename Locator::Result> Rule;
+
+  if (!Rule::Applies(Locator::Get(t)))
+    {
+      return false;
+    }
+
+  typedef ReplaceSubExprAt<T, Path, typename Rule::type> Replacer;
+
+  // delegate to operator= which applies the remaining rules
+  Target = Replacer::Apply(t, Rule::Apply(Locator::Get(t)));
+
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// the work horse
+
+// nothing changed at compile time: try the runtime rule
+template <class TargetT, class T>
+inline bool 
+ApplyRewriteRules(TargetT& Target, const T& t, const T* Dummy)
+{
+  typedef typename CommonMatrixFinder<T>::Path Path;
+
+  return FactorCommonMatrix(Target, t, Path());
+}
+
+
+template <class TargetT, class T, class R>
+inline bool 
+ApplyRewriteRules(TargetT& Target, const T& t, const R* Dummy)
+{
+  Target = Rewriter<T>::Apply(t);
+
+  return true;
+}
+
+} // namespace Private
+
+
+////////////////////////////////////////////////////////////////////////////////
+// returns true if the assignment Target = t has been performed, false if no
+// rule applied and the caller must do the work
+
+template <class TargetT, class T>
+inline bool ApplyRewriteRules(TargetT& Target, const T& t)
+{
+  typedef typename Rewriter<T>::type R;
+
+  return Private::ApplyRewriteRules(Target, t, static_cast<const R*>(0));
+}
+
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_REWRITE_RULES_INC
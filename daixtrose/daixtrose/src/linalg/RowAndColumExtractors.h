@@ -53,16 +53,16 @@ namespace Private
 {
 
 ////////////////////////////////////////////////////////////////////////////////
-// merging two (std::)maps
+// merging two (std::)maps: the result is stored in Map, so callers should
+// return Map itself (not the reference returned here) to allow the named return
+// value optimization to kick in.
 
-template <class MapType>
+template <class MapType, class RowT>
 inline 
 MapType &
-Merge(MapType& Map, const MapType& ToAdd)
+Merge(MapType& Map, const RowT& ToAdd)
 {
-  MapType Result(Map);
-  
-  typedef typename MapType::const_iterator const_iterator;
+  typedef typename RowT::const_iterator const_iterator;
 
   const_iterator end = ToAdd.end();
   for (const_iterator iter = ToAdd.begin(); iter!= end; ++iter) {
@@ -85,14 +85,12 @@ Merge(MapType& Map, const MapType& ToAdd)
 
 ////////////////////////////////////////////////////////////////////////////////
 // merge while applying a functor to rhs
-template <class MapType, class OP>
+template <class MapType, class RowT, class OP>
 inline 
 MapType &
-Merge(MapType& Map, const MapType& ToAdd, const OP& Op)
+Merge(MapType& Map, const RowT& ToAdd, const OP& Op)
 {
-  MapType Result(Map);
-  
-  typedef typename MapType::const_iterator const_iterator;
+  typedef typename RowT::const_iterator const_iterator;
 
   const_iterator end = ToAdd.end();
   for (const_iterator iter = ToAdd.begin(); iter!= end; ++iter) {
@@ -151,6 +149,17 @@ template<class T, class ARG> struct OperatorDelimImpl;
 template <class T, class RowStorage, class Allocator> class Matrix;
 
 
+// What RowExtractor<Disambiguation> returns for ARG: a RowStorage by default.
+// Leaves which can show their rows in place (MappedMatrix, see BinaryIO.h)
+// return a view instead, which iterates like a RowStorage and converts to one
+// where a consumer needs its own copy.
+template <class Disambiguation, class ARG> 
+struct RowOf 
+{ 
+  typedef typename Disambiguation::RowStorage Type; 
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // row extractor for matrix expression
 ////////////////////////////////////////////////////////////////////////////////
@@ -160,15 +169,22 @@ struct RowExtractor<MatrixExpression<T> >
 {
   RowExtractor(std::size_t i) : i_(i) {}
 
+  // every row built here is counted, nested ones included
   template<class ARG> inline 
-  typename T::RowStorage
+  typename RowOf<MatrixExpression<T>, 
+                 typename Daixt::UnwrapExpr<ARG>::Type>::Type
   operator()(const ARG& arg) const
   {
-    return 
-      OperatorDelimImpl<
-                        RowExtractor<MatrixExpression<T> >, 
-                        typename Daixt::UnwrapExpr<ARG>::Type
-                        >::Apply(Daixt::unwrap_expr(arg), i_);
+    typename RowOf<MatrixExpression<T>, 
+                   typename Daixt::UnwrapExpr<ARG>::Type>::Type Result
+      (OperatorDelimImpl<
+                         RowExtractor<MatrixExpression<T> >, 
+                         typename Daixt::UnwrapExpr<ARG>::Type
+                         >::Apply(Daixt::unwrap_expr(arg), i_));
+
+    DAIXT_INSTRUMENT_COUNT(rows_evaluated);
+    DAIXT_INSTRUMENT_ADD(entries_produced, Result.size());
+    return Result;
   }
 
   // sometimes a const reference can be used as return type: short-circuit
@@ -297,13 +313,15 @@ OperatorDelimImpl<RowExtractor<MatrixExpression<T> >,
     typedef typename T::NumT NumT;
     typedef typename T::RowStorage RowStorage;
     typedef typename RowStorage::iterator iterator;
+    typedef typename RowOf<MatrixExpression<T>, RHS>::Type RHSRow;
     
     RowStorage LHS_Result = 
       RowExtractor<MatrixExpression<T> >(i)(arg.lhs());
-    const RowStorage& RHS_Result = 
+    const RHSRow& RHS_Result = 
       RowExtractor<MatrixExpression<T> >(i)(arg.rhs());
     
-    return Private::Merge(LHS_Result, RHS_Result);
+    Private::Merge(LHS_Result, RHS_Result);
+    return LHS_Result;
   }
 };
 
@@ -322,11 +340,12 @@ OperatorDelimImpl<RowExtractor<MatrixExpression<T> >,
     typedef typename T::NumT NumT;
     typedef typename T::RowStorage RowStorage;
     typedef typename RowStorage::iterator iterator;
-    typedef typename RowStorage::const_iterator const_iterator;
+    typedef typename RowOf<MatrixExpression<T>, RHS>::Type RHSRow;
+    typedef typename RHSRow::const_iterator const_iterator;
 
     RowStorage LHS_Result = 
       RowExtractor<MatrixExpression<T> >(i)(arg.lhs());
-    const RowStorage& RHS_Result = 
+    const RHSRow& RHS_Result = 
       RowExtractor<MatrixExpression<T> >(i)(arg.rhs());
     
     const_iterator end = RHS_Result.end();
@@ -348,8 +367,8 @@ OperatorDelimImpl<RowExtractor<MatrixExpression<T> >,
 
             typedef typename RowStorage::value_type MVT;
             typedef typename MVT::second_type ST;
-            LHS_Result.insert(lb, MVT(iter->first, ST(0)));
-            LHS_Result[iter->first] -= iter->second;
+            LHS_Result.insert(lb, MVT(iter->first, ST(0)))->second 
+              -= iter->second;
           }
       }
   
@@ -489,6 +508,7 @@ struct RowExtractor<VectorExpression<T> >
   typename T::NumT 
   operator()(const ARG& arg) const
   {
+    DAIXT_INSTRUMENT_COUNT(rows_evaluated);
     return 
       OperatorDelimImpl<RowExtractor<VectorExpression<T> >, ARG>
       ::Apply(Daixt::unwrap_expr(arg), i_);
@@ -636,18 +656,11 @@ OperatorDelimImpl<RowExtractor<VectorExpression<T> >,
         std::size_t i)
   {
     typedef typename T::NumT NumT;
-    NumT LHS_Result = RowExtractor<VectorExpression<T> >(i)(arg.lhs());
-    NumT RHS_Result = RowExtractor<VectorExpression<T> >(i)(arg.rhs());
 
-#if defined(__GNUC__) && __GNUC__ == 3 
-    NumT Result = 
-      Daixt::DefaultOps::operator+ <NumT, NumT>(LHS_Result, RHS_Result);
-    return Result;
-#else
-    using Daixt::DefaultOps::operator+;
-    NumT Result = LHS_Result + RHS_Result;
+    // accumulate in place: blocked entries (e.g. TinyVector) are not copied
+    NumT Result = RowExtractor<VectorExpression<T> >(i)(arg.lhs());
+    Result += RowExtractor<VectorExpression<T> >(i)(arg.rhs());
     return Result;
-#endif
   }
 };
 
@@ -663,11 +676,9 @@ OperatorDelimImpl<RowExtractor<VectorExpression<T> >,
         std::size_t i)
   {
     typedef typename T::NumT NumT;
-    NumT LHS_Result = RowExtractor<VectorExpression<T> >(i)(arg.lhs());
-    NumT RHS_Result = RowExtractor<VectorExpression<T> >(i)(arg.rhs());
 
-    using namespace Daixt::DefaultOps;
-    NumT Result = LHS_Result - RHS_Result;
+    NumT Result = RowExtractor<VectorExpression<T> >(i)(arg.lhs());
+    Result -= RowExtractor<VectorExpression<T> >(i)(arg.rhs());
     return Result;
 //     return (RowExtractor<VectorExpression<T> >(i)(arg.lhs())
 //             +
@@ -758,7 +769,8 @@ private:
   {
     typedef typename LHS::Disambiguation::RowStorage RowStorage;
     typedef typename LHS::Disambiguation::Allocator MatAllocator;
-    typedef typename RowStorage::const_iterator const_iterator;
+    typedef typename RowOf<typename LHS::Disambiguation, LHS>::Type RowT;
+    typedef typename RowT::const_iterator const_iterator;
 
     typedef typename T::NumT NumT;
 
@@ -778,7 +790,7 @@ private:
 //       boost::mpl::identity<RowStorage> 
 //       >::type RowType;
 
-    const RowStorage& Row = 
+    const RowT& Row = 
       RowExtractor<typename LHS::Disambiguation>(i)(arg.lhs());
 
     // for the sake of readability we renounce the use of boost::lambda here and
@@ -834,15 +846,20 @@ struct ColExtractor<MatrixExpression<T> >
 {
   ColExtractor(std::size_t i) : i_(i) {}
 
+  // columns count as rows evaluated
   template<class ARG> inline
   typename T::RowStorage
   operator()(const ARG& arg) const
   {
-    return 
-      OperatorDelimImpl<
-                        ColExtractor<MatrixExpression<T> >, 
-                        typename Daixt::UnwrapExpr<ARG>::Type
-                        >::Apply(Daixt::unwrap_expr(arg), i_);
+    typename T::RowStorage Result
+      (OperatorDelimImpl<
+                         ColExtractor<MatrixExpression<T> >, 
+                         typename Daixt::UnwrapExpr<ARG>::Type
+                         >::Apply(Daixt::unwrap_expr(arg), i_));
+
+    DAIXT_INSTRUMENT_COUNT(rows_evaluated);
+    DAIXT_INSTRUMENT_ADD(entries_produced, Result.size());
+    return Result;
   }
 
 private:
@@ -866,6 +883,7 @@ OperatorDelimImpl<ColExtractor<MatrixExpression<T> >,
                      typename T::Allocator>& arg,
         std::size_t i) 
   {
+    DAIXT_INSTRUMENT_COUNT(column_extractions);
     return arg.GetColumn(i);
   }
 };
@@ -883,7 +901,9 @@ OperatorDelimImpl<ColExtractor<MatrixExpression<T> >,
   Apply(const Daixt::ConstRef<Arg>& arg,
         std::size_t i)
   {
-    return ColExtractor<MatrixExpression<T> >(i)(static_cast<const Arg&>(arg));
+    // directly to the Matrix: the column must be counted only once
+    return OperatorDelimImpl<ColExtractor<MatrixExpression<T> >, Arg>
+      ::Apply(static_cast<const Arg&>(arg), i);
   }
 };
 
@@ -943,10 +963,11 @@ OperatorDelimImpl<ColExtractor<MatrixExpression<T> >,
     
     RowStorage LHS_Result = 
       ColExtractor<MatrixExpression<T> >(i)(arg.lhs());
-    RowStorage RHS_Result = 
+    const RowStorage& RHS_Result = 
       ColExtractor<MatrixExpression<T> >(i)(arg.rhs());
     
-    return Private::Merge(LHS_Result, RHS_Result);
+    Private::Merge(LHS_Result, RHS_Result);
+    return LHS_Result;
   }
 };
 
@@ -968,11 +989,12 @@ OperatorDelimImpl<ColExtractor<MatrixExpression<T> >,
     
     RowStorage LHS_Result = 
       ColExtractor<MatrixExpression<T> >(i)(arg.lhs());
-    RowStorage RHS_Result = 
+    const RowStorage& RHS_Result = 
       ColExtractor<MatrixExpression<T> >(i)(arg.rhs());
     
     // FIXIT: std::negate kills this when T ain't a builtin type
-    return Private::Merge(LHS_Result, RHS_Result, std::negate<NumT>());
+    Private::Merge(LHS_Result, RHS_Result, std::negate<NumT>());
+    return LHS_Result;
   }
 };
 
@@ -0,0 +1,143 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef DAIXT_LINALG_TEMPORARY_POOL_INC
+#define DAIXT_LINALG_TEMPORARY_POOL_INC
+
+#include "daixtrose/ThreadLocal.h"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// a per-thread pool of temporaries
+////////////////////////////////////////////////////////////////////////////////
+
+// Temporaries which are inserted automatically during assignment (see
+// linalg/CommonSubExpr.h and linalg/NestedProducts.h) are taken from here, so
+// that their memory survives the assignment and is reused by the next one.
+//
+// Each thread keeps at most MaxCached temporaries of a type, the others are
+// deleted when they go out of scope.  Those kept are only given back by Purge,
+// so a thread which exits without calling it leaves at most MaxCached behind.
+//
+// usage: 
+//   Linalg::PooledTemporary<Vector> Tmp;
+//   *Tmp = A * x;
+
+namespace Linalg
+{
+
+template <class T>
+class PooledTemporary
+{
+public:
+  inline PooledTemporary() : node_(Acquire()) {}
+  inline ~PooledTemporary() { Release(node_); }
+
+  inline T& operator*() { return node_->Value; }
+  inline const T& operator*() const { return node_->Value; }
+  inline T* operator->() { return &node_->Value; }
+  inline const T* operator->() const { return &node_->Value; }
+
+  static const std::size_t MaxCached = 4;
+
+  // give back the memory of the temporaries cached for the calling thread
+  static inline void Purge()
+  {
+    while (FreeList())
+      {
+        Node* Tmp = FreeList();
+        FreeList() = Tmp->Next;
+        delete Tmp;
+      }
+    NumberCached() = 0;
+  }
+
+  // the number of temporaries cached for the calling thread
+  static inline std::size_t Cached() { return NumberCached(); }
+
+private:
+  // not copyable
+  PooledTemporary(const PooledTemporary&);
+  PooledTemporary& operator=(const PooledTemporary&);
+
+  struct Node
+  {
+    Node() : Value(), Next(0) {}
+
+    T Value;
+    Node* Next;
+  };
+
+  static inline Node*& FreeList()
+  {
+    static DAIXT_THREAD_LOCAL Node* List = 0;
+    return List;
+  }
+
+  static inline std::size_t& NumberCached()
+  {
+    static DAIXT_THREAD_LOCAL std::size_t Number = 0;
+    return Number;
+  }
+
+  static inline Node* Acquire()
+  {
+    Node* Result = FreeList();
+    if (Result == 0)
+      {
+        return new Node;
+      }
+
+    FreeList() = Result->Next;
+    --NumberCached();
+    return Result;
+  }
+
+  static inline void Release(Node* N)
+  {
+    if (NumberCached() == MaxCached)
+      {
+        delete N;
+        return;
+      }
+
+    N->Next = FreeList();
+    FreeList() = N;
+    ++NumberCached();
+  }
+
+  Node* node_;
+};
+
+
+} // namespace Linalg
+
+
+#endif // DAIXT_LINALG_TEMPORARY_POOL_INC
@@ -34,6 +34,7 @@
 #include "linalg/RowAndColumExtractors.h"
 #include "linalg/Disambiguation.h"
 #include "linalg/Matrix.h"
+#include "linalg/RewriteRules.h"
 
 
 namespace Linalg
@@ -101,6 +102,23 @@ OperatorDelimImpl<ColExtractor<MatrixExpression<T> >,
 };
 
 
+// Transpose(Transpose(A)) = A
+template<class ARG>
+struct RewriteRule<Daixt::UnOp<Daixt::UnOp<ARG, TransposeOfMatrix>, 
+                               TransposeOfMatrix> >
+{
+  typedef ARG type;
+
+  static inline 
+  const ARG& 
+  Apply(const Daixt::UnOp<Daixt::UnOp<ARG, TransposeOfMatrix>, 
+                          TransposeOfMatrix>& arg)
+  {
+    return arg.arg().arg();
+  }
+};
+
+
 } // namespace Linalg
 
 
@@ -5,6 +5,9 @@
 #include "linalg/RowAndColumCounters.h"
 #include "linalg/RowAndColumExtractors.h"
 #include "linalg/Disambiguation.h"
+#include "linalg/CommonSubExpr.h"
+#include "linalg/NestedProducts.h"
+#include "linalg/RewriteRules.h"
 
 #include "daixtrose/Daixt.h"
 
@@ -223,7 +226,22 @@ Vector(const OtherT& Other)
   :
   data_()
 {
+  DAIXT_INSTRUMENT_SCOPE(OtherT);
+  DAIXT_PROFILE_SCOPE(OtherT);
+
+  if (EliminateCommonSubExpr(*this, Daixt::unwrap_expr(Other))
+      ||
+      ApplyRewriteRules(*this, Daixt::unwrap_expr(Other))
+      ||
+      MaterializeNestedProducts(*this, Daixt::unwrap_expr(Other)))
+    {
+      return;
+    }
+
   size_type nrows = NumberOfRows(Other); 
+
+  DAIXT_INSTRUMENT_COUNT(assignments);
+  DAIXT_PROFILE_ENTRIES(nrows, sizeof(T));
   data_.reserve(nrows);
 
   for (size_type i = 0; i != nrows; ++i)
@@ -263,13 +281,32 @@ Vector<T, Allocator>&
 Vector<T, Allocator>::
 operator=(const OtherT& Other)
 {
+  DAIXT_INSTRUMENT_SCOPE(OtherT);
+  DAIXT_PROFILE_SCOPE(OtherT);
+
+  // shared or nested matrix * vector products are evaluated only once, see
+  // RewriteRules.h for the rest
+  if (EliminateCommonSubExpr(*this, Daixt::unwrap_expr(Other))
+      ||
+      ApplyRewriteRules(*this, Daixt::unwrap_expr(Other))
+      ||
+      MaterializeNestedProducts(*this, Daixt::unwrap_expr(Other)))
+    {
+      return *this;
+    }
+
   size_type nrows = NumberOfRows(Other);
 
+  DAIXT_INSTRUMENT_COUNT(assignments);
+  DAIXT_PROFILE_ENTRIES(nrows, sizeof(T));
+
   // The check for whether we need a temporary could be refined: if *this does
   // not occur on the rhs of a multiplication, the temporary might not be
   // required.
   if (Daixt::CountOccurrence(Other, *this)) // must use a temporary
     {
+      DAIXT_INSTRUMENT_COUNT(aliasing_temporaries);
+
       DataStorage Tmp; 
       Tmp.reserve(nrows);
 
@@ -280,6 +317,13 @@ operator=(const OtherT& Other)
       
       data_.swap(Tmp);
     }
+  else if (data_.size() == nrows) // overwrite the entries in place
+    {
+      for (size_type i = 0; i != nrows; ++i)
+        {
+          data_[i] = RowExtractor<Disambiguation>(i+1)(Other);
+        }
+    }
   else // Not so many temporaries needed
     {
       data_.clear();
@@ -0,0 +1,1103 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef TINY_BATCH_EVALUATION_INC
+#define TINY_BATCH_EVALUATION_INC
+
+#include "tiny/TinyMatrix.h"
+#include "tiny/TinyVector.h"
+#include "tiny/MatrixVectorOps.h"
+#include "tiny/FusedEvaluation.h"
+
+#include "daixtrose/Daixt.h"
+#include "daixtrose/ThreadLocal.h"
+
+#include "boost/mpl/if.hpp"
+
+#include <cstddef>
+#include <cassert>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Batched evaluation of tiny expressions in structure-of-arrays layout
+////////////////////////////////////////////////////////////////////////////////
+
+// Element kernels evaluate the same tiny expression for a huge number of
+// instances. With one TinyQuadraticMatrix per instance the compiler can only
+// vectorize within a 3x3 or 5x5 block, which hardly pays. 
+//
+// SoAMatrix and SoAVector are views on arrays which store entry (i, j) of all
+// instances contiguously:
+//
+//     Data[((i - 1) + (j - 1) * n) * Stride + Instance],   Instance = 0, 1, ...
+//
+// They are leaves for Daixt expressions, just like TinyQuadraticMatrix and
+// TinyVector, which may be mixed in and are then the same for all instances.
+// BatchAssign(Target, Expression, NumberOfInstances) walks through the
+// instances in blocks of B lanes. Every operation of the expression becomes a
+// loop over the lanes of a block, i.e. over instances, and that is the loop
+// the compiler vectorizes. Products and lumped matrices are computed once per
+// block.
+//
+// The nodes are selected by the node kinds of the fused evaluation (see
+// FusedEvaluation.h). Nodes of unknown kind fall back to the fused
+// evaluation of one instance after the other, which in turn asks GetValue;
+// for that GetValue reads SoAMatrix and SoAVector at CurrentInstance().
+
+namespace TinyMat
+{
+
+template <class T, std::size_t n>
+class SoAMatrix
+{
+public:
+  typedef TinyQuadraticMatrixExpression<T, n> Disambiguation;
+  typedef T value_type;
+  static const std::size_t dimension = n;
+
+  inline SoAMatrix(T* Data, std::size_t Stride) 
+    : Data_(Data), Stride_(Stride) {}
+
+  // entry (i, j) of an instance (counted from 0)
+  inline T& operator()(std::size_t i, std::size_t j, std::size_t Instance) const
+  {
+    RangeCheck(i, j);
+    return Data_[((i - 1) + (j - 1) * n) * Stride_ + Instance];
+  }
+
+  inline T* data() const { return Data_; }
+  inline std::size_t stride() const { return Stride_; }
+
+private:
+  inline void RangeCheck(std::size_t i, std::size_t j) const
+  {
+    assert (i > 0);
+    assert (j > 0);
+    assert (i < n + 1);
+    assert (j < n + 1);
+  }
+
+  T* Data_;
+  std::size_t Stride_;
+};
+
+} // namespace TinyMat
+
+
+namespace TinyVec
+{
+
+template <class T, std::size_t n>
+class SoAVector
+{
+public:
+  typedef TinyVectorExpression<T, n> Disambiguation;
+  typedef T value_type;
+  static const std::size_t dimension = n;
+
+  inline SoAVector(T* Data, std::size_t Stride) 
+    : Data_(Data), Stride_(Stride) {}
+
+  // entry j of an instance (counted from 0)
+  inline T& operator()(std::size_t j, std::size_t Instance) const
+  {
+    assert (j > 0);
+    assert (j < n + 1);
+    return Data_[(j - 1) * Stride_ + Instance];
+  }
+
+  inline T* data() const { return Data_; }
+  inline std::size_t stride() const { return Stride_; }
+
+private:
+  T* Data_;
+  std::size_t Stride_;
+};
+
+} // namespace TinyVec
+
+
+namespace TinyMat
+{
+
+namespace Batched
+{
+
+// the instance GetValue reads from SoAMatrix and SoAVector
+inline std::size_t& CurrentInstance()
+{
+  // POD, see daixtrose/ThreadLocal.h
+  static DAIXT_THREAD_LOCAL std::size_t Instance = 0;
+  return Instance;
+}
+
+} // namespace Batched
+
+
+template <class T, std::size_t n>
+struct OperatorDelimImpl<GetValue<T>, SoAMatrix<T, n> >
+{
+  static inline T Apply(const SoAMatrix<T, n>& M, std::size_t i, std::size_t j) 
+  {
+    return M(i, j, Batched::CurrentInstance());
+  }
+};
+
+
+namespace Fused
+{
+
+template <class T, std::size_t n> struct KindOf<SoAMatrix<T, n> > 
+{ 
+  typedef LeafKind Type; 
+};
+
+template <class T, std::size_t n> struct KindOf<TinyVec::SoAVector<T, n> > 
+{ 
+  typedef LeafKind Type; 
+};
+
+} // namespace Fused
+
+} // namespace TinyMat
+
+
+namespace TinyVec
+{
+
+template <class T, std::size_t n>
+struct OperatorDelimImpl<GetValue<T>, SoAVector<T, n> >
+{
+  static inline T Apply(const SoAVector<T, n>& V, std::size_t j) 
+  {
+    return V(j, TinyMat::Batched::CurrentInstance());
+  }
+};
+
+} // namespace TinyVec
+
+
+namespace TinyMat
+{
+
+namespace Batched
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// loops over the lanes of a block. These are the loops we want vectorized.
+// "omp simd" needs OpenMP 4.0, i.e. the OPENMP_CXXFLAGS found by configure
+// (see test_batch_evaluation_omp in Makefile.am); without it we rely on the
+// auto-vectorizer.
+
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+#define DAIXT_BATCH_SIMD _Pragma("omp simd")
+#else
+#define DAIXT_BATCH_SIMD
+#endif
+
+template <class T> 
+inline void Fill(T* Out, T Value, std::size_t Count)
+{
+  DAIXT_BATCH_SIMD
+  for (std::size_t k = 0; k < Count; ++k) Out[k] = Value;
+}
+
+template <class T> 
+inline void Copy(const T* In, T* Out, std::size_t Count)
+{
+  DAIXT_BATCH_SIMD
+  for (std::size_t k = 0; k < Count; ++k) Out[k] = In[k];
+}
+
+template <class T> 
+inline void Add(const T* In, T* Out, std::size_t Count)
+{
+  DAIXT_BATCH_SIMD
+  for (std::size_t k = 0; k < Count; ++k) Out[k] += In[k];
+}
+
+template <class T> 
+inline void MultiplyAdd(const T* a, const T* b, T* Out, std::size_t Count)
+{
+  DAIXT_BATCH_SIMD
+  for (std::size_t k = 0; k < Count; ++k) Out[k] += a[k] * b[k];
+}
+
+template <class OP, class T> 
+inline void ApplyUnary(const T* a, T* Out, std::size_t Count)
+{
+  DAIXT_BATCH_SIMD
+  for (std::size_t k = 0; k < Count; ++k) 
+    Out[k] = OP::Apply(a[k], Daixt::Hint<T>());
+}
+
+template <class OP, class T> 
+inline void ApplyBinary(const T* a, const T* b, T* Out, std::size_t Count)
+{
+  DAIXT_BATCH_SIMD
+  for (std::size_t k = 0; k < Count; ++k) 
+    Out[k] = OP::Apply(a[k], b[k], Daixt::Hint<T>());
+}
+
+#undef DAIXT_BATCH_SIMD
+
+
+////////////////////////////////////////////////////////////////////////////////
+// node selection
+//
+// A node mirrors one node of the expression. Load(Instance, Count) prepares
+// a block of Count <= B instances starting at Instance, Get(i, j, Scratch,
+// Count) (matrices) or Get(j, Scratch, Count) (vectors) return the lanes of
+// one entry, either stored inside the node or computed into Scratch.
+
+using Fused::IsMatrixExpression;
+using Fused::Content;
+using Fused::KindOf;
+using Fused::LeafKind;
+using Fused::ScalarKind;
+using Fused::EntryWiseUnaryKind;
+using Fused::TransposeKind;
+using Fused::LumpKind;
+using Fused::EntryWiseBinaryKind;
+using Fused::ProductKind;
+
+template <class ARG, std::size_t B, class Kind = typename KindOf<ARG>::Type> 
+class MatrixNode;
+template <class ARG, std::size_t B, class Kind = typename KindOf<ARG>::Type> 
+class VectorNode;
+
+template <class ARG, std::size_t B> struct NodeOf
+{
+  typedef typename Daixt::UnwrapExpr<ARG>::Type Unwrapped;
+  typedef typename boost::mpl::if_c
+  <
+    IsMatrixExpression<typename Unwrapped::Disambiguation>::value,
+    MatrixNode<Unwrapped, B>,
+    VectorNode<Unwrapped, B>
+  >::type Type;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// operands of products: cheap nodes are read directly, all others are 
+// evaluated once per block
+
+template <class Node, std::size_t B, bool Cheap = Node::Cheap> 
+class MatrixOperand
+{
+public:
+  typedef typename Node::value_type T;
+  inline explicit MatrixOperand(const Node& N) : Node_(N) {}
+  inline void Load(std::size_t Count) {}
+  inline const T* Get(std::size_t i, std::size_t j, T* Scratch, 
+                      std::size_t Count) const
+  { 
+    return Node_.Get(i, j, Scratch, Count); 
+  }
+private:
+  const Node& Node_;
+};
+
+template <class Node, std::size_t B> 
+class MatrixOperand<Node, B, false>
+{
+  typedef typename Node::value_type T;
+  static const std::size_t n = Node::dimension;
+
+public:
+  inline explicit MatrixOperand(const Node& N) : Node_(N) {}
+  inline void Load(std::size_t Count) 
+  {
+    for (std::size_t j = 1; j != n + 1; ++j)
+      {
+        for (std::size_t i = 1; i != n + 1; ++i)
+          {
+            T* Lanes = Data_ + ((i - 1) + (j - 1) * n) * B;
+            const T* Result = Node_.Get(i, j, Lanes, Count);
+            if (Result != Lanes) Copy(Result, Lanes, Count);
+          }
+      }
+  }
+  inline const T* Get(std::size_t i, std::size_t j, T* Scratch, 
+                      std::size_t Count) const
+  { 
+    return Data_ + ((i - 1) + (j - 1) * n) * B;
+  }
+private:
+  const Node& Node_;
+  T Data_[n * n * B];
+};
+
+
+template <class Node, std::size_t B, bool Cheap = Node::Cheap> 
+class VectorOperand
+{
+public:
+  typedef typename Node::value_type T;
+  inline explicit VectorOperand(const Node& N) : Node_(N) {}
+  inline void Load(std::size_t Count) {}
+  inline const T* Get(std::size_t j, T* Scratch, std::size_t Count) const
+  { 
+    return Node_.Get(j, Scratch, Count); 
+  }
+private:
+  const Node& Node_;
+};
+
+template <class Node, std::size_t B> 
+class VectorOperand<Node, B, false>
+{
+  typedef typename Node::value_type T;
+  static const std::size_t n = Node::dimension;
+
+public:
+  inline explicit VectorOperand(const Node& N) : Node_(N) {}
+  inline void Load(std::size_t Count) 
+  {
+    for (std::size_t j = 1; j != n + 1; ++j)
+      {
+        T* Lanes = Data_ + (j - 1) * B;
+        const T* Result = Node_.Get(j, Lanes, Count);
+        if (Result != Lanes) Copy(Result, Lanes, Count);
+      }
+  }
+  inline const T* Get(std::size_t j, T* Scratch, std::size_t Count) const
+  { 
+    return Data_ + (j - 1) * B;
+  }
+private:
+  const Node& Node_;
+  T Data_[n * B];
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+//************************** matrix nodes ************************************//
+////////////////////////////////////////////////////////////////////////////////
+
+// anything unknown: one instance after the other
+template <class ARG, std::size_t B, class Kind> class MatrixNode
+{
+  typedef typename Fused::NodeOf<ARG>::Type FusedNode;
+
+public:
+  typedef typename FusedNode::value_type value_type;
+  static const std::size_t dimension = FusedNode::dimension;
+  enum { Cheap = true };
+
+private:
+  typedef value_type T;
+  static const std::size_t n = dimension;
+
+public:
+  inline explicit MatrixNode(const ARG& Arg) : Arg_(Arg) {}
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  {
+    for (std::size_t k = 0; k != Count; ++k)
+      {
+        CurrentInstance() = Instance + k;
+        FusedNode Node(Arg_);
+        for (std::size_t j = 1; j != n + 1; ++j)
+          {
+            for (std::size_t i = 1; i != n + 1; ++i)
+              {
+                Data_[((i - 1) + (j - 1) * n) * B + k] = Node(i, j);
+              }
+          }
+      }
+  }
+  inline const T* Get(std::size_t i, std::size_t j, T* Scratch, 
+                      std::size_t Count) const
+  { 
+    return Data_ + ((i - 1) + (j - 1) * n) * B;
+  }
+
+private:
+  const ARG& Arg_;
+  T Data_[n * n * B];
+};
+
+
+// SoAMatrix: read in place
+template <class T, std::size_t n, std::size_t B> 
+class MatrixNode<SoAMatrix<T, n>, B, LeafKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit MatrixNode(const SoAMatrix<T, n>& M) : M_(M), Instance_(0) {}
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  { 
+    Instance_ = Instance; 
+  }
+  inline const T* Get(std::size_t i, std::size_t j, T* Scratch, 
+                      std::size_t Count) const
+  { 
+    return &M_(i, j, Instance_); 
+  }
+
+private:
+  SoAMatrix<T, n> M_;
+  std::size_t Instance_;
+};
+
+
+// TinyQuadraticMatrix: the same for all instances
+template <class T, std::size_t n, std::size_t B> 
+class MatrixNode<Daixt::ConstRef<TinyQuadraticMatrix<T, n> >, B, LeafKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit 
+  MatrixNode(const Daixt::ConstRef<TinyQuadraticMatrix<T, n> >& M) 
+  {
+    const T* Entries = static_cast<const TinyQuadraticMatrix<T, n>&>(M).data();
+    for (std::size_t e = 0; e != n * n; ++e)
+      {
+        Fill(Data_ + e * B, Entries[e], B);
+      }
+  }
+  inline void Load(std::size_t Instance, std::size_t Count) {}
+  inline const T* Get(std::size_t i, std::size_t j, T* Scratch, 
+                      std::size_t Count) const
+  { 
+    return Data_ + ((i - 1) + (j - 1) * n) * B;
+  }
+
+private:
+  T Data_[n * n * B];
+};
+
+
+// Daixt::Scalar
+template <class T, std::size_t n, std::size_t B> 
+class MatrixNode<Daixt::Scalar<TinyQuadraticMatrixExpression<T, n> >, B, 
+                 ScalarKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit 
+  MatrixNode(const Daixt::Scalar<TinyQuadraticMatrixExpression<T, n> >& S) 
+  {
+    Fill(Lanes_, static_cast<T>(S.Value()), B);
+  }
+  inline void Load(std::size_t Instance, std::size_t Count) {}
+  inline const T* Get(std::size_t i, std::size_t j, T* Scratch, 
+                      std::size_t Count) const
+  { 
+    return Lanes_; 
+  }
+
+private:
+  T Lanes_[B];
+};
+
+
+// UnOps: entry-wise
+template <class ARG, class OP, std::size_t B> 
+class MatrixNode<Daixt::UnOp<ARG, OP>, B, EntryWiseUnaryKind>
+{
+  typedef typename NodeOf<ARG, B>::Type ArgNode;
+
+public:
+  typedef typename ArgNode::value_type value_type;
+  static const std::size_t dimension = ArgNode::dimension;
+  enum { Cheap = false };
+
+  inline explicit MatrixNode(const Daixt::UnOp<ARG, OP>& UO) 
+    : Arg_(Content(UO.arg())) {}
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  { 
+    Arg_.Load(Instance, Count); 
+  }
+  inline const value_type* Get(std::size_t i, std::size_t j, 
+                               value_type* Scratch, std::size_t Count) const
+  { 
+    ApplyUnary<OP>(Arg_.Get(i, j, Scratch, Count), Scratch, Count);
+    return Scratch;
+  }
+
+private:
+  ArgNode Arg_;
+};
+
+
+// transposed matrix
+template <class ARG, std::size_t B> 
+class MatrixNode<Daixt::UnOp<ARG, TransposeOfTinyMatrix>, B, TransposeKind>
+{
+  typedef typename NodeOf<ARG, B>::Type ArgNode;
+
+public:
+  typedef typename ArgNode::value_type value_type;
+  static const std::size_t dimension = ArgNode::dimension;
+  enum { Cheap = ArgNode::Cheap };
+
+  inline explicit 
+  MatrixNode(const Daixt::UnOp<ARG, TransposeOfTinyMatrix>& UO) 
+    : Arg_(Content(UO.arg())) {}
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  { 
+    Arg_.Load(Instance, Count); 
+  }
+  inline const value_type* Get(std::size_t i, std::size_t j, 
+                               value_type* Scratch, std::size_t Count) const
+  { 
+    return Arg_.Get(j, i, Scratch, Count);
+  }
+
+private:
+  ArgNode Arg_;
+};
+
+
+// lumped matrix: the row sums are computed once per block
+template <class ARG, std::size_t B> 
+class MatrixNode<Daixt::UnOp<ARG, LumpedTinyMatrix>, B, LumpKind>
+{
+  typedef typename NodeOf<ARG, B>::Type ArgNode;
+
+public:
+  typedef typename ArgNode::value_type value_type;
+  static const std::size_t dimension = ArgNode::dimension;
+  enum { Cheap = true };
+
+private:
+  typedef value_type T;
+  static const std::size_t n = dimension;
+
+public:
+  inline explicit MatrixNode(const Daixt::UnOp<ARG, LumpedTinyMatrix>& UO) 
+    : Arg_(Content(UO.arg())) 
+  {
+    Fill(Zero_, T(), B);
+  }
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  { 
+    Arg_.Load(Instance, Count);
+
+    T Scratch[B];
+    for (std::size_t i = 1; i != n + 1; ++i)
+      {
+        T* Sum = Diagonal_ + (i - 1) * B;
+        Fill(Sum, T(), Count);
+        for (std::size_t k = 1; k != n + 1; ++k)
+          {
+            Add(Arg_.Get(i, k, Scratch, Count), Sum, Count);
+          }
+      }
+  }
+  inline const T* Get(std::size_t i, std::size_t j, T* Scratch, 
+                      std::size_t Count) const
+  { 
+    return i == j ? Diagonal_ + (i - 1) * B : Zero_;
+  }
+
+private:
+  ArgNode Arg_;
+  T Diagonal_[n * B];
+  T Zero_[B];
+};
+
+
+// entry-wise BinOps
+template <class LHS, class RHS, class OP, std::size_t B> 
+class MatrixNode<Daixt::BinOp<LHS, RHS, OP>, B, EntryWiseBinaryKind>
+{
+  typedef typename NodeOf<LHS, B>::Type LhsNode;
+  typedef typename NodeOf<RHS, B>::Type RhsNode;
+
+public:
+  typedef typename LhsNode::value_type value_type;
+  static const std::size_t dimension = LhsNode::dimension;
+  enum { Cheap = false };
+
+  COMPILE_TIME_ASSERT(LhsNode::dimension == RhsNode::dimension);
+
+  inline explicit MatrixNode(const Daixt::BinOp<LHS, RHS, OP>& BO) 
+    : Lhs_(Content(BO.lhs())), Rhs_(Content(BO.rhs())) {}
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  { 
+    Lhs_.Load(Instance, Count); 
+    Rhs_.Load(Instance, Count); 
+  }
+  inline const value_type* Get(std::size_t i, std::size_t j, 
+                               value_type* Scratch, std::size_t Count) const
+  { 
+    value_type RhsScratch[B];
+    ApplyBinary<OP>(Lhs_.Get(i, j, Scratch, Count), 
+                    Rhs_.Get(i, j, RhsScratch, Count), 
+                    Scratch, Count);
+    return Scratch;
+  }
+
+private:
+  LhsNode Lhs_;
+  RhsNode Rhs_;
+};
+
+
+// matrix * matrix: computed once per block
+template <class LHS, class RHS, std::size_t B> 
+class MatrixNode<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply>, B, 
+                 ProductKind>
+{
+  typedef typename NodeOf<LHS, B>::Type LhsNode;
+  typedef typename NodeOf<RHS, B>::Type RhsNode;
+
+public:
+  typedef typename LhsNode::value_type value_type;
+  static const std::size_t dimension = LhsNode::dimension;
+  enum { Cheap = true };
+
+  COMPILE_TIME_ASSERT(LhsNode::dimension == RhsNode::dimension);
+
+private:
+  typedef value_type T;
+  static const std::size_t n = dimension;
+
+public:
+  inline explicit 
+  MatrixNode(const Daixt::BinOp<LHS, RHS, 
+                                Daixt::DefaultOps::BinaryMultiply>& BO)
+    : LhsArg_(Content(BO.lhs())), RhsArg_(Content(BO.rhs())),
+      Lhs_(LhsArg_), Rhs_(RhsArg_) {}
+
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  {
+    LhsArg_.Load(Instance, Count);
+    RhsArg_.Load(Instance, Count);
+    Lhs_.Load(Count);
+    Rhs_.Load(Count);
+
+    T LhsScratch[B], RhsScratch[B];
+    for (std::size_t j = 1; j != n + 1; ++j)
+      {
+        for (std::size_t i = 1; i != n + 1; ++i)
+          {
+            T* Sum = Data_ + ((i - 1) + (j - 1) * n) * B;
+            Fill(Sum, T(), Count);
+            for (std::size_t k = 1; k != n + 1; ++k)
+              {
+                MultiplyAdd(Lhs_.Get(i, k, LhsScratch, Count), 
+                            Rhs_.Get(k, j, RhsScratch, Count), 
+                            Sum, Count);
+              }
+          }
+      }
+  }
+  inline const T* Get(std::size_t i, std::size_t j, T* Scratch, 
+                      std::size_t Count) const
+  { 
+    return Data_ + ((i - 1) + (j - 1) * n) * B;
+  }
+
+private:
+  LhsNode LhsArg_;
+  RhsNode RhsArg_;
+  MatrixOperand<LhsNode, B> Lhs_;
+  MatrixOperand<RhsNode, B> Rhs_;
+  T Data_[n * n * B];
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+//************************** vector nodes ************************************//
+////////////////////////////////////////////////////////////////////////////////
+
+// anything unknown: one instance after the other
+template <class ARG, std::size_t B, class Kind> class VectorNode
+{
+  typedef typename Fused::NodeOf<ARG>::Type FusedNode;
+
+public:
+  typedef typename FusedNode::value_type value_type;
+  static const std::size_t dimension = FusedNode::dimension;
+  enum { Cheap = true };
+
+private:
+  typedef value_type T;
+  static const std::size_t n = dimension;
+
+public:
+  inline explicit VectorNode(const ARG& Arg) : Arg_(Arg) {}
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  {
+    for (std::size_t k = 0; k != Count; ++k)
+      {
+        CurrentInstance() = Instance + k;
+        FusedNode Node(Arg_);
+        for (std::size_t j = 1; j != n + 1; ++j)
+          {
+            Data_[(j - 1) * B + k] = Node(j);
+          }
+      }
+  }
+  inline const T* Get(std::size_t j, T* Scratch, std::size_t Count) const
+  { 
+    return Data_ + (j - 1) * B;
+  }
+
+private:
+  const ARG& Arg_;
+  T Data_[n * B];
+};
+
+
+// SoAVector: read in place
+template <class T, std::size_t n, std::size_t B> 
+class VectorNode<TinyVec::SoAVector<T, n>, B, LeafKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit VectorNode(const TinyVec::SoAVector<T, n>& V) 
+    : V_(V), Instance_(0) {}
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  { 
+    Instance_ = Instance; 
+  }
+  inline const T* Get(std::size_t j, T* Scratch, std::size_t Count) const
+  { 
+    return &V_(j, Instance_); 
+  }
+
+private:
+  TinyVec::SoAVector<T, n> V_;
+  std::size_t Instance_;
+};
+
+
+// TinyVector: the same for all instances
+template <class T, std::size_t n, std::size_t B> 
+class VectorNode<Daixt::ConstRef<TinyVec::TinyVector<T, n> >, B, LeafKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit 
+  VectorNode(const Daixt::ConstRef<TinyVec::TinyVector<T, n> >& V) 
+  {
+    const T* Entries = static_cast<const TinyVec::TinyVector<T, n>&>(V).data();
+    for (std::size_t e = 0; e != n; ++e)
+      {
+        Fill(Data_ + e * B, Entries[e], B);
+      }
+  }
+  inline void Load(std::size_t Instance, std::size_t Count) {}
+  inline const T* Get(std::size_t j, T* Scratch, std::size_t Count) const
+  { 
+    return Data_ + (j - 1) * B;
+  }
+
+private:
+  T Data_[n * B];
+};
+
+
+// Daixt::Scalar
+template <class T, std::size_t n, std::size_t B> 
+class VectorNode<Daixt::Scalar<TinyVec::TinyVectorExpression<T, n> >, B, 
+                 ScalarKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit 
+  VectorNode(const Daixt::Scalar<TinyVec::TinyVectorExpression<T, n> >& S) 
+  {
+    Fill(Lanes_, static_cast<T>(S.Value()), B);
+  }
+  inline void Load(std::size_t Instance, std::size_t Count) {}
+  inline const T* Get(std::size_t j, T* Scratch, std::size_t Count) const
+  { 
+    return Lanes_; 
+  }
+
+private:
+  T Lanes_[B];
+};
+
+
+// UnOps: entry-wise
+template <class ARG, class OP, std::size_t B> 
+class VectorNode<Daixt::UnOp<ARG, OP>, B, EntryWiseUnaryKind>
+{
+  typedef typename NodeOf<ARG, B>::Type ArgNode;
+
+public:
+  typedef typename ArgNode::value_type value_type;
+  static const std::size_t dimension = ArgNode::dimension;
+  enum { Cheap = false };
+
+  inline explicit VectorNode(const Daixt::UnOp<ARG, OP>& UO) 
+    : Arg_(Content(UO.arg())) {}
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  { 
+    Arg_.Load(Instance, Count); 
+  }
+  inline const value_type* Get(std::size_t j, value_type* Scratch, 
+                               std::size_t Count) const
+  { 
+    ApplyUnary<OP>(Arg_.Get(j, Scratch, Count), Scratch, Count);
+    return Scratch;
+  }
+
+private:
+  ArgNode Arg_;
+};
+
+
+// entry-wise BinOps, including vector * vector (see GetIndexedValue.h)
+template <class LHS, class RHS, class OP, std::size_t B> 
+class VectorNode<Daixt::BinOp<LHS, RHS, OP>, B, EntryWiseBinaryKind>
+{
+  typedef typename NodeOf<LHS, B>::Type LhsNode;
+  typedef typename NodeOf<RHS, B>::Type RhsNode;
+
+public:
+  typedef typename LhsNode::value_type value_type;
+  static const std::size_t dimension = LhsNode::dimension;
+  enum { Cheap = false };
+
+  COMPILE_TIME_ASSERT(LhsNode::dimension == RhsNode::dimension);
+
+  inline explicit VectorNode(const Daixt::BinOp<LHS, RHS, OP>& BO) 
+    : Lhs_(Content(BO.lhs())), Rhs_(Content(BO.rhs())) {}
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  { 
+    Lhs_.Load(Instance, Count); 
+    Rhs_.Load(Instance, Count); 
+  }
+  inline const value_type* Get(std::size_t j, value_type* Scratch, 
+                               std::size_t Count) const
+  { 
+    value_type RhsScratch[B];
+    ApplyBinary<OP>(Lhs_.Get(j, Scratch, Count), 
+                    Rhs_.Get(j, RhsScratch, Count), 
+                    Scratch, Count);
+    return Scratch;
+  }
+
+private:
+  LhsNode Lhs_;
+  RhsNode Rhs_;
+};
+
+
+// matrix * vector: computed once per block
+template <class LHS, class RHS, std::size_t B> 
+class VectorNode<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply>, B, 
+                 ProductKind>
+{
+  typedef typename NodeOf<LHS, B>::Type LhsNode;
+  typedef typename NodeOf<RHS, B>::Type RhsNode;
+
+public:
+  typedef typename RhsNode::value_type value_type;
+  static const std::size_t dimension = RhsNode::dimension;
+  enum { Cheap = true };
+
+  COMPILE_TIME_ASSERT(LhsNode::dimension == RhsNode::dimension);
+
+private:
+  typedef value_type T;
+  static const std::size_t n = dimension;
+
+public:
+  inline explicit 
+  VectorNode(const Daixt::BinOp<LHS, RHS, 
+                                Daixt::DefaultOps::BinaryMultiply>& BO)
+    : LhsArg_(Content(BO.lhs())), RhsArg_(Content(BO.rhs())),
+      Lhs_(LhsArg_), Rhs_(RhsArg_) {}
+
+  inline void Load(std::size_t Instance, std::size_t Count) 
+  {
+    LhsArg_.Load(Instance, Count);
+    RhsArg_.Load(Instance, Count);
+    Lhs_.Load(Count);
+    Rhs_.Load(Count);
+
+    T LhsScratch[B], RhsScratch[B];
+    for (std::size_t i = 1; i != n + 1; ++i)
+      {
+        T* Sum = Data_ + (i - 1) * B;
+        Fill(Sum, T(), Count);
+        for (std::size_t k = 1; k != n + 1; ++k)
+          {
+            MultiplyAdd(Lhs_.Get(i, k, LhsScratch, Count), 
+                        Rhs_.Get(k, RhsScratch, Count), 
+                        Sum, Count);
+          }
+      }
+  }
+  inline const T* Get(std::size_t j, T* Scratch, std::size_t Count) const
+  { 
+    return Data_ + (j - 1) * B;
+  }
+
+private:
+  LhsNode LhsArg_;
+  RhsNode RhsArg_;
+  MatrixOperand<LhsNode, B> Lhs_;
+  VectorOperand<RhsNode, B> Rhs_;
+  T Data_[n * B];
+};
+
+
+} // namespace Batched
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Target = E for the instances 0 ... NumberOfInstances - 1, B at a time.
+// Each block is completed before it is written, so Target may occur in E.
+
+static const std::size_t DefaultBatchLanes = 16;
+
+template <std::size_t B, class T, std::size_t n, class A>
+inline void BatchAssign(const SoAMatrix<T, n>& Target, 
+                        const Daixt::Expr<A>& E, 
+                        std::size_t NumberOfInstances)
+{
+  typedef TinyQuadraticMatrixExpression<T, n> MyOwnDisambiguation;
+  COMPILE_TIME_ASSERT(SAME_TYPE(typename A::Disambiguation, 
+                                MyOwnDisambiguation));
+  COMPILE_TIME_ASSERT((B > 0));
+
+  typedef typename Batched::NodeOf<A, B>::Type Node;
+  Node Root(E.content());
+
+  T Result[n * n * B];
+  
+  for (std::size_t Instance = 0; Instance < NumberOfInstances; Instance += B)
+    {
+      const std::size_t Count = 
+        (NumberOfInstances - Instance < B) ? NumberOfInstances - Instance : B;
+
+      Root.Load(Instance, Count);
+
+      for (std::size_t j = 1; j != n + 1; ++j)
+        {
+          for (std::size_t i = 1; i != n + 1; ++i)
+            {
+              T* Lanes = Result + ((i - 1) + (j - 1) * n) * B;
+              const T* Entry = Root.Get(i, j, Lanes, Count);
+              if (Entry != Lanes) Batched::Copy(Entry, Lanes, Count);
+            }
+        }
+
+      for (std::size_t j = 1; j != n + 1; ++j)
+        {
+          for (std::size_t i = 1; i != n + 1; ++i)
+            {
+              Batched::Copy(Result + ((i - 1) + (j - 1) * n) * B, 
+                            &Target(i, j, Instance), Count);
+            }
+        }
+    }
+}
+
+
+template <class T, std::size_t n, class A>
+inline void BatchAssign(const SoAMatrix<T, n>& Target, 
+                        const Daixt::Expr<A>& E, 
+                        std::size_t NumberOfInstances)
+{
+  BatchAssign<DefaultBatchLanes>(Target, E, NumberOfInstances);
+}
+
+} // namespace TinyMat
+
+
+namespace TinyVec
+{
+
+template <std::size_t B, class T, std::size_t n, class A>
+inline void BatchAssign(const SoAVector<T, n>& Target, 
+                        const Daixt::Expr<A>& E, 
+                        std::size_t NumberOfInstances)
+{
+  typedef TinyVectorExpression<T, n> MyOwnDisambiguation;
+  COMPILE_TIME_ASSERT(SAME_TYPE(typename A::Disambiguation, 
+                                MyOwnDisambiguation));
+  COMPILE_TIME_ASSERT((B > 0));
+
+  typedef typename TinyMat::Batched::NodeOf<A, B>::Type Node;
+  Node Root(E.content());
+
+  T Result[n * B];
+  
+  for (std::size_t Instance = 0; Instance < NumberOfInstances; Instance += B)
+    {
+      const std::size_t Count = 
+        (NumberOfInstances - Instance < B) ? NumberOfInstances - Instance : B;
+
+      Root.Load(Instance, Count);
+
+      for (std::size_t j = 1; j != n + 1; ++j)
+        {
+          T* Lanes = Result + (j - 1) * B;
+          const T* Entry = Root.Get(j, Lanes, Count);
+          if (Entry != Lanes) TinyMat::Batched::Copy(Entry, Lanes, Count);
+        }
+
+      for (std::size_t j = 1; j != n + 1; ++j)
+        {
+          TinyMat::Batched::Copy(Result + (j - 1) * B, 
+                                 &Target(j, Instance), Count);
+        }
+    }
+}
+
+
+template <class T, std::size_t n, class A>
+inline void BatchAssign(const SoAVector<T, n>& Target, 
+                        const Daixt::Expr<A>& E, 
+                        std::size_t NumberOfInstances)
+{
+  BatchAssign<TinyMat::DefaultBatchLanes>(Target, E, NumberOfInstances);
+}
+
+} // namespace TinyVec
+
+
+#endif // TINY_BATCH_EVALUATION_INC
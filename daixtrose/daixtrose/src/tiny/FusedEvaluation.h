@@ -0,0 +1,885 @@
+//-*-c++-*-
+//
+// Copyright (C) 2003 Markus Werle
+//
+// This file is part of the Daixtrose C++ Library.  This library is free
+// software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1, or (at your option)
+// any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; see the file COPYING.  If not, send mail to the
+// developers of daixtrose (see e.g. http://daixtrose.sourceforge.net/)
+
+// As a special exception, you may use this file as part of a free software
+// library without restriction.  Specifically, if other files instantiate
+// templates or use macros or inline functions from this file, or you compile
+// this file and link it with other files to produce an executable, this
+// file does not by itself cause the resulting executable to be covered by
+// the GNU Lesser General Public License.  This exception does not however
+// invalidate any other reasons why the executable file might be covered by
+// the GNU Lesser General Public License.
+
+#ifndef TINY_FUSED_EVALUATION_INC
+#define TINY_FUSED_EVALUATION_INC
+
+#include "tiny/TinyMatrix.h"
+#include "tiny/TinyVector.h"
+#include "tiny/MatrixVectorOps.h"
+#include "tiny/GetIndexedValue.h"
+
+#include "daixtrose/Daixt.h"
+
+#include "boost/mpl/if.hpp"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Fused evaluation of TinyQuadraticMatrix and TinyVector expressions
+////////////////////////////////////////////////////////////////////////////////
+
+// GetValue evaluates a single entry, so products inside an expression are
+// recomputed for each entry they contribute to: evaluated entry by entry,
+// A = B * C + D * E costs O(n^4) instead of O(n^3). 
+//
+// Therefore operator= and the constructors of TinyQuadraticMatrix and
+// TinyVector from an expression call FusedAssign(Target, Expression), which
+// is also available directly. It first mirrors the expression tree by a tree
+// of nodes. Products (matrix * matrix, matrix * vector) and lumped matrices
+// are computed once while the nodes are built, all other operations are
+// applied entry by entry on the fly. All loops run over compile time bounds
+// via Unroll<n>, so for each size we get straight-line code.
+//
+// Node types without a specialization here fall back to GetValue, so user
+// extensions of OperatorDelimImpl keep working.
+
+namespace TinyMat
+{
+
+namespace Fused
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// static loops: f(1), f(2), ..., f(k)
+
+template <std::size_t k> struct Unroll
+{
+  template <class F> static inline void Loop(F& f)
+  {
+    Unroll<k - 1>::Loop(f);
+    f(k);
+  }
+};
+
+template <> struct Unroll<0>
+{
+  template <class F> static inline void Loop(F& f) {}
+};
+
+
+// f(i, j) for all entries of a n x n matrix, column by column
+template <std::size_t n> class UnrollSquare
+{
+  template <class F> struct Column
+  {
+    F& f_; 
+    std::size_t j_;
+    inline Column(F& f, std::size_t j) : f_(f), j_(j) {}
+    inline void operator()(std::size_t i) { f_(i, j_); }
+  };
+
+  template <class F> struct Columns
+  {
+    F& f_;
+    inline explicit Columns(F& f) : f_(f) {}
+    inline void operator()(std::size_t j) 
+    { 
+      Column<F> C(f_, j);
+      Unroll<n>::Loop(C); 
+    }
+  };
+
+public:
+  template <class F> static inline void Loop(F& f)
+  {
+    Columns<F> C(f);
+    Unroll<n>::Loop(C);
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Daixt::unwrap_expr returns a copy, but nodes may keep references
+
+template <class T> inline const T& Content(const T& t) { return t; }
+template <class T> inline const T& Content(const Daixt::Expr<T>& E) 
+{ 
+  return E.content(); 
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// node selection
+
+template <class D> struct IsMatrixExpression 
+{ 
+  static const bool value = false; 
+};
+
+template <class T, std::size_t n> 
+struct IsMatrixExpression<TinyQuadraticMatrixExpression<T, n> > 
+{ 
+  static const bool value = true; 
+};
+
+
+template <class ARG> struct IsScalar 
+{ 
+  static const bool value = false; 
+};
+
+template <class D> struct IsScalar<Daixt::Scalar<D> > 
+{ 
+  static const bool value = true; 
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// node kinds
+//
+// KindOf<ARG>::Type tells which kind of node mirrors ARG. The nodes below are
+// specialized for these kinds, and so are the nodes of the batched evaluation
+// (see BatchEvaluation.h), so both agree on what is computed once.
+
+struct GetValueKind {};         // unknown: ask GetValue
+struct LeafKind {};             // TinyQuadraticMatrix, TinyVector
+struct ScalarKind {};           // Daixt::Scalar
+struct EntryWiseUnaryKind {};   // OP applied to each entry
+struct TransposeKind {};
+struct LumpKind {};
+struct EntryWiseBinaryKind {};  // +, -, Scalar * X, vector * vector
+struct ProductKind {};          // matrix * matrix, matrix * vector
+
+template <class ARG> struct KindOf 
+{ 
+  typedef GetValueKind Type; 
+};
+
+template <class T, std::size_t n> 
+struct KindOf<Daixt::ConstRef<TinyQuadraticMatrix<T, n> > > 
+{ 
+  typedef LeafKind Type; 
+};
+
+template <class T, std::size_t n> 
+struct KindOf<Daixt::ConstRef<TinyVec::TinyVector<T, n> > > 
+{ 
+  typedef LeafKind Type; 
+};
+
+template <class D> struct KindOf<Daixt::Scalar<D> > 
+{ 
+  typedef ScalarKind Type; 
+};
+
+template <class ARG, class OP> struct KindOf<Daixt::UnOp<ARG, OP> > 
+{ 
+  typedef EntryWiseUnaryKind Type; 
+};
+
+template <class ARG> 
+struct KindOf<Daixt::UnOp<ARG, TransposeOfTinyMatrix> > 
+{ 
+  typedef TransposeKind Type; 
+};
+
+template <class ARG> 
+struct KindOf<Daixt::UnOp<ARG, LumpedTinyMatrix> > 
+{ 
+  typedef LumpKind Type; 
+};
+
+// any BinOp is applied entry-wise to vectors (see GetIndexedValue.h), but
+// only +, - and * are known for matrices
+template <class LHS, class RHS, class OP> 
+struct KindOf<Daixt::BinOp<LHS, RHS, OP> > 
+{ 
+  typedef typename Daixt::BinOp<LHS, RHS, OP>::Disambiguation Disambiguation;
+  typedef typename boost::mpl::if_c
+  <
+    IsMatrixExpression<Disambiguation>::value,
+    GetValueKind,
+    EntryWiseBinaryKind
+  >::type Type;
+};
+
+template <class LHS, class RHS> 
+struct KindOf<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryPlus> > 
+{ 
+  typedef EntryWiseBinaryKind Type; 
+};
+
+template <class LHS, class RHS> 
+struct KindOf<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMinus> > 
+{ 
+  typedef EntryWiseBinaryKind Type; 
+};
+
+// Scalar * X and X * Scalar are entry-wise, all others with a matrix on the
+// left are products
+template <class LHS, class RHS> 
+struct KindOf<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply> > 
+{ 
+  typedef typename boost::mpl::if_c
+  <
+    !IsScalar<LHS>::value && !IsScalar<RHS>::value && 
+    IsMatrixExpression<typename LHS::Disambiguation>::value,
+    ProductKind,
+    EntryWiseBinaryKind
+  >::type Type;
+};
+
+
+template <class ARG, class Kind = typename KindOf<ARG>::Type> class MatrixNode;
+template <class ARG, class Kind = typename KindOf<ARG>::Type> class VectorNode;
+
+template <class ARG> struct NodeOf
+{
+  typedef typename Daixt::UnwrapExpr<ARG>::Type Unwrapped;
+  typedef typename boost::mpl::if_c
+  <
+    IsMatrixExpression<typename Unwrapped::Disambiguation>::value,
+    MatrixNode<Unwrapped>,
+    VectorNode<Unwrapped>
+  >::type Type;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// operands of products: cheap nodes are read directly, all others are 
+// evaluated once into a local array
+
+template <class Node, bool Cheap = Node::Cheap> class MatrixOperand
+{
+public:
+  typedef typename Node::value_type T;
+  inline explicit MatrixOperand(const Node& N) : Node_(N) {}
+  inline T operator()(std::size_t i, std::size_t j) const { return Node_(i, j); }
+private:
+  const Node& Node_;
+};
+
+template <class Node> class MatrixOperand<Node, false>
+{
+  typedef typename Node::value_type T;
+  static const std::size_t n = Node::dimension;
+
+  struct Copy
+  {
+    T* Data_; 
+    const Node& Node_;
+    inline Copy(T* Data, const Node& N) : Data_(Data), Node_(N) {}
+    inline void operator()(std::size_t i, std::size_t j) 
+    { 
+      Data_[i - 1 + (j - 1) * n] = Node_(i, j); 
+    }
+  };
+
+public:
+  inline explicit MatrixOperand(const Node& N)
+  {
+    Copy C(Data_, N);
+    UnrollSquare<n>::Loop(C);
+  }
+  inline T operator()(std::size_t i, std::size_t j) const 
+  { 
+    return Data_[i - 1 + (j - 1) * n]; 
+  }
+private:
+  T Data_[n * n];
+};
+
+
+template <class Node, bool Cheap = Node::Cheap> class VectorOperand
+{
+public:
+  typedef typename Node::value_type T;
+  inline explicit VectorOperand(const Node& N) : Node_(N) {}
+  inline T operator()(std::size_t j) const { return Node_(j); }
+private:
+  const Node& Node_;
+};
+
+template <class Node> class VectorOperand<Node, false>
+{
+  typedef typename Node::value_type T;
+  static const std::size_t n = Node::dimension;
+
+  struct Copy
+  {
+    T* Data_; 
+    const Node& Node_;
+    inline Copy(T* Data, const Node& N) : Data_(Data), Node_(N) {}
+    inline void operator()(std::size_t j) { Data_[j - 1] = Node_(j); }
+  };
+
+public:
+  inline explicit VectorOperand(const Node& N)
+  {
+    Copy C(Data_, N);
+    Unroll<n>::Loop(C);
+  }
+  inline T operator()(std::size_t j) const { return Data_[j - 1]; }
+private:
+  T Data_[n];
+};
+
+
+// sum over k of L(i, k) * R(k, j)
+template <class L, class R, class T> struct MatrixDot
+{
+  const L& L_; 
+  const R& R_;
+  std::size_t i_, j_;
+  T Sum_;
+
+  inline MatrixDot(const L& Lhs, const R& Rhs, std::size_t i, std::size_t j)
+    : L_(Lhs), R_(Rhs), i_(i), j_(j), Sum_(T()) {}
+  inline void operator()(std::size_t k) { Sum_ += L_(i_, k) * R_(k, j_); }
+};
+
+// sum over k of L(i, k) * R(k)
+template <class L, class R, class T> struct VectorDot
+{
+  const L& L_; 
+  const R& R_;
+  std::size_t i_;
+  T Sum_;
+
+  inline VectorDot(const L& Lhs, const R& Rhs, std::size_t i)
+    : L_(Lhs), R_(Rhs), i_(i), Sum_(T()) {}
+  inline void operator()(std::size_t k) { Sum_ += L_(i_, k) * R_(k); }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+//************************** matrix nodes ************************************//
+////////////////////////////////////////////////////////////////////////////////
+
+// anything unknown: ask GetValue
+template <class ARG, class Kind> class MatrixNode
+{
+public:
+  typedef typename ARG::Disambiguation::Type value_type;
+  static const std::size_t dimension = ARG::Disambiguation::Dimension;
+  enum { Cheap = false };
+
+  inline explicit MatrixNode(const ARG& Arg) : Arg_(Arg) {}
+  inline value_type operator()(std::size_t i, std::size_t j) const 
+  { 
+    return GetValue<value_type>(i, j)(Arg_); 
+  }
+
+private:
+  const ARG& Arg_;
+};
+
+
+// Daixt::ConstRef
+template <class T, std::size_t n> 
+class MatrixNode<Daixt::ConstRef<TinyQuadraticMatrix<T, n> >, LeafKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit 
+  MatrixNode(const Daixt::ConstRef<TinyQuadraticMatrix<T, n> >& M) 
+    : Data_(static_cast<const TinyQuadraticMatrix<T, n>&>(M).data()) {}
+  inline T operator()(std::size_t i, std::size_t j) const 
+  { 
+    return Data_[i - 1 + (j - 1) * n]; 
+  }
+
+private:
+  const T* Data_;
+};
+
+
+// Daixt::Scalar: the same value for all entries, which makes 
+// Scalar * Matrix an entry-wise operation
+template <class T, std::size_t n> 
+class MatrixNode<Daixt::Scalar<TinyQuadraticMatrixExpression<T, n> >, 
+                 ScalarKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit 
+  MatrixNode(const Daixt::Scalar<TinyQuadraticMatrixExpression<T, n> >& S) 
+    : Value_(S.Value()) {}
+  inline T operator()(std::size_t i, std::size_t j) const { return Value_; }
+
+private:
+  T Value_;
+};
+
+
+// UnOps: entry-wise
+template <class ARG, class OP> 
+class MatrixNode<Daixt::UnOp<ARG, OP>, EntryWiseUnaryKind>
+{
+  typedef typename NodeOf<ARG>::Type ArgNode;
+
+public:
+  typedef typename ArgNode::value_type value_type;
+  static const std::size_t dimension = ArgNode::dimension;
+  enum { Cheap = false };
+
+  inline explicit MatrixNode(const Daixt::UnOp<ARG, OP>& UO) 
+    : Arg_(Content(UO.arg())) {}
+  inline value_type operator()(std::size_t i, std::size_t j) const 
+  { 
+    return OP::Apply(Arg_(i, j), Daixt::Hint<value_type>()); 
+  }
+
+private:
+  ArgNode Arg_;
+};
+
+
+// transposed matrix
+template <class ARG> 
+class MatrixNode<Daixt::UnOp<ARG, TransposeOfTinyMatrix>, TransposeKind>
+{
+  typedef typename NodeOf<ARG>::Type ArgNode;
+
+public:
+  typedef typename ArgNode::value_type value_type;
+  static const std::size_t dimension = ArgNode::dimension;
+  enum { Cheap = ArgNode::Cheap };
+
+  inline explicit 
+  MatrixNode(const Daixt::UnOp<ARG, TransposeOfTinyMatrix>& UO) 
+    : Arg_(Content(UO.arg())) {}
+  inline value_type operator()(std::size_t i, std::size_t j) const 
+  { 
+    return Arg_(j, i); 
+  }
+
+private:
+  ArgNode Arg_;
+};
+
+
+// lumped matrix: the row sums are computed once
+template <class ARG> 
+class MatrixNode<Daixt::UnOp<ARG, LumpedTinyMatrix>, LumpKind>
+{
+  typedef typename NodeOf<ARG>::Type ArgNode;
+
+public:
+  typedef typename ArgNode::value_type value_type;
+  static const std::size_t dimension = ArgNode::dimension;
+  enum { Cheap = true };
+
+private:
+  typedef value_type T;
+  static const std::size_t n = dimension;
+
+  struct RowSum
+  {
+    const ArgNode& Arg_;
+    std::size_t i_;
+    T Sum_;
+    inline RowSum(const ArgNode& Arg, std::size_t i) 
+      : Arg_(Arg), i_(i), Sum_(T()) {}
+    inline void operator()(std::size_t k) { Sum_ += Arg_(i_, k); }
+  };
+
+  struct Diagonal
+  {
+    T* Diagonal_;
+    const ArgNode& Arg_;
+    inline Diagonal(T* D, const ArgNode& Arg) : Diagonal_(D), Arg_(Arg) {}
+    inline void operator()(std::size_t i)
+    {
+      RowSum S(Arg_, i);
+      Unroll<n>::Loop(S);
+      Diagonal_[i - 1] = S.Sum_;
+    }
+  };
+
+public:
+  inline explicit MatrixNode(const Daixt::UnOp<ARG, LumpedTinyMatrix>& UO) 
+  {
+    ArgNode Arg(Content(UO.arg()));
+    Diagonal D(Diagonal_, Arg);
+    Unroll<n>::Loop(D);
+  }
+  inline T operator()(std::size_t i, std::size_t j) const 
+  { 
+    return i == j ? Diagonal_[i - 1] : T(); 
+  }
+
+private:
+  T Diagonal_[n];
+};
+
+
+// entry-wise BinOps
+template <class LHS, class RHS, class OP> 
+class MatrixNode<Daixt::BinOp<LHS, RHS, OP>, EntryWiseBinaryKind>
+{
+  typedef typename NodeOf<LHS>::Type LhsNode;
+  typedef typename NodeOf<RHS>::Type RhsNode;
+
+public:
+  typedef typename LhsNode::value_type value_type;
+  static const std::size_t dimension = LhsNode::dimension;
+  enum { Cheap = false };
+
+  COMPILE_TIME_ASSERT(LhsNode::dimension == RhsNode::dimension);
+
+  inline explicit MatrixNode(const Daixt::BinOp<LHS, RHS, OP>& BO) 
+    : Lhs_(Content(BO.lhs())), Rhs_(Content(BO.rhs())) {}
+  inline value_type operator()(std::size_t i, std::size_t j) const 
+  { 
+    return OP::Apply(Lhs_(i, j), Rhs_(i, j), Daixt::Hint<value_type>()); 
+  }
+
+private:
+  LhsNode Lhs_;
+  RhsNode Rhs_;
+};
+
+
+// matrix * matrix: computed once
+template <class LHS, class RHS> 
+class MatrixNode<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply>, 
+                 ProductKind>
+{
+  typedef typename NodeOf<LHS>::Type LhsNode;
+  typedef typename NodeOf<RHS>::Type RhsNode;
+
+public:
+  typedef typename LhsNode::value_type value_type;
+  static const std::size_t dimension = LhsNode::dimension;
+  enum { Cheap = true };
+
+  COMPILE_TIME_ASSERT(LhsNode::dimension == RhsNode::dimension);
+
+private:
+  typedef value_type T;
+  static const std::size_t n = dimension;
+
+  typedef MatrixOperand<LhsNode> LhsOperand;
+  typedef MatrixOperand<RhsNode> RhsOperand;
+
+  struct Multiply
+  {
+    T* Data_; 
+    const LhsOperand& Lhs_;
+    const RhsOperand& Rhs_;
+    inline Multiply(T* Data, const LhsOperand& Lhs, const RhsOperand& Rhs)
+      : Data_(Data), Lhs_(Lhs), Rhs_(Rhs) {}
+    inline void operator()(std::size_t i, std::size_t j)
+    {
+      MatrixDot<LhsOperand, RhsOperand, T> Dot(Lhs_, Rhs_, i, j);
+      Unroll<n>::Loop(Dot);
+      Data_[i - 1 + (j - 1) * n] = Dot.Sum_;
+    }
+  };
+
+public:
+  inline explicit 
+  MatrixNode(const Daixt::BinOp<LHS, RHS, 
+                                Daixt::DefaultOps::BinaryMultiply>& BO)
+  {
+    LhsNode LhsArg(Content(BO.lhs()));
+    RhsNode RhsArg(Content(BO.rhs()));
+    LhsOperand Lhs(LhsArg);
+    RhsOperand Rhs(RhsArg);
+
+    Multiply M(Data_, Lhs, Rhs);
+    UnrollSquare<n>::Loop(M);
+  }
+  inline T operator()(std::size_t i, std::size_t j) const 
+  { 
+    return Data_[i - 1 + (j - 1) * n]; 
+  }
+
+private:
+  T Data_[n * n];
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+//************************** vector nodes ************************************//
+////////////////////////////////////////////////////////////////////////////////
+
+// anything unknown: ask GetValue
+template <class ARG, class Kind> class VectorNode
+{
+public:
+  typedef typename ARG::Disambiguation::Type value_type;
+  static const std::size_t dimension = ARG::Disambiguation::Dimension;
+  enum { Cheap = false };
+
+  inline explicit VectorNode(const ARG& Arg) : Arg_(Arg) {}
+  inline value_type operator()(std::size_t j) const 
+  { 
+    return TinyVec::GetValue<value_type>(j)(Arg_); 
+  }
+
+private:
+  const ARG& Arg_;
+};
+
+
+// Daixt::ConstRef
+template <class T, std::size_t n> 
+class VectorNode<Daixt::ConstRef<TinyVec::TinyVector<T, n> >, LeafKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit 
+  VectorNode(const Daixt::ConstRef<TinyVec::TinyVector<T, n> >& V) 
+    : Data_(static_cast<const TinyVec::TinyVector<T, n>&>(V).data()) {}
+  inline T operator()(std::size_t j) const { return Data_[j - 1]; }
+
+private:
+  const T* Data_;
+};
+
+
+// Daixt::Scalar
+template <class T, std::size_t n> 
+class VectorNode<Daixt::Scalar<TinyVec::TinyVectorExpression<T, n> >, 
+                 ScalarKind>
+{
+public:
+  typedef T value_type;
+  static const std::size_t dimension = n;
+  enum { Cheap = true };
+
+  inline explicit 
+  VectorNode(const Daixt::Scalar<TinyVec::TinyVectorExpression<T, n> >& S) 
+    : Value_(S.Value()) {}
+  inline T operator()(std::size_t j) const { return Value_; }
+
+private:
+  T Value_;
+};
+
+
+// UnOps: entry-wise
+template <class ARG, class OP> 
+class VectorNode<Daixt::UnOp<ARG, OP>, EntryWiseUnaryKind>
+{
+  typedef typename NodeOf<ARG>::Type ArgNode;
+
+public:
+  typedef typename ArgNode::value_type value_type;
+  static const std::size_t dimension = ArgNode::dimension;
+  enum { Cheap = false };
+
+  inline explicit VectorNode(const Daixt::UnOp<ARG, OP>& UO) 
+    : Arg_(Content(UO.arg())) {}
+  inline value_type operator()(std::size_t j) const 
+  { 
+    return OP::Apply(Arg_(j), Daixt::Hint<value_type>()); 
+  }
+
+private:
+  ArgNode Arg_;
+};
+
+
+// entry-wise BinOps, including vector * vector (see GetIndexedValue.h)
+template <class LHS, class RHS, class OP> 
+class VectorNode<Daixt::BinOp<LHS, RHS, OP>, EntryWiseBinaryKind>
+{
+  typedef typename NodeOf<LHS>::Type LhsNode;
+  typedef typename NodeOf<RHS>::Type RhsNode;
+
+public:
+  typedef typename LhsNode::value_type value_type;
+  static const std::size_t dimension = LhsNode::dimension;
+  enum { Cheap = false };
+
+  COMPILE_TIME_ASSERT(LhsNode::dimension == RhsNode::dimension);
+
+  inline explicit VectorNode(const Daixt::BinOp<LHS, RHS, OP>& BO) 
+    : Lhs_(Content(BO.lhs())), Rhs_(Content(BO.rhs())) {}
+  inline value_type operator()(std::size_t j) const 
+  { 
+    return OP::Apply(Lhs_(j), Rhs_(j), Daixt::Hint<value_type>()); 
+  }
+
+private:
+  LhsNode Lhs_;
+  RhsNode Rhs_;
+};
+
+
+// matrix * vector: computed once
+template <class LHS, class RHS> 
+class VectorNode<Daixt::BinOp<LHS, RHS, Daixt::DefaultOps::BinaryMultiply>, 
+                 ProductKind>
+{
+  typedef typename NodeOf<LHS>::Type LhsNode;
+  typedef typename NodeOf<RHS>::Type RhsNode;
+
+public:
+  typedef typename RhsNode::value_type value_type;
+  static const std::size_t dimension = RhsNode::dimension;
+  enum { Cheap = true };
+
+  COMPILE_TIME_ASSERT(LhsNode::dimension == RhsNode::dimension);
+
+private:
+  typedef value_type T;
+  static const std::size_t n = dimension;
+
+  typedef MatrixOperand<LhsNode> LhsOperand;
+  typedef VectorOperand<RhsNode> RhsOperand;
+
+  struct Multiply
+  {
+    T* Data_; 
+    const LhsOperand& Lhs_;
+    const RhsOperand& Rhs_;
+    inline Multiply(T* Data, const LhsOperand& Lhs, const RhsOperand& Rhs)
+      : Data_(Data), Lhs_(Lhs), Rhs_(Rhs) {}
+    inline void operator()(std::size_t i)
+    {
+      VectorDot<LhsOperand, RhsOperand, T> Dot(Lhs_, Rhs_, i);
+      Unroll<n>::Loop(Dot);
+      Data_[i - 1] = Dot.Sum_;
+    }
+  };
+
+public:
+  inline explicit 
+  VectorNode(const Daixt::BinOp<LHS, RHS, 
+                                Daixt::DefaultOps::BinaryMultiply>& BO)
+  {
+    LhsNode LhsArg(Content(BO.lhs()));
+    RhsNode RhsArg(Content(BO.rhs()));
+    LhsOperand Lhs(LhsArg);
+    RhsOperand Rhs(RhsArg);
+
+    Multiply M(Data_, Lhs, Rhs);
+    Unroll<n>::Loop(M);
+  }
+  inline T operator()(std::size_t j) const { return Data_[j - 1]; }
+
+private:
+  T Data_[n];
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// write the nodes to their targets
+
+template <class Node> struct StoreMatrix
+{
+  static const std::size_t n = Node::dimension;
+
+  typename Node::value_type* Data_;
+  const Node& Node_;
+  inline StoreMatrix(typename Node::value_type* Data, const Node& N) 
+    : Data_(Data), Node_(N) {}
+  inline void operator()(std::size_t i, std::size_t j) 
+  { 
+    Data_[i - 1 + (j - 1) * n] = Node_(i, j); 
+  }
+};
+
+
+template <class Node> struct StoreVector
+{
+  typename Node::value_type* Data_;
+  const Node& Node_;
+  inline StoreVector(typename Node::value_type* Data, const Node& N) 
+    : Data_(Data), Node_(N) {}
+  inline void operator()(std::size_t j) { Data_[j - 1] = Node_(j); }
+};
+
+} // namespace Fused
+
+
+////////////////////////////////////////////////////////////////////////////////
+// M = E, with every product inside E computed only once
+
+template <class T, std::size_t n, class A>
+inline void FusedAssign(TinyQuadraticMatrix<T, n>& M, const Daixt::Expr<A>& E)
+{
+  typedef TinyQuadraticMatrixExpression<T, n> MyOwnDisambiguation;
+  COMPILE_TIME_ASSERT(SAME_TYPE(typename A::Disambiguation, 
+                                MyOwnDisambiguation));
+
+  typedef typename Fused::NodeOf<A>::Type Node;
+
+  if (Daixt::CountOccurrence(E, M))
+    {
+      TinyQuadraticMatrix<T, n> Tmp;
+      FusedAssign(Tmp, E);
+      M = Tmp;
+      return;
+    }
+
+  Node Root(E.content());
+  Fused::StoreMatrix<Node> Store(M.data(), Root);
+  Fused::UnrollSquare<n>::Loop(Store);
+}
+
+} // namespace TinyMat
+
+
+namespace TinyVec
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// V = E, with every product inside E computed only once
+
+template <class T, std::size_t n, class A>
+inline void FusedAssign(TinyVector<T, n>& V, const Daixt::Expr<A>& E)
+{
+  typedef TinyVectorExpression<T, n> MyOwnDisambiguation;
+  COMPILE_TIME_ASSERT(SAME_TYPE(typename A::Disambiguation, 
+                                MyOwnDisambiguation));
+
+  typedef typename TinyMat::Fused::NodeOf<A>::Type Node;
+
+  if (Daixt::CountOccurrence(E, V))
+    {
+      TinyVector<T, n> Tmp;
+      FusedAssign(Tmp, E);
+      V = Tmp;
+      return;
+    }
+
+  Node Root(E.content());
+  TinyMat::Fused::StoreVector<Node> Store(V.data(), Root);
+  TinyMat::Fused::Unroll<n>::Loop(Store);
+}
+
+} // namespace TinyVec
+
+
+#endif // TINY_FUSED_EVALUATION_INC
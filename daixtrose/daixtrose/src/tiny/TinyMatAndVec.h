@@ -36,6 +36,8 @@
 #include "tiny/TinyMatrix.h"
 #include "tiny/MatrixVectorOps.h"
 #include "tiny/GetIndexedValue.h"
+#include "tiny/FusedEvaluation.h"
+#include "tiny/BatchEvaluation.h"
 
 namespace TinyMatAndVec
 {
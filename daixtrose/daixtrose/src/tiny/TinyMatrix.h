@@ -142,23 +142,16 @@ TinyQuadraticMatrix<T, n>::TinyQuadraticMatrix(const T& t)
 }
 
 // ... through expression
-// musta forward declare here
-template<class T> class GetValue;
+// musta forward declare here, see FusedEvaluation.h (included at the end)
+template <class T, std::size_t n, class A>
+inline void FusedAssign(TinyQuadraticMatrix<T, n>& M, const Daixt::Expr<A>& E);
 
 template<class T, std::size_t n>
 template<class A> 
 TinyQuadraticMatrix<T, n>::TinyQuadraticMatrix(const ::Daixt::Expr<A>& E)
 {
-  // we trust in loop unrollers of modern compilers, no need to damage our brain
-  // with static unrollers. Your mileage may vary, but since all loop boundaries
-  // are known at compile time this loop is unlikely to see the light of day.
-  for (size_t j = 1; j != (n + 1); ++j)
-    {
-      for (size_t i = 1; i != (n + 1); ++i)
-        {
-          (*this)(i, j) = GetValue<T>(i, j)(E);
-        }
-    }
+  // products inside E are computed only once
+  FusedAssign(*this, E);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -243,21 +236,8 @@ template<class A>
 void
 TinyQuadraticMatrix<T, n>::operator=(const ::Daixt::Expr<A>& E)
 {
-  if (Daixt::CountOccurrence(E, *this))
-    {
-      TinyQuadraticMatrix<T, n> Tmp(E);
-      std::copy(Tmp.data(), Tmp.data() + n*n, data_); 
-    }
-  else
-    {
-      for (size_t j = 1; j != (n + 1); ++j)
-        {
-          for (size_t i = 1; i != (n + 1); ++i)
-            {
-              (*this)(i, j) = GetValue<T>(i, j)(E);
-            }
-        }
-    }
+  // takes care of aliasing, too
+  FusedAssign(*this, E);
 }
 
 
@@ -370,6 +350,10 @@ void SetEntriesInColTo(std::size_t j, T Value, TinyQuadraticMatrix<T, n>& M)
 } // namespace TinyMat
 
 
+// the evaluator behind assignments from expressions
+#include "tiny/FusedEvaluation.h"
+
+
 #endif // TINY_MATRIX_TINY_MATRIX_INC
 
 
@@ -146,20 +146,16 @@ TinyVector<T, n>::TinyVector(const T& t)
 }
 
 // ... through expression
-// musta forward declare here
-template<class T> class GetValue;
+// musta forward declare here, see FusedEvaluation.h (included at the end)
+template <class T, std::size_t n, class A>
+inline void FusedAssign(TinyVector<T, n>& V, const Daixt::Expr<A>& E);
 
 template<class T, std::size_t n>
 template<class A> 
 TinyVector<T, n>::TinyVector(const ::Daixt::Expr<A>& E)
 {
-  // we trust in loop unrollers of modern compilers, no need to damage our brain
-  // with static unrollers. Your mileage may vary, but since all loop boundaries
-  // are known at compile time this loop is unlikely to see the light of day.
-  for (size_t j = 1; j != (n + 1); ++j)
-    {
-      (*this)(j) = GetValue<T>(j)(E);
-    }
+  // products inside E are computed only once
+  FusedAssign(*this, E);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -177,18 +173,8 @@ template<class A>
 void
 TinyVector<T, n>::operator=(const ::Daixt::Expr<A>& E)
 {
-  if (Daixt::CountOccurrence(E, *this))
-    {
-      TinyVector<T, n> Tmp(E);
-      std::copy(Tmp.data(), Tmp.data() + n, data_); 
-    }
-  else
-    {
-      for (size_t j = 1; j != (n + 1); ++j)
-        {
-          (*this)(j) = GetValue<T>(j)(E);
-        }
-    }
+  // takes care of aliasing, too
+  FusedAssign(*this, E);
 }
 
 
@@ -354,6 +340,10 @@ std::ostream& operator<< (std::ostream& os, const TinyVector<T, n>& V)
 } // namespace TinyVec
 
 
+// the evaluator behind assignments from expressions
+#include "tiny/FusedEvaluation.h"
+
+
 #endif // TINY_MAT_TINY_VECTOR_INC
 
 